@@ -0,0 +1,432 @@
+// ============================================================================
+// mm_bench – per-stage benchmark of the analysis pipeline
+//
+// Generates a synthetic dataset (synthetic.h) or reads a CSV, then runs
+// every stage in order `--repeat` times:
+//
+//   parse → graph_build → cycles → smurfing → shells → profiles
+//   → filters → scoring (ring IDs, scores, accounts, rings, graph data)
+//   → serialize (poll / graph / download bodies) → result_index
+//   → end_to_end (AnalysisEngine::run on the same CSV)
+//
+// Detectors run one after another here (the server runs them side by
+// side), so each stage's time and allocations are its own.  Allocations
+// are counted by replacing global operator new/delete:
+//   allocations / allocated_bytes  — during the stage, all threads
+//   peak_live_bytes                — high-water mark of live heap bytes
+//                                    above what was live when it started
+// Times are min / median / max over the repeats; allocation figures come
+// from the last repeat.  The report is JSON (sorted keys), written to
+// `--out` or stdout, so two commits can be diffed on the same seed.
+//
+//   mm_bench --transactions 1000000 --accounts 100000 --repeat 5 --out a.json
+//   mm_bench --input transactions.csv --repeat 10
+// ============================================================================
+
+#include "money_muling/analysis_engine.h"
+#include "money_muling/json_writer.h"
+#include "money_muling/metrics.h"
+#include "money_muling/response_body.h"
+#include "money_muling/result_index.h"
+
+#include "synthetic.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// ── Allocation counting ──────────────────────────────────────────────────
+// Every block carries its size in a header in front of it, so delete can
+// debit the live total without a lookup.
+
+namespace {
+
+struct AllocCounters {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<int64_t>  live{0};
+    std::atomic<int64_t>  peak{0};
+};
+
+AllocCounters g_alloc;
+
+constexpr size_t BASE_HEADER = alignof(std::max_align_t);
+
+size_t header_for(size_t align) { return std::max(align, BASE_HEADER); }
+
+void* tracked_alloc(size_t n, size_t align) {
+    const size_t hdr = header_for(align);
+    void* raw;
+    if (align <= BASE_HEADER) {
+        raw = std::malloc(hdr + n);
+    } else {
+        const size_t total = (hdr + n + align - 1) / align * align;
+        raw = std::aligned_alloc(align, total);
+    }
+    if (!raw) return nullptr;
+    char* p = static_cast<char*>(raw) + hdr;
+    std::memcpy(p - sizeof(size_t), &n, sizeof(size_t));
+
+    g_alloc.allocations.fetch_add(1, std::memory_order_relaxed);
+    g_alloc.bytes.fetch_add(n, std::memory_order_relaxed);
+    const int64_t live = g_alloc.live.fetch_add((int64_t)n, std::memory_order_relaxed) + (int64_t)n;
+    int64_t peak = g_alloc.peak.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !g_alloc.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    return p;
+}
+
+void tracked_free(void* p, size_t align) {
+    if (!p) return;
+    size_t n;
+    std::memcpy(&n, static_cast<char*>(p) - sizeof(size_t), sizeof(size_t));
+    g_alloc.live.fetch_sub((int64_t)n, std::memory_order_relaxed);
+    std::free(static_cast<char*>(p) - header_for(align));
+}
+
+void* tracked_alloc_or_throw(size_t n, size_t align) {
+    if (void* p = tracked_alloc(n, align)) return p;
+    throw std::bad_alloc();
+}
+
+} // namespace
+
+void* operator new(size_t n)                                  { return tracked_alloc_or_throw(n, 0); }
+void* operator new[](size_t n)                                { return tracked_alloc_or_throw(n, 0); }
+void* operator new(size_t n, const std::nothrow_t&) noexcept  { return tracked_alloc(n, 0); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept{ return tracked_alloc(n, 0); }
+void* operator new(size_t n, std::align_val_t a)              { return tracked_alloc_or_throw(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a)            { return tracked_alloc_or_throw(n, (size_t)a); }
+void* operator new(size_t n, std::align_val_t a, const std::nothrow_t&) noexcept   { return tracked_alloc(n, (size_t)a); }
+void* operator new[](size_t n, std::align_val_t a, const std::nothrow_t&) noexcept { return tracked_alloc(n, (size_t)a); }
+
+void operator delete(void* p) noexcept                        { tracked_free(p, 0); }
+void operator delete[](void* p) noexcept                      { tracked_free(p, 0); }
+void operator delete(void* p, size_t) noexcept                { tracked_free(p, 0); }
+void operator delete[](void* p, size_t) noexcept              { tracked_free(p, 0); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { tracked_free(p, 0); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { tracked_free(p, 0); }
+void operator delete(void* p, std::align_val_t a) noexcept    { tracked_free(p, (size_t)a); }
+void operator delete[](void* p, std::align_val_t a) noexcept  { tracked_free(p, (size_t)a); }
+void operator delete(void* p, size_t, std::align_val_t a) noexcept   { tracked_free(p, (size_t)a); }
+void operator delete[](void* p, size_t, std::align_val_t a) noexcept { tracked_free(p, (size_t)a); }
+void operator delete(void* p, std::align_val_t a, const std::nothrow_t&) noexcept   { tracked_free(p, (size_t)a); }
+void operator delete[](void* p, std::align_val_t a, const std::nothrow_t&) noexcept { tracked_free(p, (size_t)a); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// ── Stage measurements ───────────────────────────────────────────────────
+
+struct StageSample {
+    double   seconds         = 0;
+    uint64_t allocations     = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t peak_live_bytes = 0;
+};
+
+struct StageReport {
+    std::string              name;
+    std::vector<StageSample> samples;   // one per repeat
+};
+
+class Bench {
+public:
+    // Time `fn` as stage `name`, adding a sample to its report
+    void stage(const char* name, const std::function<void()>& fn) {
+        const uint64_t allocs0 = g_alloc.allocations.load();
+        const uint64_t bytes0  = g_alloc.bytes.load();
+        const int64_t  live0   = g_alloc.live.load();
+        g_alloc.peak.store(live0);
+
+        const auto t = Clock::now();
+        fn();
+        StageSample s;
+        s.seconds         = std::chrono::duration<double>(Clock::now() - t).count();
+        s.allocations     = g_alloc.allocations.load() - allocs0;
+        s.allocated_bytes = g_alloc.bytes.load() - bytes0;
+        s.peak_live_bytes = (uint64_t)std::max<int64_t>(g_alloc.peak.load() - live0, 0);
+        report(name).samples.push_back(s);
+    }
+
+    const std::vector<StageReport>& reports() const { return reports_; }
+
+private:
+    std::vector<StageReport> reports_;
+
+    StageReport& report(const char* name) {
+        for (auto& r : reports_) if (r.name == name) return r;
+        reports_.push_back({name, {}});
+        return reports_.back();
+    }
+};
+
+// ── One pass over every stage ────────────────────────────────────────────
+
+struct PassResult {
+    size_t accounts     = 0;
+    size_t transactions = 0;
+    size_t edges        = 0;
+    mm::Summary summary;
+    mm::Timings timings;
+    size_t serialized_bytes = 0;
+};
+
+PassResult run_pass(Bench& bench, const std::string& csv, const mm::DetectionConfig& config) {
+    using namespace mm;
+    PassResult out;
+    auto& pool = ThreadPool::shared();
+
+    CsvParseResult parsed;
+    bench.stage("parse", [&] { parsed = parse_csv(csv); });
+    if (!parsed.ok) throw std::runtime_error("CSV rejected: " + parsed.error);
+
+    TransactionGraph graph;
+    bench.stage("graph_build", [&] {
+        graph.build(std::move(parsed.transactions));
+        parsed = CsvParseResult{};
+    });
+    out.accounts     = graph.node_count();
+    out.transactions = graph.transaction_count();
+    out.edges        = graph.edge_count();
+
+    Timings timings;
+    std::vector<DetectedCycle>    cycles;
+    std::vector<DetectedSmurfing> smurfing;
+    std::vector<DetectedShell>    shells;
+    CycleDetector::Stats          cycle_stats;
+    bench.stage("cycles", [&] {
+        cycles = CycleDetector::detect(graph, config.cycle_max_length, config.cycle_window_hours,
+                                       config.max_cycles, config.max_steps_per_root,
+                                       pool, &cycle_stats, nullptr,
+                                       &timings.max_cycles_reached);
+    });
+    AnalysisEngine::add_cycle_stats(timings, cycle_stats);
+    bench.stage("smurfing", [&] {
+        smurfing = SmurfingDetector::detect(graph, config.fan_threshold,
+                                            config.smurfing_window_hours);
+    });
+    bench.stage("shells", [&] {
+        shells = ShellDetector::detect(graph, config.max_intermediate_txns,
+                                       config.min_chain_length, config.max_chain_length,
+                                       config.max_chains, pool, &timings.shell_steps,
+                                       nullptr, &timings.max_chains_reached);
+    });
+
+    std::vector<AccountProfile> profiles;
+    bench.stage("profiles", [&] { profiles = graph.build_profiles(); });
+    bench.stage("filters",  [&] { Filters::apply(profiles, graph); });
+
+    std::shared_ptr<AnalysisResult> result;
+    bench.stage("scoring", [&] {
+        result = std::make_shared<AnalysisResult>(AnalysisEngine::assemble(
+            "bench", graph, profiles, cycles, smurfing, shells, config, timings,
+            Clock::now()));
+    });
+    if (result->status != AnalysisStatus::COMPLETED)
+        throw std::runtime_error("analysis failed: " + result->error);
+    out.summary = result->summary;
+    out.timings = result->timings;
+
+    std::shared_ptr<const ResponseBodies> bodies;
+    bench.stage("serialize", [&] { bodies = ResponseBodies::build(*result); });
+    out.serialized_bytes = bodies->status.data.size() + bodies->graph.data.size() +
+                           bodies->download.data.size();
+
+    std::unique_ptr<ResultIndex> index;
+    bench.stage("result_index", [&] { index = std::make_unique<ResultIndex>(result); });
+
+    // Release the staged pipeline before the end-to-end run
+    index.reset();
+    bodies.reset();
+    result.reset();
+    profiles = {};
+    graph = TransactionGraph{};
+
+    bench.stage("end_to_end", [&] {
+        auto r = AnalysisEngine::run("bench", csv, config);
+        if (r.status != AnalysisStatus::COMPLETED)
+            throw std::runtime_error("analysis failed: " + r.error);
+    });
+    return out;
+}
+
+// ── Report ───────────────────────────────────────────────────────────────
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    const size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+std::string report_json(const Bench& bench, const mm::SyntheticSpec& spec, bool synthetic,
+                        const std::string& input, size_t repeat, size_t csv_bytes,
+                        const PassResult& pass) {
+    using mm::JsonWriter;
+    std::string out;
+    JsonWriter w(out, 2);
+    w.begin_object();
+
+    w.key("config").begin_object();
+    if (synthetic) {
+        w.field("accounts", spec.accounts)
+         .field("cycles", spec.cycles)
+         .field("days", spec.days)
+         .field("fan_bursts", spec.fan_bursts)
+         .field("fan_size", spec.fan_size);
+    } else {
+        w.field("input", input);
+    }
+    w.field("repeat", repeat);
+    if (synthetic) {
+        w.field("seed", (int64_t)spec.seed)
+         .field("shell_chains", spec.shell_chains)
+         .field("skew", spec.skew);
+    }
+    w.field("threads", mm::ThreadPool::shared().max_workers());
+    if (synthetic) w.field("transactions", spec.transactions);
+    w.end_object();
+
+    w.key("dataset").begin_object()
+     .field("accounts", pass.accounts)
+     .field("csv_bytes", csv_bytes)
+     .field("edges", pass.edges)
+     .field("transactions", pass.transactions)
+     .end_object();
+
+    const mm::Summary& s = pass.summary;
+    w.key("detections").begin_object()
+     .field("cycle_steps", (int64_t)pass.timings.cycle_steps)
+     .field("cycles", s.total_cycles)
+     .field("fraud_rings", s.fraud_rings_detected)
+     .field("max_chains_reached", pass.timings.max_chains_reached)
+     .field("max_cycles_reached", pass.timings.max_cycles_reached)
+     .field("serialized_bytes", pass.serialized_bytes)
+     .field("shell_chains", s.total_shell_patterns)
+     .field("shell_steps", (int64_t)pass.timings.shell_steps)
+     .field("smurfing_patterns", s.total_smurfing_patterns)
+     .field("suspicious_accounts", s.suspicious_accounts_flagged)
+     .end_object();
+
+    w.field("peak_rss_bytes", (int64_t)mm::peak_rss_bytes());
+
+    w.key("stages").begin_array();
+    for (const auto& r : bench.reports()) {
+        std::vector<double> secs;
+        for (const auto& smp : r.samples) secs.push_back(smp.seconds);
+        const StageSample& last = r.samples.back();
+        w.begin_object()
+         .field("allocated_bytes", (int64_t)last.allocated_bytes)
+         .field("allocations", (int64_t)last.allocations)
+         .field("peak_live_bytes", (int64_t)last.peak_live_bytes)
+         .field("seconds_max", *std::max_element(secs.begin(), secs.end()))
+         .field("seconds_median", median(secs))
+         .field("seconds_min", *std::min_element(secs.begin(), secs.end()))
+         .field("stage", r.name)
+         .end_object();
+    }
+    w.end_array();
+
+    w.end_object();
+    out += '\n';
+    return out;
+}
+
+// ── Command line ─────────────────────────────────────────────────────────
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: mm_bench [options]\n"
+        "  --input PATH         benchmark an existing CSV instead of generating one\n"
+        "  --transactions N     background rows             (default 100000)\n"
+        "  --accounts N         background accounts         (default 10000)\n"
+        "  --skew X             degree power law, 1=uniform (default 2)\n"
+        "  --cycles N           planted cycles              (default 50)\n"
+        "  --fan-bursts N       planted fan-in/out bursts   (default 20)\n"
+        "  --fan-size N         counterparties per burst    (default 15)\n"
+        "  --shells N           planted shell chains        (default 20)\n"
+        "  --days N             time span                   (default 90)\n"
+        "  --seed N             generator seed              (default 1)\n"
+        "  --threads N          shared pool workers         (default: cores)\n"
+        "  --repeat N           passes over every stage     (default 3)\n"
+        "  --write-csv PATH     also save the generated CSV\n"
+        "  --out PATH           report file                 (default stdout)\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    mm::SyntheticSpec spec;
+    std::string input, write_csv, out_path;
+    size_t repeat = 3;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") { usage(); return 0; }
+        if (i + 1 >= argc) { usage(); return 2; }
+        const char* v = argv[++i];
+        const auto n = [&] { return (size_t)std::strtoull(v, nullptr, 10); };
+        if      (arg == "--input")        input = v;
+        else if (arg == "--transactions") spec.transactions = n();
+        else if (arg == "--accounts")     spec.accounts = n();
+        else if (arg == "--skew")         spec.skew = std::max(std::strtod(v, nullptr), 1.0);
+        else if (arg == "--cycles")       spec.cycles = n();
+        else if (arg == "--fan-bursts")   spec.fan_bursts = n();
+        else if (arg == "--fan-size")     spec.fan_size = n();
+        else if (arg == "--shells")       spec.shell_chains = n();
+        else if (arg == "--days")         spec.days = std::max((int)n(), 2);
+        else if (arg == "--seed")         spec.seed = n();
+        else if (arg == "--threads")      mm::ThreadPool::set_shared_threads(std::max<size_t>(n(), 1));
+        else if (arg == "--repeat")       repeat = std::max<size_t>(n(), 1);
+        else if (arg == "--write-csv")    write_csv = v;
+        else if (arg == "--out")          out_path = v;
+        else { usage(); return 2; }
+    }
+
+    std::string csv;
+    if (!input.empty()) {
+        std::ifstream f(input, std::ios::binary);
+        if (!f) { std::fprintf(stderr, "mm_bench: cannot read %s\n", input.c_str()); return 1; }
+        std::ostringstream ss;
+        ss << f.rdbuf();
+        csv = ss.str();
+    } else {
+        csv = mm::SyntheticGenerator(spec).csv();
+        if (!write_csv.empty()) std::ofstream(write_csv, std::ios::binary) << csv;
+    }
+
+    try {
+        Bench bench;
+        PassResult pass;
+        for (size_t r = 0; r < repeat; ++r) pass = run_pass(bench, csv, mm::DetectionConfig{});
+
+        const std::string report = report_json(bench, spec, input.empty(), input, repeat,
+                                               csv.size(), pass);
+        if (out_path.empty()) {
+            std::fwrite(report.data(), 1, report.size(), stdout);
+        } else {
+            std::ofstream f(out_path, std::ios::binary);
+            if (!(f << report)) {
+                std::fprintf(stderr, "mm_bench: cannot write %s\n", out_path.c_str());
+                return 1;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "mm_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+#pragma once
+// ============================================================================
+// Synthetic – reproducible transaction datasets for mm_bench
+//
+// Background traffic between `accounts` accounts, with sender and receiver
+// drawn from a power law (skew 1 = uniform; larger skews concentrate
+// traffic on low-numbered hubs), plus planted patterns each detector
+// should report:
+//
+//   cycles       length 3–5, every hop inside one cycle window
+//   fan bursts   one hub paid by (fan-in) or paying (fan-out) `fan_size`
+//                distinct counterparties within a smurfing window
+//   shell chains source → 2–4 low-activity pass-through accounts → sink
+//
+// Planted accounts use their own prefixes (CYC_, FAN_, SHL_), so they
+// never overlap background accounts.  The same spec and seed always give
+// the same bytes.
+// ============================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace mm {
+
+struct SyntheticSpec {
+    size_t   accounts     = 10000;
+    size_t   transactions = 100000;   // background rows
+    double   skew         = 2.0;      // degree power law (1 = uniform)
+    size_t   cycles       = 50;
+    size_t   fan_bursts   = 20;
+    size_t   fan_size     = 15;       // counterparties per burst
+    size_t   shell_chains = 20;
+    int      days         = 90;       // time span of the data
+    uint64_t seed         = 1;
+};
+
+class SyntheticGenerator {
+public:
+    static constexpr std::time_t EPOCH = 1704067200;   // 2024-01-01 00:00:00 UTC
+
+    explicit SyntheticGenerator(const SyntheticSpec& spec) : spec_(spec), rng_(spec.seed) {}
+
+    // CSV with the standard header, rows shuffled
+    std::string csv() {
+        rows_.clear();
+        rows_.reserve(spec_.transactions + spec_.cycles * 5 +
+                      spec_.fan_bursts * spec_.fan_size + spec_.shell_chains * 5);
+        background();
+        plant_cycles();
+        plant_fan_bursts();
+        plant_shell_chains();
+        std::shuffle(rows_.begin(), rows_.end(), rng_);
+
+        std::string out = "transaction_id,sender_id,receiver_id,amount,timestamp\n";
+        out.reserve(rows_.size() * 64);
+        char line[160], ts[32];
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            const Row& r = rows_[i];
+            const std::time_t t = EPOCH + r.seconds;
+            std::tm tm{};
+            gmtime_r(&t, &tm);
+            std::strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", &tm);
+            const int n = std::snprintf(line, sizeof(line), "T%zu,%s,%s,%.2f,%s\n", i + 1,
+                                        r.sender.c_str(), r.receiver.c_str(), r.amount, ts);
+            out.append(line, (size_t)n);
+        }
+        return out;
+    }
+
+    size_t rows() const { return rows_.size(); }
+
+private:
+    struct Row {
+        std::string sender, receiver;
+        double      amount;
+        int64_t     seconds;   // since EPOCH
+    };
+
+    SyntheticSpec   spec_;
+    std::mt19937_64 rng_;
+    std::vector<Row> rows_;
+
+    int64_t span() const { return (int64_t)spec_.days * 86400; }
+
+    double  uniform(double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng_); }
+    int64_t when(int64_t lo, int64_t hi)  { return std::uniform_int_distribution<int64_t>(lo, hi)(rng_); }
+
+    // Power-law account index: u^skew piles mass near 0
+    size_t pick() {
+        const double u = uniform(0.0, 1.0);
+        return std::min(spec_.accounts - 1, (size_t)(std::pow(u, spec_.skew) * (double)spec_.accounts));
+    }
+
+    static std::string name(const char* prefix, size_t a, size_t b = SIZE_MAX) {
+        char buf[48];
+        if (b == SIZE_MAX) std::snprintf(buf, sizeof(buf), "%s%06zu", prefix, a);
+        else               std::snprintf(buf, sizeof(buf), "%s%zu_%zu", prefix, a, b);
+        return buf;
+    }
+
+    void add(std::string s, std::string r, double amount, int64_t t) {
+        rows_.push_back({std::move(s), std::move(r), std::round(amount * 100.0) / 100.0, t});
+    }
+
+    void background() {
+        if (spec_.accounts < 2) return;
+        for (size_t i = 0; i < spec_.transactions; ++i) {
+            const size_t s = pick();
+            size_t r = pick();
+            if (r == s) r = (r + 1) % spec_.accounts;
+            add(name("ACC_", s), name("ACC_", r), uniform(10.0, 5000.0), when(0, span()));
+        }
+    }
+
+    // Hops 4h apart: a length-5 cycle spans 16h, inside the 72h window
+    void plant_cycles() {
+        for (size_t c = 0; c < spec_.cycles; ++c) {
+            const size_t len = 3 + c % 3;
+            const int64_t t0 = when(0, span() - 86400);
+            const double amount = uniform(1000.0, 9000.0);
+            for (size_t k = 0; k < len; ++k)
+                add(name("CYC_", c, k), name("CYC_", c, (k + 1) % len),
+                    amount * (1.0 - 0.02 * (double)k), t0 + (int64_t)k * 4 * 3600);
+        }
+    }
+
+    // fan_size counterparties inside 48h
+    void plant_fan_bursts() {
+        for (size_t b = 0; b < spec_.fan_bursts; ++b) {
+            const bool fan_in = b % 2 == 0;
+            const std::string hub = name("FAN_HUB_", b);
+            const int64_t t0 = when(0, span() - 3 * 86400);
+            for (size_t k = 0; k < spec_.fan_size; ++k) {
+                const std::string other = name("FAN_", b, k);
+                const double amount = uniform(500.0, 9500.0);
+                const int64_t t = t0 + when(0, 48 * 3600);
+                if (fan_in) add(other, hub, amount, t);
+                else        add(hub, other, amount, t);
+            }
+        }
+    }
+
+    // Each intermediate has exactly one row in and one out (≤ 3 txns)
+    void plant_shell_chains() {
+        for (size_t c = 0; c < spec_.shell_chains; ++c) {
+            const size_t hops = 3 + c % 3;       // 2–4 intermediates
+            const int64_t t0 = when(0, span() - 86400);
+            double amount = uniform(5000.0, 20000.0);
+            for (size_t k = 0; k < hops; ++k) {
+                const std::string from = k == 0 ? name("SHL_SRC_", c) : name("SHL_", c, k);
+                const std::string to   = k + 1 == hops ? name("SHL_SINK_", c) : name("SHL_", c, k + 1);
+                add(from, to, amount, t0 + (int64_t)k * 3600);
+                amount *= 0.98;
+            }
+        }
+    }
+};
+
+} // namespace mm
@@ -7,6 +7,15 @@
 //   → build_profiles → apply_filters → calculate_scores
 //   → build_suspicious_accounts → build_fraud_rings → build_graph_data
 //
+// Every stage is timed into result.timings (see metrics.h), along with the
+// cycle / shell search counters.
+//
+// An optional CancelToken (see cancel_token.h) is passed to every
+// detector.  A cancelled analysis fails with "Analysis cancelled"; one
+// that hits its deadline still scores what the detectors found and comes
+// back completed with `truncated` set.  Progress (0..1) is reported to an
+// optional hook as stages finish.
+//
 // Spec-compliance notes:
 //   • detected_patterns format: "cycle_length_N", "fan_in", "fan_out",
 //     "shell", "high_velocity"
@@ -15,22 +24,29 @@
 //   • summary.processing_time_seconds matches spec download JSON format
 // ============================================================================
 
+#include "arena.h"
+#include "cancel_token.h"
 #include "models.h"
 #include "csv_parser.h"
 #include "graph_engine.h"
 #include "cycle_detector.h"
 #include "smurfing_detector.h"
 #include "shell_detector.h"
+#include "detection_config.h"
+#include "detection_index.h"
 #include "filters.h"
+#include "metrics.h"
 #include "scoring.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
-#include <future>
-#include <set>
+#include <functional>
+#include <memory_resource>
+#include <mutex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 namespace mm {
@@ -38,161 +54,194 @@ namespace mm {
 class AnalysisEngine {
 public:
 
+    using Clock = std::chrono::steady_clock;
+
+    // Called with the built graph before detection (e.g. to snapshot it)
+    using GraphHook = std::function<void(const TransactionGraph&)>;
+
+    // Called with the fraction of the pipeline done, as stages finish
+    using ProgressHook = std::function<void(double)>;
+
+    // Fraction done after each step; the three detectors share DETECTION
+    static constexpr double PROGRESS_PARSED    = 0.15;
+    static constexpr double PROGRESS_GRAPH     = 0.25;
+    static constexpr double PROGRESS_DETECTION = 0.45;
+    static constexpr double PROGRESS_FILTERED  = 0.80;
+
+    /**
+     * Forwards to a ProgressHook, dropping values that would move it
+     * backwards (the detectors finish on different threads in any order).
+     */
+    class Progress {
+    public:
+        explicit Progress(const ProgressHook& hook) : hook_(hook) {}
+
+        void report(double fraction) {
+            if (!hook_) return;
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (fraction <= last_) return;
+            last_ = fraction;
+            hook_(fraction);
+        }
+
+        // One of the three detectors finished
+        void detector_done() {
+            report(PROGRESS_GRAPH + PROGRESS_DETECTION * (double)++detectors_ / 3.0);
+        }
+
+    private:
+        const ProgressHook& hook_;
+        std::mutex          mtx_;
+        double              last_ = 0.0;
+        std::atomic<int>    detectors_{0};
+    };
+
     /**
      * Run the full analysis pipeline on raw CSV content.
      * Returns a fully populated AnalysisResult.
      */
-    static AnalysisResult run(const std::string& analysis_id,
-                              const std::string& csv_content)
+    static AnalysisResult run(const std::string&     analysis_id,
+                              std::string_view       csv_content,
+                              const DetectionConfig& config      = {},
+                              const GraphHook&       on_graph    = {},
+                              const CancelToken*     cancel      = nullptr,
+                              const ProgressHook&    on_progress = {})
     {
-        using Clock = std::chrono::steady_clock;
-
         AnalysisResult result;
         result.analysis_id = analysis_id;
         result.status      = AnalysisStatus::PROCESSING;
 
         auto t0 = Clock::now();
+        Timings timings;
+        Progress progress(on_progress);
 
         try {
             // ── 1. Parse CSV ─────────────────────────────────────────
-            auto parsed = parse_csv(csv_content);
+            CsvParseResult parsed;
+            {
+                ScopedStage stage(timings, Stage::PARSE);
+                parsed = parse_csv(csv_content);
+            }
             if (!parsed.ok) {
                 result.status = AnalysisStatus::FAILED;
                 result.error  = parsed.error;
                 return result;
             }
-
-            auto& transactions = parsed.transactions;
-            if (transactions.empty()) {
-                result.status = AnalysisStatus::FAILED;
-                result.error  = "No valid transactions found in CSV";
-                return result;
-            }
+            if (cancel && cancel->cancelled()) return cancelled(std::move(result));
+            progress.report(PROGRESS_PARSED);
 
             // ── 2. Build Transaction Graph ───────────────────────────
+            // The graph keeps its own columns; drop the parsed rows
+            // before detection so peak memory is one copy, not two.
             TransactionGraph graph;
-            graph.build(transactions);
-
-            // ── 3. Detect patterns in parallel ───────────────────────
-            auto fut_cycles   = std::async(std::launch::async,
-                [&]{ return CycleDetector::detect(graph); });
-            auto fut_smurfing = std::async(std::launch::async,
-                [&]{ return SmurfingDetector::detect(transactions); });
-            auto fut_shells   = std::async(std::launch::async,
-                [&]{ return ShellDetector::detect(graph); });
-
-            auto cycles   = fut_cycles.get();
-            auto smurfing = fut_smurfing.get();
-            auto shells   = fut_shells.get();
-
-            // ── 4. Re-assign globally-unique ring IDs ────────────────
-            // Each detector uses its own counter; re-number globally so
-            // RING_001 is never duplicated across cycles/smurfing/shells.
-            assign_global_ring_ids(cycles, smurfing, shells);
-
-            // ── 5. Build account profiles ────────────────────────────
-            auto profiles = graph.build_profiles();
-
-            // ── 6. Apply false-positive filters ──────────────────────
-            Filters::apply(profiles, transactions);
-
-            // ── 7. Calculate scores (Decision Tree) ──────────────────
-            auto scores = Scoring::calculate_scores(profiles, cycles,
-                                                     smurfing, shells);
-
-            // ── 8. Build ring_map & pattern_map for graph + scoring ──
-            // ring_map:    account → [ring_ids]
-            // pattern_map: account → [raw pattern strings]
-            // spec_pattern_map: account → [spec-format pattern strings]
-            std::unordered_map<std::string, std::vector<std::string>> ring_map;
-            std::unordered_map<std::string, std::vector<std::string>> pattern_map;
-            std::unordered_map<std::string, std::set<std::string>>    spec_patterns;
-
-            for (const auto& c : cycles) {
-                // Spec format: "cycle_length_N"
-                std::string spec_pat = "cycle_length_" + std::to_string(c.length);
-                for (const auto& n : c.nodes) {
-                    ring_map[n].push_back(c.ring_id);
-                    pattern_map[n].push_back("cycle");
-                    spec_patterns[n].insert(spec_pat);
-                }
-            }
-            for (const auto& s : smurfing) {
-                ring_map[s.account_id].push_back(s.ring_id);
-                pattern_map[s.account_id].push_back(s.pattern_type);
-                spec_patterns[s.account_id].insert(s.pattern_type); // "fan_in"/"fan_out"
-                spec_patterns[s.account_id].insert("temporal_concentration"); // window evidence
-                if (s.velocity_per_hour > 5000.0)
-                    spec_patterns[s.account_id].insert("high_velocity");
-            }
-            for (const auto& s : shells) {
-                for (const auto& n : s.chain) {
-                    ring_map[n].push_back(s.ring_id);
-                    pattern_map[n].push_back("shell");
-                    spec_patterns[n].insert("layered_shell");
-                    spec_patterns[n].insert("shell"); 
-                }
+            {
+                ScopedStage stage(timings, Stage::GRAPH_BUILD);
+                graph.build(std::move(parsed.transactions));
+                parsed = CsvParseResult{};
             }
+            if (on_graph) on_graph(graph);
+            progress.report(PROGRESS_GRAPH);
 
-            // ── 9. Build suspicious accounts ─────────────────────────
-            auto suspicious = Scoring::build_suspicious_accounts(
-                scores, profiles, cycles, smurfing, shells, graph);
+            return run(analysis_id, graph, config, t0, timings, cancel, on_progress);
 
-            // Inject spec-format detected_patterns into each SuspiciousAccount
-            for (auto& sa : suspicious) {
-                auto it = spec_patterns.find(sa.account_id);
-                if (it != spec_patterns.end()) {
-                    sa.detected_patterns.assign(it->second.begin(),
-                                                it->second.end());
-                }
-            }
+        } catch (const std::exception& e) {
+            result.status = AnalysisStatus::FAILED;
+            result.error  = std::string("Analysis failed: ") + e.what();
+        }
 
-            // ── 10. Build fraud rings ─────────────────────────────────
-            auto fraud_rings = Scoring::build_fraud_rings(
-                scores, cycles, smurfing, shells);
+        return result;
+    }
 
-            // ── 11. Build graph data for frontend ────────────────────
-            auto graph_data = graph.build_graph_data(scores, ring_map,
-                                                      pattern_map);
+    /**
+     * Run detection, scoring and assembly on an already-built graph
+     * (the streaming upload path builds it incrementally, re-analysis
+     * maps it from a snapshot).  `t0` is when the analysis started, for
+     * processing_time_seconds; `timings` holds the stages already run.
+     */
+    static AnalysisResult run(const std::string&      analysis_id,
+                              const TransactionGraph& graph,
+                              const DetectionConfig&  config      = {},
+                              Clock::time_point       t0          = Clock::now(),
+                              Timings                 timings     = {},
+                              const CancelToken*      cancel      = nullptr,
+                              const ProgressHook&     on_progress = {})
+    {
+        AnalysisResult result;
+        result.analysis_id = analysis_id;
+        result.status      = AnalysisStatus::PROCESSING;
+        Progress progress(on_progress);
 
-            // Inject spec_patterns into graph nodes too
-            for (auto& gn : graph_data.nodes) {
-                auto it = spec_patterns.find(gn.id);
-                if (it != spec_patterns.end()) {
-                    gn.detected_patterns.assign(it->second.begin(),
-                                                it->second.end());
+        try {
+            if (graph.transaction_count() == 0) {
+                result.status = AnalysisStatus::FAILED;
+                result.error  = "No valid transactions found in CSV";
+                return result;
+            }
+            if (cancel && cancel->cancelled()) return cancelled(std::move(result));
+
+            // ── 3. Detect patterns in parallel ───────────────────────
+            // On the shared pool (this job usually runs on it too);
+            // parallel_for lets this thread take a detector itself, so
+            // it cannot deadlock when every worker is busy.
+            std::vector<DetectedCycle>    cycles;
+            std::vector<DetectedSmurfing> smurfing;
+            std::vector<DetectedShell>    shells;
+            CycleDetector::Stats          cycle_stats;
+            auto& pool = ThreadPool::shared();
+            pool.parallel_for(3, [&](size_t i) {
+                switch (i) {
+                    case 0: {
+                        ScopedStage stage(timings, Stage::CYCLES);
+                        cycles = CycleDetector::detect(graph, config.cycle_max_length,
+                                                       config.cycle_window_hours,
+                                                       config.max_cycles,
+                                                       config.max_steps_per_root,
+                                                       pool, &cycle_stats, cancel,
+                                                       &timings.max_cycles_reached);
+                        break;
+                    }
+                    case 1: {
+                        ScopedStage stage(timings, Stage::SMURFING);
+                        smurfing = SmurfingDetector::detect(graph, config.fan_threshold,
+                                                            config.smurfing_window_hours,
+                                                            cancel);
+                        break;
+                    }
+                    default: {
+                        ScopedStage stage(timings, Stage::SHELLS);
+                        shells = ShellDetector::detect(graph, config.max_intermediate_txns,
+                                                       config.min_chain_length,
+                                                       config.max_chain_length,
+                                                       config.max_chains,
+                                                       pool, &timings.shell_steps, cancel,
+                                                       &timings.max_chains_reached);
+                        break;
+                    }
                 }
+                progress.detector_done();
+            });
+            add_cycle_stats(timings, cycle_stats);
+
+            // A deadline keeps what was found; a cancel drops everything
+            if (cancel && cancel->cancelled()) return cancelled(std::move(result));
+            const bool truncated = cancel && cancel->stopped();
+
+            // ── 4. Build account profiles ────────────────────────────
+            std::vector<AccountProfile> profiles;
+            {
+                ScopedStage stage(timings, Stage::PROFILES);
+                profiles = graph.build_profiles();
             }
 
-            // ── 12. Build summary ────────────────────────────────────
-            Summary summary;
-            summary.total_transactions       = (int)transactions.size();
-            summary.total_accounts_analyzed  = (int)profiles.size();
-            summary.suspicious_accounts_flagged = (int)suspicious.size();
-            summary.fraud_rings_detected     = (int)fraud_rings.size();
-            summary.total_cycles             = (int)cycles.size();
-            summary.total_smurfing_patterns  = (int)smurfing.size();
-            summary.total_shell_patterns     = (int)shells.size();
-
-            double total_at_risk = 0.0;
-            for (const auto& c : cycles)  total_at_risk += c.total_amount;
-            for (const auto& s : shells)  total_at_risk += s.total_amount;
-            summary.total_amount_at_risk = total_at_risk;
-
-            auto t1        = Clock::now();
-            auto elapsed   = std::chrono::duration<double>(t1 - t0).count();
-            summary.processing_time_seconds = elapsed;
-
-            // ── 13. Assemble result ──────────────────────────────────
-            result.status              = AnalysisStatus::COMPLETED;
-            result.summary             = std::move(summary);
-            result.suspicious_accounts = std::move(suspicious);
-            result.fraud_rings         = std::move(fraud_rings);
-            result.cycles              = std::move(cycles);
-            result.smurfing            = std::move(smurfing);
-            result.shells              = std::move(shells);
-            result.graph_data          = std::move(graph_data);
-            result.processing_time_ms  = elapsed * 1000.0;
+            // ── 5. Apply false-positive filters ──────────────────────
+            {
+                ScopedStage stage(timings, Stage::FILTERS);
+                Filters::apply(profiles, graph);
+            }
+            progress.report(PROGRESS_FILTERED);
+
+            return assemble(analysis_id, graph, profiles, cycles, smurfing, shells,
+                            config, timings, t0, truncated);
 
         } catch (const std::exception& e) {
             result.status = AnalysisStatus::FAILED;
@@ -202,26 +251,148 @@ public:
         return result;
     }
 
+    /**
+     * Steps after detection: global ring IDs, scoring, suspicious accounts,
+     * fraud rings, graph data and summary.  This is where detector output
+     * (NodeIds) is first turned into account names.  `profiles` (indexed by NodeId)
+     * must already have the filter flags applied; `config` supplies the
+     * connected_accounts cap and `timings` the stages run so far (with
+     * the detectors' max_*_reached flags).
+     * `truncated`: detection stopped at its deadline.  Shared by run() and
+     * AnalysisSession.
+     */
+    static AnalysisResult assemble(
+        const std::string&                                     analysis_id,
+        const TransactionGraph&                                graph,
+        const std::vector<AccountProfile>&                     profiles,
+        const std::vector<DetectedCycle>&                      cycles,
+        const std::vector<DetectedSmurfing>&                   smurfing,
+        const std::vector<DetectedShell>&                      shells,
+        const DetectionConfig&                                 config,
+        Timings                                                timings,
+        Clock::time_point                                      t0,
+        bool                                                   truncated = false)
+    {
+        AnalysisResult result;
+        result.analysis_id = analysis_id;
+        auto mark = Clock::now();   // scoring stage: ring IDs, index, scores
+
+        // The index and scratch below die with this call; they share one
+        // arena, released in a single step on return
+        Arena arena = Arena::for_accounts(profiles.size());
+        std::pmr::memory_resource* mem = arena.resource();
+
+        // ── 6. Index rings and patterns by account (one sweep) ───
+        // Rings are numbered across cycles, then smurfing, then shells,
+        // so RING_001 is never duplicated across detectors.
+        DetectionIndex index(graph, cycles, smurfing, shells, mem);
+
+        // ── 7. Name detector output (first use of account names) ─
+        std::vector<CycleResult>    cycle_results;
+        std::vector<SmurfingResult> smurfing_results;
+        std::vector<ShellResult>    shell_results;
+        name_results(graph, index, cycles, smurfing, shells,
+                     cycle_results, smurfing_results, shell_results);
+
+        // ── 8. Calculate scores (Decision Tree) ──────────────────
+        auto scores = Scoring::calculate_scores(profiles, index);
+        timings[Stage::SCORING] += std::chrono::duration<double>(Clock::now() - mark).count();
+        mark = Clock::now();
+
+        // ── 9. Build suspicious accounts ─────────────────────────
+        auto suspicious = Scoring::build_suspicious_accounts(
+            scores, profiles, index, graph, config.max_connected_accounts, mem);
+
+        // ── 10. Build fraud rings ─────────────────────────────────
+        auto fraud_rings = Scoring::build_fraud_rings(scores, index, graph, mem);
+
+        // ── 11. Build graph data for frontend ────────────────────
+        auto graph_data = Scoring::build_graph_data(graph, scores, index);
+
+        // ── 12. Build summary ────────────────────────────────────
+        Summary summary;
+        summary.total_transactions       = (int)graph.transaction_count();
+        summary.total_accounts_analyzed  = (int)profiles.size();
+        summary.suspicious_accounts_flagged = (int)suspicious.size();
+        summary.fraud_rings_detected     = (int)fraud_rings.size();
+        summary.total_cycles             = (int)cycles.size();
+        summary.total_smurfing_patterns  = (int)smurfing.size();
+        summary.total_shell_patterns     = (int)shells.size();
+
+        double total_at_risk = 0.0;
+        for (const auto& c : cycles)  total_at_risk += c.total_amount;
+        for (const auto& s : shells)  total_at_risk += s.total_amount;
+        summary.total_amount_at_risk = total_at_risk;
+
+        auto t1        = Clock::now();
+        auto elapsed   = std::chrono::duration<double>(t1 - t0).count();
+        summary.processing_time_seconds = elapsed;
+        timings[Stage::ASSEMBLY] += std::chrono::duration<double>(t1 - mark).count();
+        timings.peak_rss_bytes    = peak_rss_bytes();
+
+        // ── 13. Assemble result ──────────────────────────────────
+        result.status              = AnalysisStatus::COMPLETED;
+        result.summary             = std::move(summary);
+        result.suspicious_accounts = std::move(suspicious);
+        result.fraud_rings         = std::move(fraud_rings);
+        result.cycles              = std::move(cycle_results);
+        result.smurfing            = std::move(smurfing_results);
+        result.shells              = std::move(shell_results);
+        result.graph_data          = std::move(graph_data);
+        result.timings             = timings;
+        result.processing_time_ms  = elapsed * 1000.0;
+        result.progress            = 1.0;
+        result.truncated           = truncated;
+
+        return result;
+    }
+
+    // Fold cycle search counters into an analysis' timings
+    static void add_cycle_stats(Timings& timings, const CycleDetector::Stats& stats) {
+        timings.cycle_steps             += stats.steps;
+        timings.cycle_temporal_rejects  += stats.temporal_rejects;
+        timings.cycle_step_capped_roots += stats.step_capped_roots;
+    }
+
+    // Failed result for an analysis whose token was cancelled
+    static AnalysisResult cancelled(AnalysisResult result) {
+        result.status = AnalysisStatus::FAILED;
+        result.error  = "Analysis cancelled";
+        return result;
+    }
+
 private:
     /**
-     * Re-number ring IDs globally so cycles, smurfing, and shells
-     * never produce duplicate RING_NNN identifiers.
+     * Resolve account names; ring IDs come from the index, whose RingIds
+     * follow the same cycles ++ smurfing ++ shells order.
      */
-    static void assign_global_ring_ids(
-        std::vector<CycleResult>&    cycles,
-        std::vector<SmurfingResult>& smurfing,
-        std::vector<ShellResult>&    shells)
+    static void name_results(
+        const TransactionGraph&              graph,
+        const DetectionIndex&                index,
+        const std::vector<DetectedCycle>&    cycles,
+        const std::vector<DetectedSmurfing>& smurfing,
+        const std::vector<DetectedShell>&    shells,
+        std::vector<CycleResult>&            cycle_results,
+        std::vector<SmurfingResult>&         smurfing_results,
+        std::vector<ShellResult>&            shell_results)
     {
-        int counter = 1;
-        auto make_id = [](int n) {
-            char buf[16];
-            snprintf(buf, sizeof(buf), "RING_%03d", n);
-            return std::string(buf);
-        };
-
-        for (auto& c : cycles)   c.ring_id = make_id(counter++);
-        for (auto& s : smurfing) s.ring_id  = make_id(counter++);
-        for (auto& s : shells)   s.ring_id  = make_id(counter++);
+        DetectionIndex::RingId r = 0;
+
+        cycle_results.reserve(cycles.size());
+        for (const auto& c : cycles) {
+            cycle_results.push_back(CycleDetector::to_result(graph, c));
+            cycle_results.back().ring_id = index.ring_id(r++);
+        }
+        smurfing_results.reserve(smurfing.size());
+        for (const auto& s : smurfing) {
+            smurfing_results.push_back(SmurfingDetector::to_result(graph, s));
+            smurfing_results.back().ring_id = index.ring_id(r++);
+        }
+        shell_results.reserve(shells.size());
+        for (const auto& s : shells) {
+            shell_results.push_back(ShellDetector::to_result(graph, s));
+            shell_results.back().ring_id = index.ring_id(r++);
+        }
     }
 };
 
@@ -0,0 +1,205 @@
+#pragma once
+// ============================================================================
+// Analysis Executor – admission control for request-level analysis jobs
+//
+// Every analysis (upload, stream finish, session append) is a job run on
+// the shared ThreadPool, the same pool the detectors use for their own
+// parallel_for work, so the process never runs more analysis threads
+// than the pool has workers.
+//
+// At most `max_running` jobs are handed to the pool at once; the rest wait
+// here, in FIFO order, so a job's detector tasks are never stuck behind
+// whole queued analyses.  Once `max_queued` jobs are waiting, submit()
+// refuses new ones and the HTTP layer answers 503 with a retry hint.
+//
+// Each job gets a CancelToken (see cancel_token.h), armed with the
+// configured deadline when the job starts running.  cancel() drops an
+// analysis' waiting jobs and cancels its running ones.
+// ============================================================================
+
+#include "cancel_token.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+class AnalysisExecutor {
+public:
+    static constexpr size_t DEFAULT_MAX_QUEUED       = 64;
+    static constexpr int    DEFAULT_RETRY_AFTER_SECS = 5;   // before any job has finished
+    static constexpr int    MAX_RETRY_AFTER_SECS     = 300;
+    static constexpr std::chrono::seconds DEFAULT_DEADLINE{300};   // per running job
+
+    struct Admission {
+        bool   accepted       = false;
+        size_t queue_position = 0;     // 1-based; 0 = handed to the pool
+        int    retry_after    = 0;     // seconds, when rejected
+    };
+
+    using Clock = std::chrono::steady_clock;
+    using Job   = std::function<void(const CancelToken&)>;
+
+    static AnalysisExecutor& instance() {
+        static AnalysisExecutor e;
+        return e;
+    }
+
+    ~AnalysisExecutor() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        waiting_.clear();
+        for (auto& a : active_) a.token->cancel();
+        idle_.wait(lock, [this] { return running_ == 0; });
+    }
+
+    // Limits; call before serving (0 keeps the current value)
+    void configure(size_t max_running, size_t max_queued) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (max_running) max_running_ = max_running;
+        if (max_queued)  max_queued_  = max_queued;
+    }
+
+    // Run time allowed per job from when it starts (0 = no deadline)
+    void set_deadline(std::chrono::seconds deadline) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        deadline_ = deadline;
+    }
+
+    /**
+     * Run job() for analysis `id` on the pool, or queue it if max_running
+     * jobs are already in flight.  Fails (and never runs job) when the
+     * queue is full.  job must report its own result, e.g. via Store, and
+     * should pass its token on to AnalysisEngine.
+     */
+    Admission submit(const std::string& id, Job job) {
+        Admission a;
+        std::lock_guard<std::mutex> lock(mtx_);
+        Waiting w{id, std::make_shared<CancelToken>(), std::move(job)};
+        if (running_ < max_running_) {
+            ++running_;
+            dispatch(std::move(w));
+            a.accepted = true;
+            return a;
+        }
+        if (waiting_.size() >= max_queued_) {
+            a.retry_after = retry_after_locked();
+            return a;
+        }
+        waiting_.push_back(std::move(w));
+        a.accepted       = true;
+        a.queue_position = waiting_.size();
+        return a;
+    }
+
+    // 1-based position of `id` among waiting jobs; 0 if it is not waiting
+    size_t queue_position(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (size_t i = 0; i < waiting_.size(); ++i)
+            if (waiting_[i].id == id) return i + 1;
+        return 0;
+    }
+
+    /**
+     * Drop every waiting job of analysis `id` and cancel its running ones
+     * (they stop at their next check and report a failure).  Returns
+     * whether any job was found.
+     */
+    bool cancel(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        const size_t before = waiting_.size();
+        std::erase_if(waiting_, [&](const Waiting& w) { return w.id == id; });
+        bool found = waiting_.size() != before;
+        for (auto& a : active_) {
+            if (a.id != id) continue;
+            a.token->cancel();
+            found = true;
+        }
+        return found;
+    }
+
+    size_t running() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return running_;
+    }
+
+    size_t queued() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return waiting_.size();
+    }
+
+private:
+    struct Waiting {
+        std::string                  id;
+        std::shared_ptr<CancelToken> token;
+        Job                          job;
+    };
+
+    // A job handed to the pool, for cancel()
+    struct Active {
+        std::string                  id;
+        std::shared_ptr<CancelToken> token;
+    };
+
+    ThreadPool&             pool_;
+    std::mutex              mtx_;
+    std::condition_variable idle_;
+    std::deque<Waiting>     waiting_;
+    std::vector<Active>     active_;
+    size_t                  running_      = 0;
+    size_t                  max_running_;
+    size_t                  max_queued_   = DEFAULT_MAX_QUEUED;
+    double                  avg_job_secs_ = 0.0;   // EWMA of finished jobs
+    std::chrono::seconds    deadline_     = DEFAULT_DEADLINE;
+
+    AnalysisExecutor() : pool_(ThreadPool::shared()), max_running_(pool_.size()) {}
+    AnalysisExecutor(const AnalysisExecutor&) = delete;
+    AnalysisExecutor& operator=(const AnalysisExecutor&) = delete;
+
+    // Called with mtx_ held; the pool never calls back under its own lock
+    void dispatch(Waiting w) {
+        active_.push_back({w.id, w.token});
+        pool_.submit([this, token = std::move(w.token), job = std::move(w.job),
+                      deadline = deadline_]() mutable {
+            const auto t0 = Clock::now();
+            token->arm(deadline);
+            try { job(*token); } catch (...) {}
+            finished(token.get(), std::chrono::duration<double>(Clock::now() - t0).count());
+        });
+    }
+
+    // Re-queue onto the pool rather than looping here, so the next job
+    // lines up behind detector tasks already submitted
+    void finished(const CancelToken* token, double secs) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        std::erase_if(active_, [&](const Active& a) { return a.token.get() == token; });
+        avg_job_secs_ = avg_job_secs_ == 0.0 ? secs : 0.8 * avg_job_secs_ + 0.2 * secs;
+        if (!waiting_.empty()) {
+            auto next = std::move(waiting_.front());
+            waiting_.pop_front();
+            dispatch(std::move(next));
+            return;
+        }
+        if (--running_ == 0) idle_.notify_all();
+    }
+
+    // Rough seconds until a queue slot frees: with max_running jobs in
+    // flight, one finishes every avg / max_running seconds
+    int retry_after_locked() const {
+        if (avg_job_secs_ == 0.0) return DEFAULT_RETRY_AFTER_SECS;
+        const int secs = (int)std::ceil(avg_job_secs_ / (double)max_running_);
+        return std::clamp(secs, 1, MAX_RETRY_AFTER_SECS);
+    }
+};
+
+} // namespace mm
@@ -0,0 +1,425 @@
+#pragma once
+// ============================================================================
+// Analysis Session – incremental re-analysis for append-only feeds
+//
+// A session keeps every transaction seen so far for one analysis_id, plus
+// the account profiles and per-account / per-root / per-source detector
+// output.  ingest() folds in a CSV delta, rebuilds the CSR from the
+// retained columns (linear, cheap next to detection) and re-runs a
+// detector only where the new rows can change what it reports:
+//
+//   profiles, filters, smurfing – accounts that sent or received a new txn
+//   cycles – roots within max_length-1 hops upstream of a new txn's sender
+//            (only those DFS trees read a changed row)
+//   shells – sources that reach a touched account through shell candidates
+//
+// Cached lists are concatenated in the order a full run uses (see
+// CycleDetector::collect / ShellDetector::collect), so the result matches a
+// fresh analysis of all transactions so far.  A session's thresholds are
+// fixed when it is created.
+//
+// A CancelToken stops the cycle and shell searches like in a full run.
+// Their caches are then incomplete, so the session is left invalid and
+// the next ingest recomputes from scratch.
+// ============================================================================
+
+#include "analysis_engine.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mm {
+
+class AnalysisSession {
+public:
+    using Clock = AnalysisEngine::Clock;
+
+    explicit AnalysisSession(const DetectionConfig& config = {}) : config_(config) {}
+    AnalysisSession(const AnalysisSession&) = delete;
+    AnalysisSession& operator=(const AnalysisSession&) = delete;
+
+    // ingest() calls for one session are applied one at a time
+    std::mutex& mutex() { return mtx_; }
+
+    /**
+     * Parse `csv` (with its own header row), append its rows to the
+     * session and return the full analysis of everything ingested so far.
+     * The first call analyses from scratch; later calls only re-run
+     * detection where the new rows matter.  A CSV that fails to parse
+     * leaves the session unchanged.  `cancel` and `on_progress` work as
+     * in AnalysisEngine::run.
+     */
+    AnalysisResult ingest(const std::string& analysis_id, std::string_view csv,
+                          const CancelToken*                  cancel      = nullptr,
+                          const AnalysisEngine::ProgressHook& on_progress = {}) {
+        const auto t0 = Clock::now();
+        last_activity_ = t0;
+
+        AnalysisResult result;
+        result.analysis_id = analysis_id;
+        result.status      = AnalysisStatus::PROCESSING;
+        Timings timings;
+        AnalysisEngine::Progress progress(on_progress);
+
+        try {
+            CsvParseResult parsed;
+            {
+                ScopedStage stage(timings, Stage::PARSE);
+                parsed = parse_csv(csv);
+            }
+            if (!parsed.ok) {
+                result.status = AnalysisStatus::FAILED;
+                result.error  = parsed.error;
+                return result;
+            }
+            if (cancel && cancel->cancelled()) return AnalysisEngine::cancelled(std::move(result));
+            progress.report(AnalysisEngine::PROGRESS_PARSED);
+
+            // From here on the retained state is being modified; if
+            // anything throws, the next ingest recomputes from scratch
+            const bool incremental = valid_;
+            valid_ = false;
+
+            std::vector<NodeId> remap;
+            {
+                ScopedStage stage(timings, Stage::GRAPH_BUILD);
+                remap = history_.append(parsed.transactions);
+                graph_.build(history_);
+            }
+
+            const size_t N = graph_.node_count();
+            std::vector<uint8_t> sent(N, incremental ? 0 : 1);
+            std::vector<uint8_t> received(N, incremental ? 0 : 1);
+            if (incremental) {
+                const auto& rows = parsed.transactions;
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    sent[remap[rows.sender(i)]]       = 1;
+                    received[remap[rows.receiver(i)]] = 1;
+                }
+            }
+            parsed = CsvParseResult{};
+            progress.report(AnalysisEngine::PROGRESS_GRAPH);
+
+            std::vector<NodeId> touched;
+            for (NodeId id = 0; id < (NodeId)N; ++id)
+                if (sent[id] || received[id]) touched.push_back(id);
+
+            update_profiles(touched, timings);
+            std::vector<DetectedSmurfing> smurfing;
+            {
+                ScopedStage stage(timings, Stage::SMURFING);
+                smurfing = update_smurfing(sent, received);
+            }
+            progress.detector_done();
+            auto cycles = update_cycles(sent, incremental, timings, cancel);
+            progress.detector_done();
+            auto shells = update_shells(touched, incremental, timings, cancel);
+            progress.detector_done();
+
+            if (cancel && cancel->cancelled()) return AnalysisEngine::cancelled(std::move(result));
+            const bool truncated = cancel && cancel->stopped();
+            valid_ = !truncated;
+            ++ingests_;
+
+            return AnalysisEngine::assemble(analysis_id, graph_, profiles_,
+                                            cycles, smurfing, shells, config_, timings, t0,
+                                            truncated);
+
+        } catch (const std::exception& e) {
+            result.status = AnalysisStatus::FAILED;
+            result.error  = std::string("Analysis failed: ") + e.what();
+        }
+        return result;
+    }
+
+    size_t transaction_count() const { return graph_.transaction_count(); }
+    size_t ingest_count() const { return ingests_; }
+    Clock::time_point last_activity() const { return last_activity_.load(); }
+
+    // Mark the session active without its mutex (SessionStore::get)
+    void touch() { last_activity_.store(Clock::now()); }
+
+private:
+    std::mutex        mtx_;
+    DetectionConfig   config_;
+    std::atomic<Clock::time_point> last_activity_{Clock::now()};
+    bool              valid_   = false;   // caches match graph_
+    size_t            ingests_ = 0;
+
+    GraphBuilder      history_;           // every row so far, never consumed
+    TransactionGraph  graph_;
+    std::vector<AccountProfile> profiles_;   // by NodeId
+
+    // Smurfing – per account (NodeId)
+    std::vector<std::optional<DetectedSmurfing>> fan_in_;
+    std::vector<std::optional<DetectedSmurfing>> fan_out_;
+
+    // Cycles – per root (NodeId); root_done_[r] == 0 → search again
+    std::vector<std::vector<DetectedCycle>> root_cycles_;
+    std::vector<uint8_t>                  root_done_;
+
+    // Shells – per source (NodeId)
+    std::vector<std::vector<DetectedShell>> source_chains_;
+    std::vector<uint8_t>                  source_done_;
+    bool had_shell_ctx_    = false;
+    bool sources_fallback_ = false;
+    bool sinks_fallback_   = false;
+
+    void update_profiles(const std::vector<NodeId>& touched, Timings& timings) {
+        {
+            ScopedStage stage(timings, Stage::PROFILES);
+            profiles_.resize(graph_.node_count());
+            for (NodeId id : touched) profiles_[id] = graph_.build_profile(id);
+        }
+        ScopedStage stage(timings, Stage::FILTERS);
+        Filters::apply(profiles_, graph_, touched);
+    }
+
+    // Fan-in depends only on an account's incoming rows, fan-out only on
+    // its outgoing rows.  Output order matches SmurfingDetector::detect.
+    std::vector<DetectedSmurfing> update_smurfing(const std::vector<uint8_t>& sent,
+                                                const std::vector<uint8_t>& received) {
+        const NodeId N = (NodeId)graph_.node_count();
+        fan_in_.resize(N);
+        fan_out_.resize(N);
+        SmurfingDetector::Workspace ws(N);
+        for (NodeId id = 0; id < N; ++id) {
+            if (received[id])
+                fan_in_[id]  = SmurfingDetector::detect_account(graph_, id, false, ws,
+                                                                config_.fan_threshold,
+                                                                config_.smurfing_window_hours);
+            if (sent[id])
+                fan_out_[id] = SmurfingDetector::detect_account(graph_, id, true, ws,
+                                                                config_.fan_threshold,
+                                                                config_.smurfing_window_hours);
+        }
+
+        std::vector<DetectedSmurfing> results;
+        for (const auto& r : fan_in_)  if (r) results.push_back(*r);
+        for (const auto& r : fan_out_) if (r) results.push_back(*r);
+        return results;
+    }
+
+    std::vector<DetectedCycle> update_cycles(const std::vector<uint8_t>& sent,
+                                           bool incremental, Timings& timings,
+                                           const CancelToken* cancel) {
+        ScopedStage stage(timings, Stage::CYCLES);
+        const size_t N = graph_.node_count();
+        root_cycles_.resize(N);
+        root_done_.resize(N, 0);
+
+        if (!incremental) {
+            std::fill(root_done_.begin(), root_done_.end(), 0);
+        } else {
+            // A root's DFS reads the rows (and ranks) of nodes up to
+            // max_length-1 hops downstream; only senders of new rows have
+            // changed rows or out-degrees
+            std::vector<NodeId> seeds;
+            for (NodeId id = 0; id < (NodeId)N; ++id) if (sent[id]) seeds.push_back(id);
+            std::vector<uint8_t> stale(N, 0);
+            mark_upstream(seeds, config_.cycle_max_length - 1, nullptr, stale);
+            for (NodeId id = 0; id < (NodeId)N; ++id) if (stale[id]) root_done_[id] = 0;
+        }
+
+        // Stale roots are searched concurrently; each writes only its own
+        // cache slot
+        auto& pool = ThreadPool::shared();
+        const auto order = CycleDetector::root_order(graph_);
+        std::vector<CycleDetector::Workspace> ws(pool.max_workers());
+        auto results = CycleDetector::collect(order, config_.max_cycles, pool,
+            [&](NodeId root, int, size_t worker) -> const std::vector<DetectedCycle>& {
+                if (!root_done_[root]) {
+                    root_cycles_[root].clear();
+                    CycleDetector::search_root(graph_, order, root, ws[worker], root_cycles_[root],
+                                               config_.max_cycles, config_.cycle_max_length,
+                                               config_.cycle_window_hours,
+                                               config_.max_steps_per_root, cancel);
+                    root_done_[root] = 1;
+                }
+                return root_cycles_[root];
+            }, cancel, &timings.max_cycles_reached);
+        CycleDetector::Stats stats;
+        for (const auto& w : ws) stats += w.stats;
+        AnalysisEngine::add_cycle_stats(timings, stats);
+        return results;
+    }
+
+    std::vector<DetectedShell> update_shells(const std::vector<NodeId>& touched,
+                                           bool incremental, Timings& timings,
+                                           const CancelToken* cancel) {
+        ScopedStage stage(timings, Stage::SHELLS);
+        const size_t N = graph_.node_count();
+        source_chains_.resize(N);
+        source_done_.resize(N, 0);
+
+        auto ctx = ShellDetector::prepare(graph_, config_.max_intermediate_txns,
+                                          config_.min_chain_length, config_.max_chain_length);
+        if (!ctx) {
+            had_shell_ctx_ = false;
+            std::fill(source_done_.begin(), source_done_.end(), 0);
+            return {};
+        }
+
+        // The source/sink fallbacks change every node's role at once
+        const bool reset = !incremental || !had_shell_ctx_
+                        || ctx->sources_fallback != sources_fallback_
+                        || ctx->sinks_fallback   != sinks_fallback_;
+        had_shell_ctx_    = true;
+        sources_fallback_ = ctx->sources_fallback;
+        sinks_fallback_   = ctx->sinks_fallback;
+
+        if (reset) {
+            std::fill(source_done_.begin(), source_done_.end(), 0);
+        } else {
+            // Valid chains only pass through pass-through nodes, so a source
+            // is affected iff it reaches a touched account that way
+            std::vector<uint8_t> stale(N, 0);
+            mark_upstream(touched, ctx->max_chain_length, &ctx->pass_through, stale);
+            for (NodeId id = 0; id < (NodeId)N; ++id) if (stale[id]) source_done_[id] = 0;
+        }
+
+        auto& pool = ThreadPool::shared();
+        std::vector<ShellDetector::Workspace> ws(pool.max_workers());
+        auto results = ShellDetector::collect(*ctx, config_.max_chains, pool,
+            [&](NodeId source, int, size_t worker) -> const std::vector<DetectedShell>& {
+                if (!source_done_[source]) {
+                    source_chains_[source].clear();
+                    ShellDetector::search_source(graph_, *ctx, source, ws[worker],
+                                                 source_chains_[source],
+                                                 config_.max_chains, cancel);
+                    source_done_[source] = 1;
+                }
+                return source_chains_[source];
+            }, cancel, &timings.max_chains_reached);
+        for (const auto& w : ws) timings.shell_steps += w.steps;
+        return results;
+    }
+
+    /**
+     * Mark `seeds` and every node with a path of at most `max_hops` edges
+     * into a seed.  With `through`, a marked node is only expanded further
+     * if through[node] is set (seeds are always expanded).
+     */
+    void mark_upstream(const std::vector<NodeId>& seeds, int max_hops,
+                       const std::vector<uint8_t>* through,
+                       std::vector<uint8_t>& mark) const {
+        std::vector<NodeId> frontier, next;
+        for (NodeId s : seeds) {
+            if (!mark[s]) { mark[s] = 1; frontier.push_back(s); }
+        }
+        for (int hop = 0; hop < max_hops && !frontier.empty(); ++hop) {
+            next.clear();
+            for (NodeId x : frontier) {
+                for (NodeId p : graph_.predecessors(x)) {
+                    if (mark[p]) continue;
+                    mark[p] = 1;
+                    if (!through || (*through)[p]) next.push_back(p);
+                }
+            }
+            frontier.swap(next);
+        }
+    }
+};
+
+// ─── Session registry ─────────────────────────────────────────────────────
+
+class SessionStore {
+public:
+    using Clock = AnalysisSession::Clock;
+
+    // Sessions with no ingest for this long are dropped (matches the
+    // Redis result TTL)
+    static constexpr std::chrono::hours IDLE_TIMEOUT{24};
+    // Each session keeps every row it was sent, so their number is capped
+    static constexpr size_t DEFAULT_MAX_SESSIONS = 64;
+    // create() / get() look for idle sessions at most this often
+    static constexpr std::chrono::seconds SWEEP_INTERVAL{60};
+
+    static SessionStore& instance() {
+        static SessionStore s;
+        return s;
+    }
+
+    // Call before first use
+    void configure(size_t max_sessions) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        max_sessions_ = max_sessions;
+    }
+
+    /**
+     * New session under `id`; nullptr when max_sessions are open and none
+     * of them has been idle past IDLE_TIMEOUT.
+     */
+    std::shared_ptr<AnalysisSession> create(const std::string& id,
+                                            const DetectionConfig& config = {}) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        const bool full = sessions_.size() >= max_sessions_;
+        sweep_idle_locked(Clock::now(), full);
+        if (sessions_.size() >= max_sessions_ && !sessions_.count(id)) return nullptr;
+        auto session = std::make_shared<AnalysisSession>(config);
+        sessions_[id] = session;
+        return session;
+    }
+
+    // nullptr for unknown and expired sessions
+    std::shared_ptr<AnalysisSession> get(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        const auto now = Clock::now();
+        sweep_idle_locked(now);
+        auto it = sessions_.find(id);
+        if (it == sessions_.end()) return nullptr;
+        if (expired(*it->second, now)) {
+            sessions_.erase(it);
+            return nullptr;
+        }
+        // Under the store lock, so no sweep can drop it before the caller
+        // takes its mutex
+        it->second->touch();
+        return it->second;
+    }
+
+    void remove(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        sessions_.erase(id);
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return sessions_.size();
+    }
+
+private:
+    SessionStore() = default;
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    std::mutex        mtx_;
+    std::unordered_map<std::string, std::shared_ptr<AnalysisSession>> sessions_;
+    size_t            max_sessions_ = DEFAULT_MAX_SESSIONS;
+    Clock::time_point last_sweep_{};
+
+    // Idle past IDLE_TIMEOUT and not mid-ingest (its mutex is free)
+    static bool expired(AnalysisSession& session, Clock::time_point now) {
+        std::unique_lock<std::mutex> s_lock(session.mutex(), std::try_to_lock);
+        return s_lock.owns_lock() && now - session.last_activity() > IDLE_TIMEOUT;
+    }
+
+    // Every SWEEP_INTERVAL, or now when `force`d
+    void sweep_idle_locked(Clock::time_point now, bool force = false) {
+        if (!force && now - last_sweep_ < SWEEP_INTERVAL) return;
+        last_sweep_ = now;
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            if (expired(*it->second, now)) it = sessions_.erase(it);
+            else                           ++it;
+        }
+    }
+};
+
+} // namespace mm
@@ -0,0 +1,42 @@
+#pragma once
+// ============================================================================
+// Arena – per-analysis monotonic memory for transient pipeline containers
+//
+// Result assembly builds short-lived structures (the DetectionIndex,
+// neighbour sets, sort scratch …) that all die together when the result
+// is returned.  They allocate from one monotonic_buffer_resource: an
+// allocation is a pointer bump, a free is a no-op, and the blocks go back
+// to malloc in one release when the arena goes out of scope – so
+// concurrent analyses take the global allocator a few times each instead
+// of once per container node.
+// ============================================================================
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+
+namespace mm {
+
+class Arena {
+public:
+    static constexpr size_t DEFAULT_INITIAL_BYTES = 64u << 10;
+    static constexpr size_t BYTES_PER_ACCOUNT     = 256;       // sizing hint
+
+    explicit Arena(size_t initial_bytes = DEFAULT_INITIAL_BYTES)
+        : resource_(initial_bytes, std::pmr::new_delete_resource()) {}
+
+    // First block sized for an analysis of `accounts` accounts
+    static Arena for_accounts(size_t accounts) {
+        return Arena(std::max(DEFAULT_INITIAL_BYTES, accounts * BYTES_PER_ACCOUNT));
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &resource_; }
+
+private:
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+} // namespace mm
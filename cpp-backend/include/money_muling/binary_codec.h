@@ -0,0 +1,393 @@
+#pragma once
+// ============================================================================
+// Binary Codec – compact, versioned encoding of AnalysisResult
+//
+// Used for Redis persistence.  Layout (all integers LEB128 varints, signed
+// ones zig-zagged, doubles 8 bytes little-endian):
+//
+//   "MMAR" version
+//   string table:  count, then (length, bytes) per distinct string
+//   body:          every string field is an index into the table
+//
+// Account IDs, ring IDs and pattern names repeat across suspicious
+// accounts, rings, detector results and graph data, so each is stored
+// once.  Graph nodes and edges are written column by column (all ids,
+// then all labels, …), which keeps like values together.
+//
+// decode() bounds-checks every read and rejects unknown versions, so a
+// truncated or foreign value (e.g. an old JSON entry) reads as nullopt.
+// ============================================================================
+
+#include "models.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mm {
+
+class BinaryCodec {
+public:
+    static constexpr char    MAGIC[4] = {'M', 'M', 'A', 'R'};
+    static constexpr uint8_t VERSION  = 4;   // 2: connected_account_count, 3: timings, 4: truncated
+
+    static std::string encode(const AnalysisResult& r) {
+        Writer w;
+        w.str(r.analysis_id);
+        w.u((uint64_t)r.status);
+        w.str(r.error);
+        w.f(r.processing_time_ms);
+        w.f(r.progress);
+        w.u(r.truncated);
+
+        const Summary& s = r.summary;
+        w.i(s.total_transactions);
+        w.i(s.total_accounts_analyzed);
+        w.i(s.suspicious_accounts_flagged);
+        w.i(s.fraud_rings_detected);
+        w.i(s.total_cycles);
+        w.i(s.total_smurfing_patterns);
+        w.i(s.total_shell_patterns);
+        w.f(s.total_amount_at_risk);
+        w.f(s.processing_time_seconds);
+
+        const Timings& t = r.timings;
+        for (double secs : t.stage_seconds) w.f(secs);
+        w.u(t.cycle_steps);
+        w.u(t.cycle_temporal_rejects);
+        w.u(t.cycle_step_capped_roots);
+        w.u(t.max_cycles_reached);
+        w.u(t.shell_steps);
+        w.u(t.max_chains_reached);
+        w.u(t.peak_rss_bytes);
+
+        w.u(r.suspicious_accounts.size());
+        for (const auto& a : r.suspicious_accounts) {
+            w.str(a.account_id);
+            w.f(a.suspicion_score);
+            w.strs(a.detected_patterns);
+            w.str(a.ring_id);
+            w.str(a.account_type);
+            w.f(a.total_inflow);
+            w.f(a.total_outflow);
+            w.i(a.transaction_count);
+            w.strs(a.connected_accounts);
+            w.i(a.connected_account_count);
+            w.strs(a.ring_ids);
+        }
+
+        w.u(r.fraud_rings.size());
+        for (const auto& f : r.fraud_rings) {
+            w.str(f.ring_id);
+            w.strs(f.member_accounts);
+            w.str(f.pattern_type);
+            w.f(f.risk_score);
+        }
+
+        w.u(r.cycles.size());
+        for (const auto& c : r.cycles) {
+            w.str(c.ring_id);
+            w.strs(c.nodes);
+            w.i(c.length);
+            w.f(c.total_amount);
+            w.f(c.time_span_hours);
+            w.i(c.edge_count);
+            w.str(c.pattern_type);
+        }
+
+        w.u(r.smurfing.size());
+        for (const auto& m : r.smurfing) {
+            w.str(m.account_id);
+            w.str(m.pattern_type);
+            w.i(m.unique_counterparties);
+            w.f(m.total_amount);
+            w.f(m.velocity_per_hour);
+            w.str(m.window_start);
+            w.str(m.window_end);
+            w.str(m.ring_id);
+        }
+
+        w.u(r.shells.size());
+        for (const auto& sh : r.shells) {
+            w.str(sh.ring_id);
+            w.str(sh.pattern_type);
+            w.strs(sh.chain);
+            w.strs(sh.intermediate_accounts);
+            w.f(sh.total_amount);
+            w.i(sh.shell_depth);
+            w.f(sh.risk_score);
+        }
+
+        // Graph data, columnar
+        const auto& nodes = r.graph_data.nodes;
+        w.u(nodes.size());
+        for (const auto& n : nodes) w.str(n.id);
+        for (const auto& n : nodes) w.str(n.label);
+        for (const auto& n : nodes) w.str(n.account_type);
+        for (const auto& n : nodes) w.f(n.suspicion_score);
+        for (const auto& n : nodes) w.f(n.total_inflow);
+        for (const auto& n : nodes) w.f(n.total_outflow);
+        for (const auto& n : nodes) w.i(n.transaction_count);
+        for (const auto& n : nodes) w.u(n.is_suspicious);
+        for (const auto& n : nodes) w.strs(n.ring_ids);
+        for (const auto& n : nodes) w.strs(n.patterns);
+        for (const auto& n : nodes) w.strs(n.detected_patterns);
+
+        const auto& edges = r.graph_data.edges;
+        w.u(edges.size());
+        for (const auto& e : edges) w.str(e.source);
+        for (const auto& e : edges) w.str(e.target);
+        for (const auto& e : edges) w.f(e.total_amount);
+        for (const auto& e : edges) w.i(e.transaction_count);
+        for (const auto& e : edges) w.u(e.is_suspicious);
+        for (const auto& e : edges) w.str(e.pattern_type);
+
+        return w.finish();
+    }
+
+    static std::optional<AnalysisResult> decode(std::string_view data) {
+        Reader rd(data);
+        if (!rd.header()) return std::nullopt;
+
+        AnalysisResult r;
+        r.analysis_id = rd.str();
+        const uint64_t status = rd.u();
+        if (status > (uint64_t)AnalysisStatus::FAILED) return std::nullopt;
+        r.status             = (AnalysisStatus)status;
+        r.error              = rd.str();
+        r.processing_time_ms = rd.f();
+        r.progress           = rd.f();
+        r.truncated          = rd.u() != 0;
+
+        Summary& s = r.summary;
+        s.total_transactions          = rd.i();
+        s.total_accounts_analyzed     = rd.i();
+        s.suspicious_accounts_flagged = rd.i();
+        s.fraud_rings_detected        = rd.i();
+        s.total_cycles                = rd.i();
+        s.total_smurfing_patterns     = rd.i();
+        s.total_shell_patterns        = rd.i();
+        s.total_amount_at_risk        = rd.f();
+        s.processing_time_seconds     = rd.f();
+
+        Timings& t = r.timings;
+        for (double& secs : t.stage_seconds) secs = rd.f();
+        t.cycle_steps             = rd.u();
+        t.cycle_temporal_rejects  = rd.u();
+        t.cycle_step_capped_roots = rd.u();
+        t.max_cycles_reached      = rd.u() != 0;
+        t.shell_steps             = rd.u();
+        t.max_chains_reached      = rd.u() != 0;
+        t.peak_rss_bytes          = rd.u();
+
+        r.suspicious_accounts.resize(rd.count());
+        for (auto& a : r.suspicious_accounts) {
+            a.account_id         = rd.str();
+            a.suspicion_score    = rd.f();
+            a.detected_patterns  = rd.strs();
+            a.ring_id            = rd.str();
+            a.account_type       = rd.str();
+            a.total_inflow       = rd.f();
+            a.total_outflow      = rd.f();
+            a.transaction_count  = rd.i();
+            a.connected_accounts = rd.strs();
+            a.connected_account_count = rd.i();
+            a.ring_ids           = rd.strs();
+        }
+
+        r.fraud_rings.resize(rd.count());
+        for (auto& f : r.fraud_rings) {
+            f.ring_id         = rd.str();
+            f.member_accounts = rd.strs();
+            f.pattern_type    = rd.str();
+            f.risk_score      = rd.f();
+        }
+
+        r.cycles.resize(rd.count());
+        for (auto& c : r.cycles) {
+            c.ring_id         = rd.str();
+            c.nodes           = rd.strs();
+            c.length          = rd.i();
+            c.total_amount    = rd.f();
+            c.time_span_hours = rd.f();
+            c.edge_count      = rd.i();
+            c.pattern_type    = rd.str();
+        }
+
+        r.smurfing.resize(rd.count());
+        for (auto& m : r.smurfing) {
+            m.account_id            = rd.str();
+            m.pattern_type          = rd.str();
+            m.unique_counterparties = rd.i();
+            m.total_amount          = rd.f();
+            m.velocity_per_hour     = rd.f();
+            m.window_start          = rd.str();
+            m.window_end            = rd.str();
+            m.ring_id               = rd.str();
+        }
+
+        r.shells.resize(rd.count());
+        for (auto& sh : r.shells) {
+            sh.ring_id               = rd.str();
+            sh.pattern_type          = rd.str();
+            sh.chain                 = rd.strs();
+            sh.intermediate_accounts = rd.strs();
+            sh.total_amount          = rd.f();
+            sh.shell_depth           = rd.i();
+            sh.risk_score            = rd.f();
+        }
+
+        auto& nodes = r.graph_data.nodes;
+        nodes.resize(rd.count());
+        for (auto& n : nodes) n.id                = rd.str();
+        for (auto& n : nodes) n.label             = rd.str();
+        for (auto& n : nodes) n.account_type      = rd.str();
+        for (auto& n : nodes) n.suspicion_score   = rd.f();
+        for (auto& n : nodes) n.total_inflow      = rd.f();
+        for (auto& n : nodes) n.total_outflow     = rd.f();
+        for (auto& n : nodes) n.transaction_count = rd.i();
+        for (auto& n : nodes) n.is_suspicious     = rd.u() != 0;
+        for (auto& n : nodes) n.ring_ids          = rd.strs();
+        for (auto& n : nodes) n.patterns          = rd.strs();
+        for (auto& n : nodes) n.detected_patterns = rd.strs();
+
+        auto& edges = r.graph_data.edges;
+        edges.resize(rd.count());
+        for (auto& e : edges) e.source            = rd.str();
+        for (auto& e : edges) e.target            = rd.str();
+        for (auto& e : edges) e.total_amount      = rd.f();
+        for (auto& e : edges) e.transaction_count = rd.i();
+        for (auto& e : edges) e.is_suspicious     = rd.u() != 0;
+        for (auto& e : edges) e.pattern_type      = rd.str();
+
+        if (!rd.ok() || !rd.at_end()) return std::nullopt;
+        return r;
+    }
+
+private:
+    // Body is written first; finish() prepends header + string table
+    class Writer {
+    public:
+        void u(uint64_t v) { varint(body_, v); }
+        void i(int64_t v)  { u(((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+        void f(double d) {
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            for (int k = 0; k < 8; ++k) body_ += (char)(bits >> (8 * k));
+        }
+        void str(const std::string& s) {
+            auto [it, fresh] = ids_.try_emplace(s, (uint32_t)table_.size());
+            if (fresh) table_.push_back(&it->first);
+            u(it->second);
+        }
+        void strs(const std::vector<std::string>& v) {
+            u(v.size());
+            for (const auto& s : v) str(s);
+        }
+
+        std::string finish() {
+            std::string out(MAGIC, sizeof(MAGIC));
+            out += (char)VERSION;
+            varint(out, table_.size());
+            for (const std::string* s : table_) {
+                varint(out, s->size());
+                out += *s;
+            }
+            out += body_;
+            return out;
+        }
+
+    private:
+        std::string                               body_;
+        std::unordered_map<std::string, uint32_t> ids_;
+        std::vector<const std::string*>           table_;   // keys of ids_ (node-stable)
+
+        static void varint(std::string& out, uint64_t v) {
+            while (v >= 0x80) { out += (char)(v | 0x80); v >>= 7; }
+            out += (char)v;
+        }
+    };
+
+    // Reads past the end or out-of-range indices just set ok_ = false and
+    // return zero values; decode() checks once at the end
+    class Reader {
+    public:
+        explicit Reader(std::string_view d) : d_(d) {}
+
+        bool header() {
+            if (d_.size() < sizeof(MAGIC) + 1 ||
+                std::memcmp(d_.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+                (uint8_t)d_[sizeof(MAGIC)] != VERSION)
+                return false;
+            pos_ = sizeof(MAGIC) + 1;
+            const size_t n = count();
+            table_.reserve(n);
+            for (size_t k = 0; k < n && ok_; ++k) {
+                const uint64_t len = u();
+                if (len > d_.size() - pos_) { ok_ = false; break; }
+                table_.emplace_back(d_.substr(pos_, len));
+                pos_ += len;
+            }
+            return ok_;
+        }
+
+        uint64_t u() {
+            uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (pos_ >= d_.size()) { ok_ = false; return 0; }
+                const uint8_t b = (uint8_t)d_[pos_++];
+                v |= (uint64_t)(b & 0x7F) << shift;
+                if (!(b & 0x80)) return v;
+            }
+            ok_ = false;
+            return 0;
+        }
+        int i() {
+            const uint64_t z = u();
+            return (int)(int64_t)((z >> 1) ^ (0 - (z & 1)));
+        }
+        double f() {
+            if (d_.size() - pos_ < 8) { ok_ = false; pos_ = d_.size(); return 0.0; }
+            uint64_t bits = 0;
+            for (int k = 0; k < 8; ++k) bits |= (uint64_t)(uint8_t)d_[pos_ + k] << (8 * k);
+            pos_ += 8;
+            double d;
+            std::memcpy(&d, &bits, sizeof(d));
+            return d;
+        }
+        std::string str() {
+            const uint64_t id = u();
+            if (id >= table_.size()) { ok_ = false; return {}; }
+            return std::string(table_[id]);
+        }
+        std::vector<std::string> strs() {
+            std::vector<std::string> v(count());
+            for (auto& s : v) s = str();
+            return v;
+        }
+
+        // An element count; each element takes at least one byte, which
+        // caps allocations from a corrupt count
+        size_t count() {
+            const uint64_t n = u();
+            if (n > d_.size() - pos_) { ok_ = false; return 0; }
+            return (size_t)n;
+        }
+
+        bool ok() const     { return ok_; }
+        bool at_end() const { return pos_ == d_.size(); }
+
+    private:
+        std::string_view              d_;
+        size_t                        pos_ = 0;
+        bool                          ok_  = true;
+        std::vector<std::string_view> table_;
+    };
+};
+
+} // namespace mm
@@ -0,0 +1,114 @@
+#pragma once
+// ============================================================================
+// Business Classifier – does an account ID look like a business name?
+//
+// One keyword list, matched case-insensitively anywhere in the ID; "co"
+// only counts at the end of a word (the old `co\b` regex), so "acme_co"
+// and "acme co." match but "cobalt" or "co_op" do not.
+//
+// The keywords are compiled once into an Aho–Corasick DFA over a folded
+// alphabet (a–z, other word chars, non-word chars), so classifying an ID
+// is one table lookup per byte – no std::regex.  GraphBuilder classifies
+// each account once, when it is first interned; everything else reads
+// TransactionGraph::is_business().
+// ============================================================================
+
+#include <array>
+#include <cstdint>
+#include <queue>
+#include <string_view>
+#include <vector>
+
+namespace mm {
+
+class BusinessClassifier {
+public:
+    static constexpr std::array<std::string_view, 13> KEYWORDS = {
+        "corp", "inc", "llc", "ltd", "merchant", "store", "shop",
+        "pay", "bank", "services", "mart", "pvt", "co",
+    };
+    // Keyword that must be followed by a non-word character or the end
+    static constexpr std::string_view WORD_END_KEYWORD = "co";
+
+    static bool is_business(std::string_view id) {
+        static const BusinessClassifier dfa;
+        return dfa.match(id);
+    }
+
+private:
+    // Character classes: 0–25 letters, 26 digits/underscore, 27 the rest
+    static constexpr int CLASSES    = 28;
+    static constexpr int OTHER_WORD = 26;
+    static constexpr int NON_WORD   = 27;
+
+    enum : uint8_t { ACCEPT = 1, ACCEPT_AT_WORD_END = 2 };
+
+    std::array<uint8_t, 256>                  cls_{};
+    std::vector<std::array<uint16_t, CLASSES>> next_;
+    std::vector<uint8_t>                      out_;
+
+    static int classify_char(unsigned char c) {
+        if (c >= 'a' && c <= 'z') return c - 'a';
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if ((c >= '0' && c <= '9') || c == '_') return OTHER_WORD;
+        return NON_WORD;
+    }
+
+    BusinessClassifier() {
+        for (int c = 0; c < 256; ++c) cls_[c] = (uint8_t)classify_char((unsigned char)c);
+
+        // Trie
+        std::vector<std::array<int, CLASSES>> trie(1);
+        trie[0].fill(-1);
+        out_.assign(1, 0);
+        for (std::string_view kw : KEYWORDS) {
+            int s = 0;
+            for (char ch : kw) {
+                int c = cls_[(unsigned char)ch];
+                if (trie[s][c] < 0) {
+                    trie[s][c] = (int)trie.size();
+                    trie.emplace_back().fill(-1);
+                    out_.push_back(0);
+                }
+                s = trie[s][c];
+            }
+            out_[s] |= kw == WORD_END_KEYWORD ? ACCEPT_AT_WORD_END : ACCEPT;
+        }
+
+        // BFS over failure links turns the trie into a full DFA
+        next_.assign(trie.size(), {});
+        std::vector<int> fail(trie.size(), 0);
+        std::queue<int> q;
+        for (int c = 0; c < CLASSES; ++c) {
+            if (trie[0][c] >= 0) { next_[0][c] = (uint16_t)trie[0][c]; q.push(trie[0][c]); }
+            else                 { next_[0][c] = 0; }
+        }
+        while (!q.empty()) {
+            int s = q.front(); q.pop();
+            out_[s] |= out_[fail[s]];
+            for (int c = 0; c < CLASSES; ++c) {
+                int t = trie[s][c];
+                if (t >= 0) {
+                    fail[t] = next_[fail[s]][c];
+                    next_[s][c] = (uint16_t)t;
+                    q.push(t);
+                } else {
+                    next_[s][c] = next_[fail[s]][c];
+                }
+            }
+        }
+    }
+
+    bool match(std::string_view id) const {
+        uint16_t s = 0;
+        for (unsigned char ch : id) {
+            const int c = cls_[ch];
+            if ((out_[s] & ACCEPT_AT_WORD_END) && c == NON_WORD) return true;
+            s = next_[s][c];
+            if (out_[s] & ACCEPT) return true;
+        }
+        return (out_[s] & ACCEPT_AT_WORD_END) != 0;
+    }
+};
+
+} // namespace mm
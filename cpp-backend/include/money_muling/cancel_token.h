@@ -0,0 +1,73 @@
+#pragma once
+// ============================================================================
+// Cancel Token – cooperative cancellation and deadlines for one analysis
+//
+// The executor creates a token per job; DELETE /api/v1/analysis/{id}
+// cancels it and the job's deadline is armed when it starts running.
+// Detector loops poll stop_requested() (see CycleDetector, ShellDetector,
+// SmurfingDetector) and return what they have found so far.
+//
+//   • cancel()  – the client no longer wants the result; the engine
+//                 reports the analysis as failed and the caller drops it
+//   • deadline  – the analysis ran out of time; the engine still scores
+//                 what the detectors found and flags the result truncated
+//
+// Every member is an atomic, so a token is polled from pool threads while
+// another thread cancels it.  A null token pointer never stops anything.
+// ============================================================================
+
+#include <atomic>
+#include <chrono>
+
+namespace mm {
+
+class CancelToken {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Detector loops poll the clock once per this many iterations
+    static constexpr unsigned CHECK_INTERVAL = 1024;
+
+    CancelToken() = default;
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    void cancel() { cancelled_.store(true); }
+
+    // Stop at now + budget (a zero budget keeps the token deadline-free)
+    void arm(std::chrono::seconds budget) {
+        if (budget.count() > 0)
+            deadline_.store((Clock::now() + budget).time_since_epoch().count());
+    }
+
+    bool cancelled() const { return cancelled_.load(); }
+
+    /**
+     * True once the token is cancelled or past its deadline.  A true
+     * answer is remembered (see stopped()), so the engine can tell that
+     * some loop actually gave up early.
+     */
+    bool stop_requested() const {
+        if (cancelled_.load() ||
+            Clock::now().time_since_epoch().count() >= deadline_.load(std::memory_order_relaxed)) {
+            stopped_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Some stop_requested() call returned true
+    bool stopped() const { return stopped_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool>         cancelled_{false};
+    std::atomic<Clock::rep>   deadline_{Clock::time_point::max().time_since_epoch().count()};
+    mutable std::atomic<bool> stopped_{false};
+};
+
+// Poll helper for the detectors: a null token never stops
+inline bool stop_requested(const CancelToken* cancel) {
+    return cancel && cancel->stop_requested();
+}
+
+} // namespace mm
@@ -0,0 +1,69 @@
+#pragma once
+// ============================================================================
+// Column – a read-only array that owns its elements or views mapped memory
+//
+// TransactionGraph keeps every array as a Column.  A freshly built graph
+// owns its vectors; a graph opened from a snapshot (graph_snapshot.h)
+// views the mapped file in place, so nothing is copied or decoded.
+// Accessors read through one span either way.
+// ============================================================================
+
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+template <class T>
+class Column {
+    static_assert(std::is_trivially_copyable_v<T>, "columns hold plain data");
+
+public:
+    Column() = default;
+
+    // Owning
+    Column(std::vector<T> v) : own_(std::move(v)), view_(own_) {}
+
+    // Non-owning: `s` must outlive the column (and all its copies)
+    static Column view(std::span<const T> s) {
+        Column c;
+        c.view_ = s;
+        return c;
+    }
+
+    Column(const Column& o)
+        : own_(o.own_), view_(o.owning() ? std::span<const T>(own_) : o.view_) {}
+
+    // A moved vector keeps its buffer, so the span stays valid
+    Column(Column&& o) noexcept
+        : own_(std::move(o.own_)), view_(std::exchange(o.view_, {})) {}
+
+    Column& operator=(Column o) noexcept {
+        own_.swap(o.own_);
+        std::swap(view_, o.view_);
+        return *this;
+    }
+
+    const T& operator[](size_t i) const { return view_[i]; }
+    const T* data() const { return view_.data(); }
+    size_t size() const   { return view_.size(); }
+    bool empty() const    { return view_.empty(); }
+    const T& back() const { return view_.back(); }
+    auto begin() const    { return view_.begin(); }
+    auto end() const      { return view_.end(); }
+
+    std::span<const T> span() const { return view_; }
+    operator std::span<const T>() const { return view_; }
+
+    size_t size_bytes() const { return view_.size_bytes(); }
+
+private:
+    std::vector<T>     own_;
+    std::span<const T> view_;
+
+    bool owning() const { return view_.data() == own_.data(); }
+};
+
+} // namespace mm
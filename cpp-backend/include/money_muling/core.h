@@ -0,0 +1,39 @@
+#pragma once
+// ============================================================================
+// Core – the compiled entry points of the money_muling_core library
+//
+// The engine itself is header-only; money_muling_core compiles it once
+// (src/core.cpp) behind these few calls, so tools that only need "CSV in,
+// report out" (mm_analyze, batch jobs, bindings) link the library instead
+// of building every detector into each of their translation units.  The
+// server keeps including the engine headers directly.
+// ============================================================================
+
+#include "cancel_token.h"
+#include "detection_config.h"
+#include "models.h"
+
+#include <string>
+#include <string_view>
+
+namespace mm {
+
+/**
+ * Run the full pipeline on raw CSV content (AnalysisEngine::run).
+ * Detectors run on ThreadPool::shared(); size it with
+ * ThreadPool::set_shared_threads() before the first call.  `cancel`, if
+ * given, can stop it from another thread or bound it with a deadline.
+ */
+AnalysisResult analyze_csv(const std::string&     analysis_id,
+                           std::string_view       csv_content,
+                           const DetectionConfig& config = {},
+                           const CancelToken*     cancel = nullptr);
+
+// The download report of a finished result (GET /analysis/{id}/download)
+std::string download_json(const AnalysisResult& result);
+
+// Replace the built-in scoring rules with a JSON rule file (false, with
+// `error` set, if it does not load or compile)
+bool load_scoring_rules(const std::string& path, std::string& error);
+
+} // namespace mm
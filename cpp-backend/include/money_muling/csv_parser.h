@@ -1,17 +1,17 @@
 #pragma once
 // ============================================================================
-// CSV Parser – fast, streaming CSV reader with column remapping
+// CSV Parser – fast, single-pass zero-copy CSV reader with column remapping
 // ============================================================================
 
 #include "models.h"
+#include "thread_pool.h"
+#include "transaction_table.h"
 
 #include <algorithm>
 #include <charconv>
 #include <chrono>
+#include <cstring>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
-#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -58,6 +58,114 @@ inline std::string timepoint_to_iso(TimePoint tp) {
     return std::string(buf);
 }
 
+// ─── Fixed-layout timestamp fast path ──────────────────────────────────────
+// The format is detected once per file from the first valid row; every
+// row is then parsed with hand-rolled digit reads.  Anything that does not
+// fit the detected layout falls back to parse_timestamp(), so results are
+// identical to the strptime chain.
+
+enum class TimestampFormat {
+    UNKNOWN,      // not yet detected
+    ISO_T,        // 2024-01-15T10:30:00 (trailing text ignored)
+    ISO_SPACE,    // 2024-01-15 10:30:00 (trailing text ignored)
+    DATE,         // 2024-01-15
+    US_DATETIME,  // 01/15/2024 10:30:00 (trailing text ignored)
+    US_DATE,      // 01/15/2024
+    GENERIC,      // no fixed layout – strptime chain for every row
+};
+
+namespace detail {
+
+// Read `n` ASCII digits at s[pos]; false if any is not a digit
+inline bool read_digits(std::string_view s, size_t pos, size_t n, int& out) {
+    int v = 0;
+    for (size_t i = pos; i < pos + n; ++i) {
+        unsigned d = (unsigned char)s[i] - '0';
+        if (d > 9) return false;
+        v = v * 10 + (int)d;
+    }
+    out = v;
+    return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant).
+// Out-of-range days roll over linearly, like timegm().
+inline int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Same field ranges strptime accepts, so the fast path never admits
+// a value the generic path would have rejected
+inline bool make_timepoint(int y, int mo, int d, int h, int mi, int sec, TimePoint& out) {
+    if (mo < 1 || mo > 12 || d < 1 || d > 31 ||
+        h > 23 || mi > 59 || sec > 61) return false;
+    int64_t secs = days_from_civil(y, mo, d) * 86400
+                 + (int64_t)h * 3600 + (int64_t)mi * 60 + sec;
+    out = TimePoint{std::chrono::seconds(secs)};
+    return true;
+}
+
+inline bool parse_ymd(std::string_view s, int& y, int& mo, int& d) {
+    return s.size() >= 10 && s[4] == '-' && s[7] == '-'
+        && read_digits(s, 0, 4, y) && read_digits(s, 5, 2, mo)
+        && read_digits(s, 8, 2, d);
+}
+
+inline bool parse_mdy(std::string_view s, int& y, int& mo, int& d) {
+    return s.size() >= 10 && s[2] == '/' && s[5] == '/'
+        && read_digits(s, 0, 2, mo) && read_digits(s, 3, 2, d)
+        && read_digits(s, 6, 4, y);
+}
+
+// "HH:MM:SS" at s[pos]
+inline bool parse_hms(std::string_view s, size_t pos, int& h, int& mi, int& sec) {
+    return s.size() >= pos + 8 && s[pos + 2] == ':' && s[pos + 5] == ':'
+        && read_digits(s, pos, 2, h) && read_digits(s, pos + 3, 2, mi)
+        && read_digits(s, pos + 6, 2, sec);
+}
+
+} // namespace detail
+
+inline bool parse_timestamp_fixed(std::string_view s, TimestampFormat fmt, TimePoint& out) {
+    int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+    switch (fmt) {
+        case TimestampFormat::ISO_T:
+        case TimestampFormat::ISO_SPACE:
+            return detail::parse_ymd(s, y, mo, d)
+                && s[10] == (fmt == TimestampFormat::ISO_T ? 'T' : ' ')
+                && detail::parse_hms(s, 11, h, mi, sec)
+                && detail::make_timepoint(y, mo, d, h, mi, sec, out);
+        case TimestampFormat::DATE:
+            return s.size() == 10 && detail::parse_ymd(s, y, mo, d)
+                && detail::make_timepoint(y, mo, d, 0, 0, 0, out);
+        case TimestampFormat::US_DATETIME:
+            return detail::parse_mdy(s, y, mo, d) && s[10] == ' '
+                && detail::parse_hms(s, 11, h, mi, sec)
+                && detail::make_timepoint(y, mo, d, h, mi, sec, out);
+        case TimestampFormat::US_DATE:
+            return s.size() == 10 && detail::parse_mdy(s, y, mo, d)
+                && detail::make_timepoint(y, mo, d, 0, 0, 0, out);
+        default:
+            return false;
+    }
+}
+
+// Pick the first fixed layout (in strptime-chain order) that parses s
+inline TimestampFormat detect_timestamp_format(std::string_view s) {
+    TimePoint tp;
+    for (auto f : {TimestampFormat::ISO_T, TimestampFormat::ISO_SPACE,
+                   TimestampFormat::DATE, TimestampFormat::US_DATETIME,
+                   TimestampFormat::US_DATE}) {
+        if (parse_timestamp_fixed(s, f, tp)) return f;
+    }
+    return TimestampFormat::GENERIC;
+}
+
 // ─── CSV splitting ──────────────────────────────────────────────────────────
 
 inline std::vector<std::string> split_csv_line(const std::string& line) {
@@ -98,41 +206,154 @@ inline std::string to_lower(std::string s) {
     return s;
 }
 
+inline std::string_view trim_view(std::string_view s) {
+    auto start = s.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return {};
+    auto end = s.find_last_not_of(" \t\r\n");
+    return s.substr(start, end - start + 1);
+}
+
+// ─── Zero-copy record reader ────────────────────────────────────────────────
+
+namespace detail {
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/**
+ * Read one CSV record starting at p and return the position after it.
+ *
+ * Same quoting rules as split_csv_line, but a newline inside quotes stays
+ * part of the field instead of ending the record.  Fields are views into
+ * the input; only fields that need unescaping ("" or text around quotes)
+ * are materialised, into `scratch`.
+ */
+inline const char* read_record(const char* p, const char* end,
+                               std::vector<std::string_view>& fields,
+                               std::string& scratch)
+{
+    fields.clear();
+    scratch.clear();
+    // (field index, offset, length) for fields stored in scratch; patched
+    // into views at the end because scratch may reallocate while growing
+    struct Pending { size_t idx, off, len; };
+    Pending pending[8];
+    std::vector<Pending> pending_more;
+    size_t n_pending = 0;
+
+    for (;;) {
+        const char* fs = p;
+        while (p < end && *p != ',' && *p != '\n' && *p != '"') ++p;
+
+        if (p < end && *p == '"') {
+            // Common case: [blanks]"text"[blanks] with no escapes → view
+            const char* lead = fs;
+            while (lead < p && is_blank(*lead)) ++lead;
+            const char* close = lead == p
+                ? static_cast<const char*>(std::memchr(p + 1, '"', end - p - 1))
+                : nullptr;
+            const char* after = close ? close + 1 : nullptr;
+            while (after && after < end && is_blank(*after)) ++after;
+
+            if (close && (after == end || *after == ',' || *after == '\n')) {
+                fields.emplace_back(p + 1, close - p - 1);
+                p = after;
+            } else {
+                // General case: unescape exactly like split_csv_line
+                size_t off = scratch.size();
+                scratch.append(fs, p - fs);
+                bool in_quotes = false;
+                for (; p < end; ++p) {
+                    char c = *p;
+                    if (c == '"') {
+                        if (in_quotes && p + 1 < end && p[1] == '"') {
+                            scratch += '"';
+                            ++p;
+                        } else {
+                            in_quotes = !in_quotes;
+                        }
+                    } else if (!in_quotes && (c == ',' || c == '\n')) {
+                        break;
+                    } else {
+                        scratch += c;
+                    }
+                }
+                Pending pd{fields.size(), off, scratch.size() - off};
+                if (n_pending < 8) pending[n_pending++] = pd;
+                else pending_more.push_back(pd);
+                fields.emplace_back();
+            }
+        } else {
+            fields.emplace_back(fs, p - fs);
+        }
+
+        if (p >= end || *p == '\n') break;
+        ++p;  // skip ','
+    }
+
+    for (size_t i = 0; i < n_pending; ++i)
+        fields[pending[i].idx] = {scratch.data() + pending[i].off, pending[i].len};
+    for (const auto& pd : pending_more)
+        fields[pd.idx] = {scratch.data() + pd.off, pd.len};
+
+    return p < end ? p + 1 : end;
+}
+
+// Amount text → double.  Currency symbols / thousands separators are
+// dropped (only digits, '.', '-' are kept), then parsed with from_chars.
+inline double parse_amount(std::string_view s) {
+    char buf[64];
+    size_t n = 0;
+    for (char c : s) {
+        if ((c >= '0' && c <= '9') || c == '.' || c == '-') {
+            if (n == sizeof(buf)) return 0.0;  // absurdly long – treat as invalid
+            buf[n++] = c;
+        }
+    }
+    double v = 0.0;
+    auto [ptr, ec] = std::from_chars(buf, buf + n, v);
+    return (ec == std::errc{} && ptr != buf) ? v : 0.0;
+}
+
+} // namespace detail
+
 // ─── CSV Validation & Parsing ───────────────────────────────────────────────
 
 struct CsvParseResult {
-    std::vector<Transaction> transactions;
+    TransactionTable transactions;
     std::string error;
     bool ok = true;
 };
 
-/**
- * Parse CSV content into Transaction objects.
- * Supports column remapping (sender_id→sender, receiver_id→receiver).
- * Validates required columns exist.
- */
-inline CsvParseResult parse_csv(const std::string& content) {
-    CsvParseResult result;
+// Bodies at least this large are split into chunks and parsed in parallel
+inline constexpr size_t PARALLEL_PARSE_MIN_BYTES = 4u << 20;   // 4 MB
+inline constexpr size_t PARALLEL_PARSE_CHUNK     = 1u << 20;   // ~1 MB per chunk
 
-    if (content.empty()) {
-        result.ok = false;
-        result.error = "Empty CSV content";
-        return result;
-    }
+namespace detail {
 
-    std::istringstream stream(content);
-    std::string line;
+struct CsvColumns {
+    int sender    = -1;
+    int receiver  = -1;
+    int amount    = -1;
+    int timestamp = -1;
+    int txn_id    = -1;
+    int max_col   = -1;
+};
 
-    // Parse header
-    if (!std::getline(stream, line)) {
-        result.ok = false;
-        result.error = "No header row found";
-        return result;
-    }
+/**
+ * Parse the header row at p, resolve column indices, and advance p to the
+ * first data row.  On failure fills result.error / result.ok.
+ */
+inline bool parse_header(const char*& p, const char* end,
+                         CsvColumns& cols, CsvParseResult& result)
+{
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    p = read_record(p, end, fields, scratch);
 
-    auto headers = split_csv_line(line);
-    for (auto& h : headers) {
-        h = to_lower(trim(h));
+    std::vector<std::string> headers;
+    headers.reserve(fields.size());
+    for (auto f : fields) {
+        headers.push_back(to_lower(std::string(trim_view(f))));
     }
 
     // Column mapping
@@ -158,53 +379,219 @@ inline CsvParseResult parse_csv(const std::string& content) {
         if (col_idx.find(req) == col_idx.end()) {
             result.ok = false;
             result.error = std::string("Missing required column: ") + req;
-            return result;
+            return false;
         }
     }
 
-    int sender_i    = col_idx["sender"];
-    int receiver_i  = col_idx["receiver"];
-    int amount_i    = col_idx["amount"];
-    int timestamp_i = col_idx["timestamp"];
-    int txn_id_i    = col_idx.count("transaction_id") ? col_idx["transaction_id"] : -1;
-    int max_col     = std::max({sender_i, receiver_i, amount_i, timestamp_i});
-
-    // Parse data rows
-    int line_num = 1;
-    while (std::getline(stream, line)) {
-        ++line_num;
-        line = trim(line);
-        if (line.empty()) continue;
-
-        auto fields = split_csv_line(line);
-        if ((int)fields.size() <= max_col) continue; // skip malformed rows
-
-        Transaction txn;
-        txn.sender   = trim(fields[sender_i]);
-        txn.receiver = trim(fields[receiver_i]);
-        if (txn_id_i >= 0 && txn_id_i < (int)fields.size()) {
-            txn.transaction_id = trim(fields[txn_id_i]);
+    cols.sender    = col_idx["sender"];
+    cols.receiver  = col_idx["receiver"];
+    cols.amount    = col_idx["amount"];
+    cols.timestamp = col_idx["timestamp"];
+    cols.txn_id    = col_idx.count("transaction_id") ? col_idx["transaction_id"] : -1;
+    cols.max_col   = std::max({cols.sender, cols.receiver, cols.amount, cols.timestamp});
+    return true;
+}
+
+// A data row is usable when all required columns exist and both account
+// fields are non-empty (blank lines fail the column-count check)
+inline bool is_valid_row(const std::vector<std::string_view>& fields,
+                         const CsvColumns& cols) {
+    return (int)fields.size() > cols.max_col
+        && !trim_view(fields[cols.sender]).empty()
+        && !trim_view(fields[cols.receiver]).empty();
+}
+
+// One parsed data row; views point into the input (or the reader's scratch)
+struct CsvRow {
+    std::string_view transaction_id;
+    std::string_view sender;
+    std::string_view receiver;
+    double           amount = 0.0;
+    TimePoint        timestamp{};
+};
+
+/**
+ * Parse the data rows in [p, end) and call fn(const CsvRow&) for each
+ * valid one.  `ts_fmt` is detected from the first valid row if still
+ * UNKNOWN.
+ */
+template <class Fn>
+inline void for_each_row(const char* p, const char* end, const CsvColumns& cols,
+                         TimestampFormat& ts_fmt, Fn&& fn)
+{
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    fields.reserve(16);
+
+    while (p < end) {
+        p = read_record(p, end, fields, scratch);
+        if (!is_valid_row(fields, cols)) continue; // skip malformed rows
+
+        CsvRow row;
+        row.sender   = trim_view(fields[cols.sender]);
+        row.receiver = trim_view(fields[cols.receiver]);
+        if (cols.txn_id >= 0 && cols.txn_id < (int)fields.size()) {
+            row.transaction_id = trim_view(fields[cols.txn_id]);
         }
 
-        // Parse amount
-        std::string amt_str = trim(fields[amount_i]);
-        // Remove currency symbols and commas
-        std::string clean_amt;
-        for (char c : amt_str) {
-            if (std::isdigit(c) || c == '.' || c == '-') clean_amt += c;
+        row.amount = parse_amount(trim_view(fields[cols.amount]));
+
+        // Parse timestamp – layout fixed by the first valid row
+        auto ts = trim_view(fields[cols.timestamp]);
+        if (ts_fmt == TimestampFormat::UNKNOWN) ts_fmt = detect_timestamp_format(ts);
+        if (!parse_timestamp_fixed(ts, ts_fmt, row.timestamp)) {
+            row.timestamp = parse_timestamp(std::string(ts));
         }
-        try {
-            txn.amount = clean_amt.empty() ? 0.0 : std::stod(clean_amt);
-        } catch (...) {
-            txn.amount = 0.0;
+
+        fn(row);
+    }
+}
+
+// Parse the data rows in [p, end) and append them to out
+inline void parse_rows(const char* p, const char* end, const CsvColumns& cols,
+                       TimestampFormat& ts_fmt, TransactionTable& out)
+{
+    for_each_row(p, end, cols, ts_fmt, [&](const CsvRow& row) {
+        out.add(row.sender, row.receiver, row.amount, row.timestamp, row.transaction_id);
+    });
+}
+
+// Timestamp layout of the first valid row in [p, end)
+inline TimestampFormat first_timestamp_format(const char* p, const char* end,
+                                              const CsvColumns& cols) {
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    while (p < end) {
+        p = read_record(p, end, fields, scratch);
+        if (is_valid_row(fields, cols))
+            return detect_timestamp_format(trim_view(fields[cols.timestamp]));
+    }
+    return TimestampFormat::UNKNOWN;
+}
+
+/**
+ * Split [begin, end) into record-aligned chunks of roughly `chunk_bytes`.
+ *
+ * Quote parity at each raw block start is a prefix sum of per-block quote
+ * counts (every '"' toggles, and an escaped "" toggles twice), so every
+ * cut lands on a newline that is outside quotes – exactly where the
+ * serial reader would end a record.  Returns the chunk start offsets
+ * followed by the end offset.
+ */
+inline std::vector<size_t> split_chunks(const char* begin, const char* end,
+                                        size_t chunk_bytes, ThreadPool& pool)
+{
+    const size_t len      = end - begin;
+    const size_t n_blocks = std::max<size_t>(1, len / std::max<size_t>(chunk_bytes, 1));
+    if (n_blocks == 1) return {0, len};
+
+    auto block_start = [&](size_t b) { return b * (len / n_blocks); };
+
+    // 1. Count quotes per raw block
+    std::vector<size_t> quotes(n_blocks, 0);
+    pool.parallel_for(n_blocks, [&](size_t b) {
+        const char* q  = begin + block_start(b);
+        const char* qe = begin + (b + 1 == n_blocks ? len : block_start(b + 1));
+        size_t cnt = 0;
+        while ((q = static_cast<const char*>(std::memchr(q, '"', qe - q)))) {
+            ++cnt;
+            ++q;
         }
+        quotes[b] = cnt;
+    });
 
-        // Parse timestamp
-        txn.timestamp = parse_timestamp(trim(fields[timestamp_i]));
+    // 2. Parity at each block start, then first unquoted newline after it
+    std::vector<size_t> cuts(n_blocks + 1, 0);
+    std::vector<uint8_t> parity(n_blocks, 0);
+    for (size_t b = 1; b < n_blocks; ++b)
+        parity[b] = (uint8_t)((parity[b - 1] + quotes[b - 1]) & 1);
 
-        if (!txn.sender.empty() && !txn.receiver.empty()) {
-            result.transactions.push_back(std::move(txn));
+    pool.parallel_for(n_blocks - 1, [&](size_t k) {
+        const size_t b = k + 1;
+        bool in_quotes = parity[b];
+        size_t i = block_start(b);
+        for (; i < len; ++i) {
+            char c = begin[i];
+            if (c == '"') in_quotes = !in_quotes;
+            else if (c == '\n' && !in_quotes) { ++i; break; }
         }
+        cuts[b] = i;
+    });
+    cuts[n_blocks] = len;
+
+    // Long quoted fields can make neighbouring cuts coincide or cross;
+    // keep them monotonic so no bytes are parsed twice
+    for (size_t b = 1; b <= n_blocks; ++b) cuts[b] = std::max(cuts[b], cuts[b - 1]);
+    return cuts;
+}
+
+/**
+ * Parallel parse of the data rows in [p, end): record-aligned chunks are
+ * parsed (and their accounts interned) on the pool, then appended in
+ * input order, so the output – NodeId numbering included – is identical
+ * to parse_rows() over the whole range.
+ */
+inline void parse_rows_parallel(const char* p, const char* end, const CsvColumns& cols,
+                                TransactionTable& out, ThreadPool& pool,
+                                size_t chunk_bytes = PARALLEL_PARSE_CHUNK)
+{
+    // The timestamp layout is still decided once, from the file's first row
+    const TimestampFormat ts_fmt = first_timestamp_format(p, end, cols);
+
+    auto cuts = split_chunks(p, end, chunk_bytes, pool);
+    const size_t n_chunks = cuts.size() - 1;
+
+    std::vector<TransactionTable> parts(n_chunks, TransactionTable(out.has_transaction_ids()));
+    pool.parallel_for(n_chunks, [&](size_t c) {
+        TimestampFormat fmt = ts_fmt;
+        parse_rows(p + cuts[c], p + cuts[c + 1], cols, fmt, parts[c]);
+    });
+
+    size_t total = out.size();
+    for (const auto& part : parts) total += part.size();
+    out.reserve(total);
+    for (auto& part : parts) {
+        out.append(part);
+        part = TransactionTable{};
+    }
+}
+
+} // namespace detail
+
+/**
+ * Parse CSV content into a TransactionTable (accounts interned as read;
+ * transaction IDs kept only if `keep_transaction_ids`).
+ * Supports column remapping (sender_id→sender, receiver_id→receiver).
+ * Validates required columns exist.
+ *
+ * Single pass over the buffer: fields are string_views into `content`,
+ * amounts go through from_chars, and the timestamp layout is chosen once
+ * from the first valid row.  Bodies of PARALLEL_PARSE_MIN_BYTES or more
+ * are parsed in record-aligned chunks on the shared thread pool.
+ */
+inline CsvParseResult parse_csv(std::string_view content,
+                                ThreadPool& pool = ThreadPool::shared(),
+                                bool keep_transaction_ids = false) {
+    CsvParseResult result;
+    result.transactions = TransactionTable(keep_transaction_ids);
+
+    if (content.empty()) {
+        result.ok = false;
+        result.error = "Empty CSV content";
+        return result;
+    }
+
+    const char* p   = content.data();
+    const char* end = p + content.size();
+
+    detail::CsvColumns cols;
+    if (!detail::parse_header(p, end, cols, result)) return result;
+
+    if ((size_t)(end - p) >= PARALLEL_PARSE_MIN_BYTES && pool.size() > 1) {
+        detail::parse_rows_parallel(p, end, cols, result.transactions, pool);
+    } else {
+        TimestampFormat ts_fmt = TimestampFormat::UNKNOWN;
+        detail::parse_rows(p, end, cols, ts_fmt, result.transactions);
     }
 
     if (result.transactions.empty()) {
@@ -2,210 +2,364 @@
 // ============================================================================
 // Cycle Detector – finds circular fund routing (cycles of length 3-5)
 //
-// Uses DFS-based simple cycle enumeration with temporal coherence check
-// (all edge timestamps within a configured window).
+// Bounded-length simple-cycle enumeration with temporal coherence check
+// (all edge timestamps within a configured window).  The check runs while
+// the path grows: the DFS carries the path's [min_ts, max_ts] span and
+// drops an extension as soon as the span exceeds the window, instead of
+// testing whole cycles after they close.
 //
-// Performance optimisations for large graphs:
-//   • O(1) path-membership via unordered_set (was O(path_len) linear scan)
-//   • Per-root frame budget to prevent exponential blowup on dense graphs
-//   • Nodes sorted by out-degree so high-connectivity hubs found first
-//   • Skips zero-out-degree nodes immediately
+// Every node with outgoing edges gets a rank (hubs first).  A search from
+// root r only walks nodes ranked after r, so each cycle is reported
+// exactly once – from its minimum-rank node – and no rotation
+// deduplication is needed.  The DFS keeps one frame stack plus an
+// on-path bitmap; extending the path is O(1) with no allocation.
+//
+// The search is a template on the maximum length: 3, 4 and 5 (the
+// default) get instantiations with a compile-time bound and the frame
+// stack on the C++ stack; other lengths use the runtime-bounded one.
+//
+//   • Walks interned NodeIds over the graph's CSR adjacency
+//   • Result cap (max_cycles) and per-root step budget are parameters;
+//     the defaults only bound pathological inputs
+//   • Per-root searches are independent: they run in parallel on the
+//     shared ThreadPool, and AnalysisSession can re-run only the roots
+//     near appended transactions (see collect())
+//   • A CancelToken stops the search between batches, before each root
+//     and every CHECK_INTERVAL steps; the cycles found so far are kept
 // ============================================================================
 
+#include "cancel_token.h"
 #include "graph_engine.h"
 #include "models.h"
-#include "red_black_tree.h"
+#include "thread_pool.h"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
-#include <optional>
+#include <cmath>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace mm {
 
 class CycleDetector {
 public:
-    static constexpr int    MAX_CYCLES          = 5000;
+    static constexpr int    DEFAULT_MAX_CYCLES   = 5000;
     static constexpr int    DEFAULT_MAX_LENGTH   = 5;
     static constexpr double DEFAULT_WINDOW_HRS   = 72.0;
-    // Max DFS frames per root node — prevents O(∞) on dense graphs
-    static constexpr int    MAX_FRAMES_PER_ROOT  = 5000;
+    // Successor visits allowed per root (0 = unlimited).  Only reached on
+    // very dense graphs; typical roots need a few thousand.
+    static constexpr long   DEFAULT_MAX_STEPS_PER_ROOT = 2'000'000;
+    // Roots handed to the pool per round of collect()
+    static constexpr size_t ROOT_BATCH = 512;
+
+    // Search order: roots[i] has rank i + 1; rank 0 = no outgoing edges
+    struct RootOrder {
+        std::vector<NodeId>   roots;
+        std::vector<uint32_t> rank;
+    };
+
+    // One node of the DFS path
+    struct Frame {
+        NodeId    node;
+        uint32_t  cursor;   // next successor index
+        EdgeId    edge;     // node → next frame's node (or → root, on close)
+        TimePoint lo, hi;   // time span of the path up to node
+    };
+
+    // What the searches on one workspace did (summed per analysis)
+    struct Stats {
+        uint64_t steps             = 0;   // successor visits
+        uint64_t temporal_rejects  = 0;   // extensions past the window
+        uint64_t step_capped_roots = 0;   // roots stopped by max_steps_per_root
+
+        Stats& operator+=(const Stats& o) {
+            steps += o.steps;
+            temporal_rejects += o.temporal_rejects;
+            step_capped_roots += o.step_capped_roots;
+            return *this;
+        }
+    };
+
+    // Per-thread scratch reused across roots (sized to the graph once)
+    struct Workspace {
+        std::vector<uint8_t> on_path;
+        std::vector<Frame>   frames;    // runtime-bounded searches only
+        Stats                stats;
+
+        explicit Workspace(size_t nodes = 0) : on_path(nodes, 0) {}
+    };
 
     /**
      * Find all simple cycles of length 3..max_length that are temporally
-     * coherent (all edge timestamps within time_window_hours).
-     *
-     * Uses RBT-backed temporal checks for O(log n) edge-timestamp lookup.
+     * coherent (all edge timestamps within time_window_hours).  At most
+     * max_cycles are returned, hub-ranked roots first.  Roots are searched
+     * in parallel on `pool`; the result does not depend on its size.
+     * Search counters are added to `stats`, if given; `capped` is set to
+     * whether max_cycles dropped a cycle.  Once `cancel` requests a stop,
+     * the cycles found so far are returned.
      */
-    static std::vector<CycleResult> detect(
+    static std::vector<DetectedCycle> detect(
         const TransactionGraph& graph,
-        int    max_length        = DEFAULT_MAX_LENGTH,
-        double time_window_hours = DEFAULT_WINDOW_HRS)
+        int    max_length         = DEFAULT_MAX_LENGTH,
+        double time_window_hours  = DEFAULT_WINDOW_HRS,
+        int    max_cycles         = DEFAULT_MAX_CYCLES,
+        long   max_steps_per_root = DEFAULT_MAX_STEPS_PER_ROOT,
+        ThreadPool& pool          = ThreadPool::shared(),
+        Stats*      stats         = nullptr,
+        const CancelToken* cancel = nullptr,
+        bool*       capped        = nullptr)
     {
-        using namespace std::chrono;
-
-        auto window = duration_cast<system_clock::duration>(
-            duration<double, std::ratio<3600>>(time_window_hours));
-
-        // Build RBT per edge for fast timestamp range queries
-        // (maps "sender→receiver" → sorted timestamps)
-        // We don't need RBT here since edge_transactions() already stores
-        // timestamps; RBT gives O(log n) range_query on the global stream.
-        // For cycle coherence we just iterate the (small) per-edge list.
+        const auto order = root_order(graph);
+        std::vector<Workspace> ws(pool.max_workers());
+        std::vector<std::vector<DetectedCycle>> found(order.roots.size());
+        auto results = collect(order, max_cycles, pool,
+            [&](NodeId root, int limit, size_t worker) -> const std::vector<DetectedCycle>& {
+                auto& out = found[order.rank[root] - 1];
+                out.clear();
+                search_root(graph, order, root, ws[worker], out, limit,
+                            max_length, time_window_hours, max_steps_per_root, cancel);
+                return out;
+            }, cancel, capped);
+        if (stats) for (const auto& w : ws) *stats += w.stats;
+        return results;
+    }
 
-        // Collect all nodes — filter out zero-out-degree immediately
-        std::vector<std::string> node_list;
-        node_list.reserve(graph.all_nodes().size());
-        for (const auto& [id, _] : graph.all_nodes()) {
+    /**
+     * Rank nodes with outgoing edges by out-degree descending (hubs
+     * first, so the max_cycles cap keeps the most connected rings), ties
+     * by ID.
+     */
+    static RootOrder root_order(const TransactionGraph& graph) {
+        RootOrder order;
+        order.roots.reserve(graph.node_count());
+        for (NodeId id = 0; id < (NodeId)graph.node_count(); ++id) {
             if (graph.out_degree(id) > 0)
-                node_list.push_back(id);
+                order.roots.push_back(id);
         }
-
-        // Sort by out-degree descending so hubs are explored first
-        // (allows MAX_CYCLES to be hit faster → early exit)
-        std::sort(node_list.begin(), node_list.end(),
-            [&](const std::string& a, const std::string& b) {
+        std::stable_sort(order.roots.begin(), order.roots.end(),
+            [&](NodeId a, NodeId b) {
                 return graph.out_degree(a) > graph.out_degree(b);
             });
+        order.rank.assign(graph.node_count(), 0);
+        for (size_t i = 0; i < order.roots.size(); ++i)
+            order.rank[order.roots[i]] = (uint32_t)(i + 1);
+        return order;
+    }
 
-        std::vector<CycleResult> results;
-        results.reserve(std::min((int)node_list.size(), MAX_CYCLES));
-        int ring_counter = 0;
-
-        // ── DFS-based cycle enumeration ─────────────────────────────────
-        struct Frame {
-            std::string              node;
-            std::vector<std::string> path;
-            std::unordered_set<std::string> in_path; // O(1) membership
-        };
-
-        for (const auto& start : node_list) {
-            if ((int)results.size() >= MAX_CYCLES) break;
-
-            std::vector<Frame> stack;
-            stack.reserve(64);
-            stack.push_back({start, {start}, {start}});
-
-            int frames_this_root = 0;
-
-            while (!stack.empty() && (int)results.size() < MAX_CYCLES) {
-                if (++frames_this_root > MAX_FRAMES_PER_ROOT) break;
-
-                auto frame = std::move(stack.back());
-                stack.pop_back();
-
-                const int depth = (int)frame.path.size();
-                if (depth > max_length + 1) continue;
-
-                for (const auto& next : graph.successors(frame.node)) {
-                    // Cycle closes back to start
-                    if (next == start && depth >= 3) {
-                        auto cycle_result = check_temporal_coherence(
-                            graph, frame.path, window, ring_counter);
-                        if (cycle_result.has_value()) {
-                            results.push_back(std::move(*cycle_result));
-                            if ((int)results.size() >= MAX_CYCLES) break;
-                        }
-                        continue;
-                    }
-
-                    // Only extend if within depth budget and node not in path
-                    if (depth < max_length && !frame.in_path.count(next)) {
-                        Frame nf;
-                        nf.node    = next;
-                        nf.path    = frame.path;
-                        nf.in_path = frame.in_path;
-                        nf.path.push_back(next);
-                        nf.in_path.insert(next);
-                        stack.push_back(std::move(nf));
-                    }
-                }
+    /**
+     * Concatenate per-root cycle lists in rank order and stop at
+     * max_cycles.  Lists are disjoint (each cycle
+     * belongs to its minimum-rank node), so nothing needs deduplicating.
+     *
+     * root_cycles(root, limit, worker) returns the cycles rooted at `root`
+     * (at least the first `limit` of them); the list must stay valid until
+     * collect() returns.  It is called concurrently for different roots –
+     * `worker` (< pool.max_workers()) selects per-thread scratch.  Roots
+     * go out in batches of ROOT_BATCH, each root with the limit left at
+     * the start of its batch; a root's DFS order is fixed, so its first
+     * cycles are the same whatever limit it had, and the merged result
+     * equals a serial run.  detect() searches on demand; AnalysisSession
+     * serves cached lists for roots whose neighbourhood did not change.
+     * No batch starts once `cancel` requests a stop.
+     *
+     * Limits are one more than still fits, and a full result searches one
+     * more batch, so `capped` (if given) is set exactly when max_cycles
+     * dropped a cycle – not merely when max_cycles were returned.
+     */
+    template <class RootCycles>
+    static std::vector<DetectedCycle> collect(const RootOrder& order, int max_cycles,
+                                              ThreadPool& pool, RootCycles&& root_cycles,
+                                              const CancelToken* cancel = nullptr,
+                                              bool*              capped = nullptr)
+    {
+        std::vector<DetectedCycle> results;
+        std::vector<const std::vector<DetectedCycle>*> batch;
+        bool dropped = false;
+        const size_t R = order.roots.size();
+        for (size_t begin = 0; begin < R && !dropped; begin += ROOT_BATCH) {
+            const int limit = max_cycles - (int)results.size() + 1;
+            if (stop_requested(cancel)) break;
+            batch.assign(std::min(ROOT_BATCH, R - begin), nullptr);
+            pool.parallel_for(batch.size(), [&](size_t i, size_t worker) {
+                batch[i] = &root_cycles(order.roots[begin + i], limit, worker);
+            });
+            for (const auto* found : batch) {
+                const size_t room = (size_t)max_cycles - results.size();
+                const size_t take = std::min(found->size(), room);
+                results.insert(results.end(), found->begin(), found->begin() + take);
+                if (take < found->size()) dropped = true;
             }
         }
-
-        results = deduplicate(std::move(results));
+        if (capped) *capped = dropped;
         return results;
     }
 
+    /**
+     * Name a detected cycle for output (ring_id is left to the caller,
+     * see AnalysisEngine::assemble).
+     */
+    static CycleResult to_result(const TransactionGraph& graph, const DetectedCycle& c) {
+        CycleResult cr;
+        cr.nodes.reserve(c.nodes.size());
+        for (NodeId n : c.nodes) cr.nodes.emplace_back(graph.name(n));
+        cr.length          = c.length();
+        cr.total_amount    = c.total_amount;
+        cr.time_span_hours = c.time_span_hours;
+        cr.edge_count      = c.length();
+        cr.pattern_type    = "cycle";
+        return cr;
+    }
+
+    /**
+     * Enumerate simple cycles whose minimum-rank node is `start` and
+     * append at most `limit` temporally coherent ones to out.  Only reads
+     * the rows of nodes within max_length - 1 hops of start.  Stops early
+     * (keeping what it appended) once `cancel` requests a stop.
+     */
+    static void search_root(
+        const TransactionGraph&   graph,
+        const RootOrder&          order,
+        NodeId                    start,
+        Workspace&                ws,
+        std::vector<DetectedCycle>& out,
+        int                       limit,
+        int    max_length         = DEFAULT_MAX_LENGTH,
+        double time_window_hours  = DEFAULT_WINDOW_HRS,
+        long   max_steps_per_root = DEFAULT_MAX_STEPS_PER_ROOT,
+        const CancelToken* cancel = nullptr)
+    {
+        switch (max_length) {
+            case 3:  return search<3>(graph, order, start, ws, out, limit, 3,
+                                      time_window_hours, max_steps_per_root, cancel);
+            case 4:  return search<4>(graph, order, start, ws, out, limit, 4,
+                                      time_window_hours, max_steps_per_root, cancel);
+            case 5:  return search<5>(graph, order, start, ws, out, limit, 5,
+                                      time_window_hours, max_steps_per_root, cancel);
+            default: return search<0>(graph, order, start, ws, out, limit, max_length,
+                                      time_window_hours, max_steps_per_root, cancel);
+        }
+    }
+
 private:
-    static std::optional<CycleResult> check_temporal_coherence(
-        const TransactionGraph& graph,
-        const std::vector<std::string>& path,
-        std::chrono::system_clock::duration window,
-        int& ring_counter)
+    // MaxLen > 0: max_length == MaxLen, known at compile time
+    template <int MaxLen>
+    static void search(
+        const TransactionGraph&   graph,
+        const RootOrder&          order,
+        NodeId                    start,
+        Workspace&                ws,
+        std::vector<DetectedCycle>& out,
+        int                       limit,
+        int                       max_length,
+        double                    time_window_hours,
+        long                      max_steps_per_root,
+        const CancelToken*        cancel)
     {
         using namespace std::chrono;
 
-        TimePoint min_ts = TimePoint::max();
-        TimePoint max_ts = TimePoint::min();
-        double total_amount = 0.0;
-        int edge_count = (int)path.size();
+        constexpr bool fixed = MaxLen > 0;
+        const int len_cap = fixed ? MaxLen : max_length;
+        if (limit <= 0 || len_cap < 3 || stop_requested(cancel)) return;
+        auto window = duration_cast<system_clock::duration>(
+            duration<double, std::ratio<3600>>(time_window_hours));
 
-        for (size_t i = 0; i < path.size(); ++i) {
-            const auto& u = path[i];
-            const auto& v = path[(i + 1) % path.size()];
+        if (ws.on_path.size() < graph.node_count())
+            ws.on_path.resize(graph.node_count(), 0);
+        const uint32_t root_rank = order.rank[start];
 
-            const auto& txns = graph.edge_transactions(u, v);
-            if (txns.empty()) return std::nullopt;
+        // frames[0..top] is the path; it never holds more than len_cap nodes
+        std::array<Frame, fixed ? MaxLen : 1> local;
+        Frame* frames = local.data();
+        if constexpr (!fixed) {
+            if (ws.frames.size() < (size_t)len_cap) ws.frames.resize(len_cap);
+            frames = ws.frames.data();
+        }
+        int top = 0;
+        frames[0] = {start, 0, INVALID_EDGE, TimePoint::max(), TimePoint::min()};
+        ws.on_path[start] = 1;
+
+        int      found = 0;
+        long     steps = 0;
+        uint64_t temporal_rejects = 0;
+
+        while (top >= 0) {
+            Frame&       f    = frames[top];
+            const auto   succ = graph.successors(f.node);
+
+            if (f.cursor == succ.size()) {
+                // Row exhausted – backtrack
+                ws.on_path[f.node] = 0;
+                --top;
+                continue;
+            }
 
-            for (const auto& [amt, ts] : txns) {
-                total_amount += amt;
-                if (ts < min_ts) min_ts = ts;
-                if (ts > max_ts) max_ts = ts;
+            const EdgeId e    = graph.first_out_edge(f.node) + f.cursor;
+            const NodeId next = succ[f.cursor++];
+            if (++steps > max_steps_per_root && max_steps_per_root > 0) {
+                ++ws.stats.step_capped_roots;
+                break;
+            }
+            if (steps % CancelToken::CHECK_INTERVAL == 0 && stop_requested(cancel)) break;
+
+            // Cheap structural rejections first (top + 1 = nodes on path)
+            const bool closes = next == start;
+            if (closes) {
+                if (top + 1 < 3) continue;
+            } else {
+                if (order.rank[next] <= root_rank || ws.on_path[next]) continue;
+                if (top + 1 >= len_cap) continue;
             }
-        }
 
-        if ((max_ts - min_ts) > window) return std::nullopt;
+            // Temporal pruning: every transaction on every edge of a cycle
+            // must fall inside the window, so the path's span only grows –
+            // reject as soon as this edge stretches it past the window
+            const auto& agg = graph.agg_edge(e);
+            const TimePoint nlo = std::min(f.lo, agg.earliest);
+            const TimePoint nhi = std::max(f.hi, agg.latest);
+            if (nhi - nlo > window) { ++temporal_rejects; continue; }
+
+            f.edge = e;
+            if (closes) {
+                out.push_back(make_cycle(graph, frames, top + 1, nlo, nhi));
+                if (++found >= limit) break;
+                continue;
+            }
 
-        ++ring_counter;
-        double span_hours = duration_cast<duration<double, std::ratio<3600>>>(
-            max_ts - min_ts).count();
+            frames[++top] = {next, 0, INVALID_EDGE, nlo, nhi};
+            ws.on_path[next] = 1;
+        }
 
-        CycleResult cr;
-        cr.ring_id         = "RING_" + pad3(ring_counter);
-        cr.nodes           = path;
-        cr.length          = (int)path.size();
-        cr.total_amount    = std::round(total_amount * 100.0) / 100.0;
-        cr.time_span_hours = std::round(span_hours * 100.0) / 100.0;
-        cr.edge_count      = edge_count;
-        cr.pattern_type    = "cycle";
-        return cr;
+        // Leave the bitmap clean for the next root
+        for (int i = 0; i <= top; ++i) ws.on_path[frames[i].node] = 0;
+        ws.stats.steps            += (uint64_t)steps;
+        ws.stats.temporal_rejects += temporal_rejects;
     }
 
-    static std::string pad3(int n) {
-        char buf[8];
-        snprintf(buf, sizeof(buf), "%03d", n);
-        return std::string(buf);
-    }
+    // Build the result for a closed, already time-checked cycle of `len`
+    // frames; frames[i].edge = node i → node (i + 1) % len
+    static DetectedCycle make_cycle(
+        const TransactionGraph& graph,
+        const Frame*            frames,
+        int                     len,
+        TimePoint min_ts, TimePoint max_ts)
+    {
+        using namespace std::chrono;
 
-    static std::vector<CycleResult> deduplicate(std::vector<CycleResult> cycles) {
-        std::unordered_set<std::string> seen;
-        std::vector<CycleResult> unique;
-        unique.reserve(cycles.size());
-        for (auto& c : cycles) {
-            auto key = canonical_key(c.nodes);
-            if (seen.insert(key).second)
-                unique.push_back(std::move(c));
-        }
-        return unique;
-    }
+        double total_amount = 0.0;
+        for (int i = 0; i < len; ++i)
+            for (double amt : graph.edge_amounts(frames[i].edge)) total_amount += amt;
 
-    static std::string canonical_key(const std::vector<std::string>& nodes) {
-        if (nodes.empty()) return "";
-        std::string best;
-        for (size_t start = 0; start < nodes.size(); ++start) {
-            std::string key;
-            key.reserve(128);
-            for (size_t i = 0; i < nodes.size(); ++i) {
-                if (!key.empty()) key += ',';
-                key += nodes[(start + i) % nodes.size()];
-            }
-            if (best.empty() || key < best) best = std::move(key);
-        }
-        return best;
+        double span_hours = duration_cast<duration<double, std::ratio<3600>>>(
+            max_ts - min_ts).count();
+
+        DetectedCycle dc;
+        dc.nodes.reserve(len);
+        for (int i = 0; i < len; ++i) dc.nodes.push_back(frames[i].node);
+        dc.total_amount    = std::round(total_amount * 100.0) / 100.0;
+        dc.time_span_hours = std::round(span_hours * 100.0) / 100.0;
+        return dc;
     }
 };
 
@@ -1,124 +1,372 @@
 #pragma once
 // ============================================================================
-// Decision Tree – rule-based fraud scoring via a decision tree structure
+// Decision Tree – rule-based fraud scoring over feature columns
 //
-// Replaces the hardcoded scoring rules from Python scoring.py with a
-// structured decision tree that evaluates account features and detection
-// results to produce a 0-100 suspicion score.
+// Replaces the hardcoded scoring rules from Python scoring.py with a rule
+// set that evaluates account features and detection results to produce a
+// 0-100 suspicion score.
+//
+// Scoring is batch: per-account features are gathered once into columns
+// (ScoringFeatures), and each rule of the compiled RuleSet – a flat array
+// of Nodes – is one pass over all accounts.  Every pass is a branch-free
+// select-and-add into a dense score array indexed by NodeId, so the loops
+// vectorise (Release builds use -O3 -march=native) and cost the same for
+// the large majority of accounts that end up at zero.  Rules apply in
+// array order, so a given rule set scores bit-identically on every ISA.
+//
+// The built-in rules (RuleSet::defaults) are Python's; a JSON rule set
+// (RuleSet::from_json, loaded at startup from MM_SCORING_RULES) replaces
+// them without a rebuild.
 // ============================================================================
 
+#include "detection_index.h"
 #include "models.h"
 
+#include <nlohmann/json.hpp>
+
 #include <algorithm>
+#include <array>
 #include <cmath>
-#include <functional>
-#include <memory>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <sstream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace mm {
 
-class DecisionTree {
+// ─── Features ───────────────────────────────────────────────────────────────
+
+enum class Feature : uint8_t {
+    CYCLE_POINTS,        // strongest cycle evidence (DetectionIndex)
+    SMURFING_POINTS,     // strongest fan-in / fan-out evidence
+    SHELL_POINTS,        // strongest shell-chain evidence
+    TRANSACTION_COUNT,
+    AVG_AMOUNT,          // (inflow + outflow) / (2 · transaction_count)
+    COUNT
+};
+
+// Legitimacy flags (Filters), one bit each
+enum LegitFlag : uint8_t {
+    FLAG_PAYROLL              = 1u << 0,
+    FLAG_MERCHANT             = 1u << 1,
+    FLAG_SALARY               = 1u << 2,
+    FLAG_ESTABLISHED_BUSINESS = 1u << 3,
+};
+
+// Per-account feature columns (indexed by NodeId).  Pattern columns view
+// the DetectionIndex, which must outlive this.
+struct ScoringFeatures {
+    size_t size = 0;
+    std::array<std::span<const double>, (size_t)Feature::COUNT> columns{};
+    std::vector<double>  transaction_count;
+    std::vector<double>  avg_amount;
+    std::vector<uint8_t> flags;
+
+    ScoringFeatures() = default;
+    ScoringFeatures(const ScoringFeatures&) = delete;          // columns view members
+    ScoringFeatures(ScoringFeatures&&) noexcept = default;     // moved vectors keep storage
+
+    std::span<const double> column(Feature f) const { return columns[(size_t)f]; }
+
+    static ScoringFeatures extract(const std::vector<AccountProfile>& profiles,
+                                   const DetectionIndex&              index) {
+        ScoringFeatures f;
+        const size_t N = profiles.size();
+        f.size = N;
+        f.transaction_count.resize(N);
+        f.avg_amount.resize(N);
+        f.flags.resize(N);
+        for (size_t i = 0; i < N; ++i) {
+            const AccountProfile& p = profiles[i];
+            f.transaction_count[i] = (double)p.transaction_count;
+            f.avg_amount[i] = p.transaction_count > 0
+                ? (p.total_inflow + p.total_outflow) / (2.0 * p.transaction_count) : 0.0;
+            f.flags[i] = (p.is_payroll              ? FLAG_PAYROLL              : 0) |
+                         (p.is_merchant             ? FLAG_MERCHANT             : 0) |
+                         (p.is_salary               ? FLAG_SALARY               : 0) |
+                         (p.is_established_business ? FLAG_ESTABLISHED_BUSINESS : 0);
+        }
+        f.columns[(size_t)Feature::CYCLE_POINTS]      = index.cycle_points().first(N);
+        f.columns[(size_t)Feature::SMURFING_POINTS]   = index.smurfing_points().first(N);
+        f.columns[(size_t)Feature::SHELL_POINTS]      = index.shell_points().first(N);
+        f.columns[(size_t)Feature::TRANSACTION_COUNT] = f.transaction_count;
+        f.columns[(size_t)Feature::AVG_AMOUNT]        = f.avg_amount;
+        return f;
+    }
+};
+
+// ─── Rule Set ───────────────────────────────────────────────────────────────
+
+class RuleSet {
 public:
+    // When a rule applies
+    enum class Test : uint8_t { ALWAYS, ABOVE, AT_LEAST, BELOW, AT_MOST, FLAG };
+    // What it adds: weight, weight · feature, or weight · log10(feature)
+    enum class Value : uint8_t { CONSTANT, FEATURE, LOG10 };
+
+    struct Node {
+        Feature feature   = Feature::CYCLE_POINTS;
+        Test    test      = Test::ALWAYS;
+        Value   value     = Value::CONSTANT;
+        uint8_t flags     = 0;                                      // Test::FLAG: any of
+        double  threshold = 0.0;
+        double  weight    = 1.0;
+        double  cap       = std::numeric_limits<double>::infinity(); // contribution ≤ cap
+    };
+
+    static constexpr size_t MAX_RULES    = 256;
+    static constexpr int    MAX_DECIMALS = 6;
+
+    // ── Python scoring.py ──────────────────────────────────────────────
+    static RuleSet defaults() {
+        RuleSet r;
+        // 1. Pattern scores
+        r.nodes_.push_back({Feature::CYCLE_POINTS,    Test::ALWAYS, Value::FEATURE});
+        r.nodes_.push_back({Feature::SMURFING_POINTS, Test::ALWAYS, Value::FEATURE});
+        r.nodes_.push_back({Feature::SHELL_POINTS,    Test::ALWAYS, Value::FEATURE});
+        // 2. Centrality / activity bonus: 5 · log10(count), at most +15
+        r.nodes_.push_back({Feature::TRANSACTION_COUNT, Test::ABOVE, Value::LOG10, 0, 10.0, 5.0, 15.0});
+        // 3. Amount anomaly: average transaction above 50k
+        r.nodes_.push_back({Feature::AVG_AMOUNT, Test::ABOVE, Value::CONSTANT, 0, 50000.0, 10.0});
+        // 4. Legitimacy deductions (false-positive control)
+        r.nodes_.push_back(flag_rule(FLAG_PAYROLL,              -50.0));
+        r.nodes_.push_back(flag_rule(FLAG_MERCHANT,             -40.0));
+        r.nodes_.push_back(flag_rule(FLAG_SALARY,               -30.0));
+        r.nodes_.push_back(flag_rule(FLAG_ESTABLISHED_BUSINESS, -40.0));
+        return r;
+    }
+
     /**
-     * Calculate suspicion scores for all accounts.
-     * Uses the same logic as Python scoring.py but structured as a
-     * decision tree traversal.
+     * Compile a JSON rule set:
+     *
+     *   {"rules": [{"feature": "transaction_count", "above": 10,
+     *               "value": "log10", "weight": 5, "cap": 15},
+     *              {"flag": "payroll", "weight": -50}, …],
+     *    "min_score": 0, "max_score": 100, "decimals": 1}
+     *
+     * A rule names a "feature" (with at most one of above / at_least /
+     * below / at_most; none = always) or a "flag"; "value" is constant
+     * (default), feature or log10; "weight" defaults to 1.  nullopt with
+     * `error` on anything malformed.
      */
-    static std::unordered_map<std::string, double> score_all(
-        const std::unordered_map<std::string, AccountProfile>& profiles,
-        const std::vector<CycleResult>&   cycles,
-        const std::vector<SmurfingResult>& smurfing,
-        const std::vector<ShellResult>&    shells)
-    {
-        // Pre-build lookup maps for O(1) per account
-        
-        // Cycle scores: 
-        // Length 3: 60pts, Length 4: 40pts, Length 5: 20pts
-        // Bonus: +10 if total amount > 10,000
-        std::unordered_map<std::string, double> cycle_scores;
-        for (const auto& c : cycles) {
-            double score = 20.0 * (6.0 - std::min(c.length, 5));
-            if (c.total_amount > 10000.0) score += 10.0;
-            for (const auto& node : c.nodes) {
-                cycle_scores[node] = std::max(cycle_scores[node], score);
+    static std::optional<RuleSet> from_json(std::string_view text, std::string& error) {
+        using nlohmann::json;
+        const json doc = json::parse(text, nullptr, false);
+        if (doc.is_discarded() || !doc.is_object()) return fail(error, "not a JSON object");
+
+        const auto rules = doc.find("rules");
+        if (rules == doc.end() || !rules->is_array() || rules->empty())
+            return fail(error, "\"rules\" must be a non-empty array");
+        if (rules->size() > MAX_RULES)
+            return fail(error, "at most " + std::to_string(MAX_RULES) + " rules");
+
+        RuleSet r;
+        for (size_t k = 0; k < rules->size(); ++k) {
+            const std::string at = "rule " + std::to_string(k) + ": ";
+            const json& j = (*rules)[k];
+            if (!j.is_object()) return fail(error, at + "not an object");
+
+            Node n;
+            if (!number(j, "weight", n.weight, error)) return fail(error, at + error);
+            if (!number(j, "cap", n.cap, error))       return fail(error, at + error);
+
+            if (auto fl = j.find("flag"); fl != j.end()) {
+                if (j.contains("feature")) return fail(error, at + "give a feature or a flag, not both");
+                if (!fl->is_string() || !(n.flags = parse_flag(fl->get<std::string>())))
+                    return fail(error, at + "unknown flag");
+                n.test = Test::FLAG;
+            } else {
+                const auto ft = j.find("feature");
+                if (ft == j.end() || !ft->is_string() || !parse_feature(ft->get<std::string>(), n.feature))
+                    return fail(error, at + "unknown or missing feature");
+
+                static constexpr std::pair<const char*, Test> TESTS[] = {
+                    {"above", Test::ABOVE}, {"at_least", Test::AT_LEAST},
+                    {"below", Test::BELOW}, {"at_most",  Test::AT_MOST},
+                };
+                for (const auto& [key, test] : TESTS) {
+                    if (!j.contains(key)) continue;
+                    if (n.test != Test::ALWAYS) return fail(error, at + "more than one condition");
+                    n.test = test;
+                    if (!number(j, key, n.threshold, error)) return fail(error, at + error);
+                }
             }
-        }
 
-        // Smurfing scores: 
-        // Base 25 (up from 15)
-        // +10 High Velocity (>5000/hr)
-        // +5 Many Counterparties (>20)
-        // +5 High Volume (>100k total)
-        std::unordered_map<std::string, double> smurf_scores;
-        for (const auto& s : smurfing) {
-            double score = 25.0;
-            if (s.velocity_per_hour > 5000.0)     score += 10.0;
-            if (s.unique_counterparties > 20)     score += 5.0;
-            if (s.total_amount > 100000.0)        score += 5.0;
-            smurf_scores[s.account_id] = std::max(smurf_scores[s.account_id], score);
+            if (auto v = j.find("value"); v != j.end()) {
+                const std::string name = v->is_string() ? v->get<std::string>() : "";
+                if      (name == "constant") n.value = Value::CONSTANT;
+                else if (name == "feature")  n.value = Value::FEATURE;
+                else if (name == "log10")    n.value = Value::LOG10;
+                else return fail(error, at + "value must be constant, feature or log10");
+                if (n.test == Test::FLAG && n.value != Value::CONSTANT)
+                    return fail(error, at + "flag rules add a constant");
+            }
+            if (!std::isfinite(n.weight) || !std::isfinite(n.threshold) || std::isnan(n.cap))
+                return fail(error, at + "weight and threshold must be finite");
+            r.nodes_.push_back(n);
         }
 
-        // Shell scores: 
-        // 25 per node, scaled by depth
-        std::unordered_map<std::string, double> shell_scores;
-        for (const auto& s : shells) {
-            double per_node = 25.0;
-            for (const auto& node : s.chain) {
-                shell_scores[node] = std::max(shell_scores[node], per_node);
+        double decimals = 1;
+        if (!number(doc, "min_score", r.min_, error) || !number(doc, "max_score", r.max_, error) ||
+            !number(doc, "decimals", decimals, error))
+            return std::nullopt;
+        if (!std::isfinite(r.min_) || !std::isfinite(r.max_) || r.min_ > r.max_)
+            return fail(error, "min_score must not exceed max_score");
+        if (decimals < 0 || decimals > MAX_DECIMALS || decimals != std::floor(decimals))
+            return fail(error, "decimals must be an integer in [0, " + std::to_string(MAX_DECIMALS) + "]");
+        r.scale_ = std::pow(10.0, decimals);
+        return r;
+    }
+
+    static std::optional<RuleSet> load_file(const std::string& path, std::string& error) {
+        std::ifstream in(path);
+        if (!in) return fail(error, "cannot read " + path);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        return from_json(ss.str(), error);
+    }
+
+    std::span<const Node> nodes() const { return nodes_; }
+
+    /**
+     * Score every account: one vectorisable pass per node, then clamp to
+     * [min_score, max_score] and round to `decimals`.
+     */
+    std::vector<double> score(const ScoringFeatures& f) const {
+        std::vector<double> s(f.size, 0.0);
+        for (const Node& n : nodes_) {
+            if (n.test == Test::FLAG) {
+                const uint8_t* fl = f.flags.data();
+                for (size_t i = 0; i < f.size; ++i) s[i] += (fl[i] & n.flags) ? n.weight : 0.0;
+                continue;
             }
-            // Intermediate nodes get extra risk
-            for (const auto& node : s.intermediate_accounts) {
-                shell_scores[node] = std::max(shell_scores[node],
-                    per_node + (10.0 * (double)s.shell_depth)); // +10 per depth
+            switch (n.value) {
+                case Value::CONSTANT: apply<Value::CONSTANT>(n, f.column(n.feature).data(), s); break;
+                case Value::FEATURE:  apply<Value::FEATURE>(n, f.column(n.feature).data(), s);  break;
+                case Value::LOG10:    apply<Value::LOG10>(n, f.column(n.feature).data(), s);    break;
             }
         }
+        for (double& v : s) v = std::round(std::clamp(v, min_, max_) * scale_) / scale_;
+        return s;
+    }
 
-        // Calculate final scores
-        std::unordered_map<std::string, double> scores;
+private:
+    std::vector<Node> nodes_;
+    double            min_   = 0.0;
+    double            max_   = 100.0;
+    double            scale_ = 10.0;     // 10^decimals
 
-        for (const auto& [acct_id, profile] : profiles) {
-            double score = 0.0;
+    static Node flag_rule(uint8_t flags, double weight) {
+        Node n;
+        n.test   = Test::FLAG;
+        n.flags  = flags;
+        n.weight = weight;
+        return n;
+    }
 
-            // 1. Pattern Scores
-            auto ci = cycle_scores.find(acct_id);
-            if (ci != cycle_scores.end()) score += ci->second;
+    template <Value V>
+    static double contribution(const Node& n, double x) {
+        if constexpr (V == Value::CONSTANT) return n.weight;
+        else if constexpr (V == Value::FEATURE) return std::min(n.weight * x, n.cap);
+        else return std::min(std::log10(x) * n.weight, n.cap);
+    }
 
-            auto si = smurf_scores.find(acct_id);
-            if (si != smurf_scores.end()) score += si->second;
+    template <Test T>
+    static bool holds(const Node& n, double x) {
+        if constexpr (T == Test::ALWAYS)        return true;
+        else if constexpr (T == Test::ABOVE)    return x > n.threshold;
+        else if constexpr (T == Test::AT_LEAST) return x >= n.threshold;
+        else if constexpr (T == Test::BELOW)    return x < n.threshold;
+        else                                    return x <= n.threshold;
+    }
 
-            auto shi = shell_scores.find(acct_id);
-            if (shi != shell_scores.end()) score += shi->second;
+    template <Value V, Test T>
+    static void apply_loop(const Node& n, const double* x, std::vector<double>& s) {
+        const double cap_const = std::min(n.weight, n.cap);
+        for (size_t i = 0; i < s.size(); ++i) {
+            const double c = V == Value::CONSTANT ? cap_const : contribution<V>(n, x[i]);
+            s[i] += holds<T>(n, x[i]) ? c : 0.0;
+        }
+    }
 
-            // 2. Centrality / Activity Bonus (limit to +15)
-            // Logarithmic scale of transaction count to detect hubs
-            if (profile.transaction_count > 10) {
-                double centrality = std::log10((double)profile.transaction_count) * 5.0;
-                score += std::min(centrality, 15.0);
-            }
+    template <Value V>
+    static void apply(const Node& n, const double* x, std::vector<double>& s) {
+        switch (n.test) {
+            case Test::ALWAYS:   apply_loop<V, Test::ALWAYS>(n, x, s);   break;
+            case Test::ABOVE:    apply_loop<V, Test::ABOVE>(n, x, s);    break;
+            case Test::AT_LEAST: apply_loop<V, Test::AT_LEAST>(n, x, s); break;
+            case Test::BELOW:    apply_loop<V, Test::BELOW>(n, x, s);    break;
+            case Test::AT_MOST:  apply_loop<V, Test::AT_MOST>(n, x, s);  break;
+            case Test::FLAG:     break;
+        }
+    }
 
-            // 3. Amount Anomaly Bonus (limit to +10)
-            // If avg transaction size is huge (>50k), add risk
-            if (profile.transaction_count > 0) {
-                double avg_val = (profile.total_inflow + profile.total_outflow) / (2.0 * profile.transaction_count);
-                if (avg_val > 50000.0) score += 10.0;
-            }
+    static bool parse_feature(const std::string& name, Feature& out) {
+        static constexpr std::pair<const char*, Feature> NAMES[] = {
+            {"cycle_points",      Feature::CYCLE_POINTS},
+            {"smurfing_points",   Feature::SMURFING_POINTS},
+            {"shell_points",      Feature::SHELL_POINTS},
+            {"transaction_count", Feature::TRANSACTION_COUNT},
+            {"avg_amount",        Feature::AVG_AMOUNT},
+        };
+        for (const auto& [key, f] : NAMES)
+            if (name == key) { out = f; return true; }
+        return false;
+    }
 
-            // 4. Legitimacy Deductions (False Positive Control)
-            if (profile.is_payroll)              score -= 50.0; // Stronger deduction
-            if (profile.is_merchant)             score -= 40.0;
-            if (profile.is_salary)               score -= 30.0;
-            if (profile.is_established_business) score -= 40.0;
-
-            // Clamp to [0, 100]
-            score = std::clamp(score, 0.0, 100.0);
-            
-            // Round to 1 decimal
-            scores[acct_id] = std::round(score * 10.0) / 10.0;
-        }
+    static uint8_t parse_flag(const std::string& name) {
+        if (name == "payroll")              return FLAG_PAYROLL;
+        if (name == "merchant")             return FLAG_MERCHANT;
+        if (name == "salary")               return FLAG_SALARY;
+        if (name == "established_business") return FLAG_ESTABLISHED_BUSINESS;
+        return 0;
+    }
+
+    // Optional numeric key: unchanged if absent, false if not a number
+    static bool number(const nlohmann::json& j, const char* key, double& out, std::string& error) {
+        auto it = j.find(key);
+        if (it == j.end()) return true;
+        if (!it->is_number()) { error = std::string(key) + " must be a number"; return false; }
+        out = it->get<double>();
+        return true;
+    }
+
+    static std::nullopt_t fail(std::string& error, std::string msg) {
+        error = std::move(msg);
+        return std::nullopt;
+    }
+};
+
+// ─── Decision Tree ──────────────────────────────────────────────────────────
+
+class DecisionTree {
+public:
+    // Replace the active rule set; call before serving (not synchronised)
+    static void configure(RuleSet rules) { active() = std::move(rules); }
+    static const RuleSet& rules() { return active(); }
+
+    /**
+     * Calculate suspicion scores for all accounts (indexed by NodeId).
+     * Per-pattern evidence comes from the DetectionIndex; `profiles` is
+     * indexed by NodeId too.
+     */
+    static std::vector<double> score_all(
+        const std::vector<AccountProfile>& profiles,
+        const DetectionIndex&              index)
+    {
+        return active().score(ScoringFeatures::extract(profiles, index));
+    }
 
-        return scores;
+private:
+    static RuleSet& active() {
+        static RuleSet rules = RuleSet::defaults();
+        return rules;
     }
 };
 
@@ -0,0 +1,97 @@
+#pragma once
+// ============================================================================
+// Detection Config – per-analysis detector thresholds
+//
+// Every tunable a detector takes, defaulting to the detector's own
+// DEFAULT_* constant, plus the connected_accounts cap of result
+// assembly.  AnalysisEngine::run passes them through; callers fill them
+// from a request (query string on upload, JSON body on re-analysis) via
+// params(), which names each one and bounds it.
+// ============================================================================
+
+#include "cycle_detector.h"
+#include "scoring.h"
+#include "shell_detector.h"
+#include "smurfing_detector.h"
+
+#include <cmath>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace mm {
+
+struct DetectionConfig {
+    // Cycles
+    int    cycle_max_length      = CycleDetector::DEFAULT_MAX_LENGTH;
+    double cycle_window_hours    = CycleDetector::DEFAULT_WINDOW_HRS;
+    int    max_cycles            = CycleDetector::DEFAULT_MAX_CYCLES;
+    long   max_steps_per_root    = CycleDetector::DEFAULT_MAX_STEPS_PER_ROOT;
+
+    // Smurfing
+    int    fan_threshold         = SmurfingDetector::DEFAULT_FAN_THRESHOLD;
+    double smurfing_window_hours = SmurfingDetector::DEFAULT_WINDOW_HRS;
+
+    // Shells
+    int    max_intermediate_txns = ShellDetector::DEFAULT_MAX_INTERMEDIATE_TXNS;
+    int    min_chain_length      = ShellDetector::DEFAULT_MIN_CHAIN_LENGTH;
+    int    max_chain_length      = ShellDetector::DEFAULT_MAX_CHAIN_LENGTH;
+    int    max_chains            = ShellDetector::DEFAULT_MAX_CHAINS;
+
+    // Result assembly
+    int    max_connected_accounts = Scoring::DEFAULT_MAX_CONNECTED;
+
+    // One request key; values outside [lo, hi] (or fractional, for
+    // integral ones) are refused
+    struct Param {
+        const char* key;
+        double      lo, hi;
+        bool        integral;
+        void      (*apply)(DetectionConfig&, double);
+    };
+
+    // Applied in this order, so the time_window_hours shorthand (both
+    // windows) is overridden by a per-detector window given alongside it
+    static std::span<const Param> params() {
+        using C = DetectionConfig;
+        static const Param table[] = {
+            {"time_window_hours",     1, 8760,   false, [](C& c, double v) {
+                 c.cycle_window_hours = c.smurfing_window_hours = v; }},
+            {"cycle_max_length",      3, 10,     true,  [](C& c, double v) { c.cycle_max_length = (int)v; }},
+            {"cycle_window_hours",    1, 8760,   false, [](C& c, double v) { c.cycle_window_hours = v; }},
+            {"max_cycles",            1, 100000, true,  [](C& c, double v) { c.max_cycles = (int)v; }},
+            {"max_steps_per_root",    0, 1e9,    true,  [](C& c, double v) { c.max_steps_per_root = (long)v; }},
+            {"fan_threshold",         2, 100000, true,  [](C& c, double v) { c.fan_threshold = (int)v; }},
+            {"smurfing_window_hours", 1, 8760,   false, [](C& c, double v) { c.smurfing_window_hours = v; }},
+            {"max_intermediate_txns", 1, 1000,   true,  [](C& c, double v) { c.max_intermediate_txns = (int)v; }},
+            {"min_chain_length",      2, 12,     true,  [](C& c, double v) { c.min_chain_length = (int)v; }},
+            {"max_chain_length",      2, 12,     true,  [](C& c, double v) { c.max_chain_length = (int)v; }},
+            {"max_chains",            1, 100000, true,  [](C& c, double v) { c.max_chains = (int)v; }},
+            {"max_connected_accounts", 0, 1000000, true, [](C& c, double v) { c.max_connected_accounts = (int)v; }},
+        };
+        return table;
+    }
+
+    // false (with `error`) if `value` is out of range for `p`
+    bool set(const Param& p, double value, std::string& error) {
+        if (!(value >= p.lo && value <= p.hi) || (p.integral && value != std::floor(value))) {
+            error = std::string(p.key) + " must be " + (p.integral ? "an integer" : "a number") +
+                    " in [" + std::to_string((long long)p.lo) + ", " +
+                    std::to_string((long long)p.hi) + "]";
+            return false;
+        }
+        p.apply(*this, value);
+        return true;
+    }
+
+    // Constraints between fields, checked once all keys are applied
+    bool validate(std::string& error) const {
+        if (min_chain_length > max_chain_length) {
+            error = "min_chain_length must not exceed max_chain_length";
+            return false;
+        }
+        return true;
+    }
+};
+
+} // namespace mm
@@ -0,0 +1,217 @@
+#pragma once
+// ============================================================================
+// Detection Index – account ↔ ring lookups for result assembly
+//
+// Built once per analysis from the detector output, then read by scoring,
+// suspicious-account, fraud-ring and graph-data assembly instead of each
+// building its own string-keyed maps.  Both directions are flat CSR over
+// integer IDs:
+//
+//   ring_off_[R+1]  → members_[]  (NodeIds, as the detector reported them)
+//   node_off_[N+1]  → rings_[]    (RingIds, in detection order)
+//
+// Built straight from the detectors' NodeIds; no account name is looked
+// up.  A RingId is the ring's position in cycles ++ smurfing ++ shells,
+// and the index owns each ring's global RING_NNN id (RingId + 1), which
+// AnalysisEngine::assemble copies into the output.  Per account there is
+// also a bitmask of spec-format pattern names (detected_patterns) and the
+// strongest evidence per pattern family, the inputs DecisionTree scores.
+// ============================================================================
+
+#include "graph_engine.h"
+#include "models.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mm {
+
+class DetectionIndex {
+public:
+    using RingId = uint32_t;
+
+    // detected_patterns vocabulary in output (lexicographic) order; bit k
+    // of spec_mask() is SPEC_NAMES[k].  DetectionConfig caps cycle length
+    // at 10, so every reportable length has a name.
+    static constexpr std::array<std::string_view, 15> SPEC_NAMES = {
+        "cycle_length_10", "cycle_length_2", "cycle_length_3", "cycle_length_4",
+        "cycle_length_5",  "cycle_length_6", "cycle_length_7", "cycle_length_8",
+        "cycle_length_9",  "fan_in",         "fan_out",        "high_velocity",
+        "layered_shell",   "shell",          "temporal_concentration",
+    };
+    static constexpr uint32_t SPEC_FAN_IN        = 1u << 9;
+    static constexpr uint32_t SPEC_FAN_OUT       = 1u << 10;
+    static constexpr uint32_t SPEC_HIGH_VELOCITY = 1u << 11;
+    static constexpr uint32_t SPEC_LAYERED_SHELL = 1u << 12;
+    static constexpr uint32_t SPEC_SHELL         = 1u << 13;
+    static constexpr uint32_t SPEC_TEMPORAL      = 1u << 14;
+
+    static constexpr double HIGH_VELOCITY_PER_HOUR = 5000.0;
+
+    static uint32_t spec_cycle_length(int length) {
+        if (length == 10) return 1u;
+        return (length >= 2 && length <= 9) ? 1u << (length - 1) : 0u;
+    }
+
+    DetectionIndex(const TransactionGraph&              graph,
+                   const std::vector<DetectedCycle>&    cycles,
+                   const std::vector<DetectedSmurfing>& smurfing,
+                   const std::vector<DetectedShell>&    shells,
+                   std::pmr::memory_resource*           mem = std::pmr::get_default_resource())
+        : ring_off_(mem), members_(mem), ring_ids_(mem), ring_patterns_(mem),
+          node_off_(mem), rings_(mem), spec_(mem),
+          cycle_points_(mem), smurfing_points_(mem), shell_points_(mem)
+    {
+        const size_t N = graph.node_count();
+        spec_.assign(N, 0);
+        cycle_points_.assign(N, 0.0);
+        smurfing_points_.assign(N, 0.0);
+        shell_points_.assign(N, 0.0);
+
+        const size_t R = cycles.size() + smurfing.size() + shells.size();
+        ring_off_.reserve(R + 1);
+        ring_ids_.reserve(R);
+        ring_patterns_.reserve(R);
+        ring_off_.push_back(0);
+
+        // ── 1. One sweep over the detector output: ring → members,
+        //       pattern bits and evidence per account ──────────────────
+        auto close_ring = [&](std::string_view pattern) {
+            const std::string id = ring_name(ring_ids_.size());
+            ring_ids_.emplace_back(id.data(), id.size());
+            ring_patterns_.push_back(pattern);
+            ring_off_.push_back((uint32_t)members_.size());
+        };
+
+        for (const auto& c : cycles) {
+            const uint32_t tag    = spec_cycle_length(c.length());
+            const double   points = cycle_points(c);
+            for (NodeId id : c.nodes) {
+                members_.push_back(id);
+                spec_[id] |= tag;
+                cycle_points_[id] = std::max(cycle_points_[id], points);
+            }
+            close_ring("cycle");
+        }
+        for (const auto& s : smurfing) {
+            const NodeId id = s.account;
+            members_.push_back(id);
+            spec_[id] |= (s.pattern == PatternType::FAN_IN ? SPEC_FAN_IN : SPEC_FAN_OUT) |
+                         SPEC_TEMPORAL |                          // window evidence
+                         (s.velocity_per_hour > HIGH_VELOCITY_PER_HOUR ? SPEC_HIGH_VELOCITY : 0u);
+            smurfing_points_[id] = std::max(smurfing_points_[id], smurfing_points(s));
+            close_ring(pattern_to_string(s.pattern));
+        }
+        for (const auto& s : shells) {
+            for (NodeId id : s.chain) {
+                members_.push_back(id);
+                spec_[id] |= SPEC_LAYERED_SHELL | SPEC_SHELL;
+                shell_points_[id] = std::max(shell_points_[id], SHELL_MEMBER_POINTS);
+            }
+            // Intermediate accounts carry extra risk
+            const double points = shell_intermediate_points(s);
+            for (size_t k = 1; k + 1 < s.chain.size(); ++k) {
+                const NodeId id = s.chain[k];
+                shell_points_[id] = std::max(shell_points_[id], points);
+            }
+            close_ring("shell");
+        }
+
+        // ── 2. Invert: account → rings, by counting sort on member ─────
+        node_off_.assign(N + 1, 0);
+        for (NodeId m : members_) ++node_off_[m + 1];
+        for (size_t n = 0; n < N; ++n) node_off_[n + 1] += node_off_[n];
+
+        rings_.resize(members_.size());
+        std::pmr::vector<uint32_t> cursor(node_off_.begin(), node_off_.end() - 1, mem);
+        for (RingId r = 0; r < (RingId)ring_ids_.size(); ++r)
+            for (uint32_t k = ring_off_[r]; k < ring_off_[r + 1]; ++k)
+                rings_[cursor[members_[k]]++] = r;
+    }
+
+    size_t node_count() const { return spec_.size(); }
+    size_t ring_count() const { return ring_ids_.size(); }
+
+    // ── Per account ────────────────────────────────────────────────────
+    // Rings n is a member of, in detection order (one entry per membership)
+    std::span<const RingId> rings(NodeId n) const {
+        return {rings_.data() + node_off_[n], node_off_[n + 1] - node_off_[n]};
+    }
+    bool flagged(NodeId n) const { return node_off_[n + 1] != node_off_[n]; }
+
+    uint32_t spec_mask(NodeId n) const { return spec_[n]; }
+
+    // SPEC_NAMES of spec_mask(n), sorted
+    std::vector<std::string> spec_patterns(NodeId n) const {
+        std::vector<std::string> out;
+        for (uint32_t m = spec_[n]; m; m &= m - 1)
+            out.emplace_back(SPEC_NAMES[std::countr_zero(m)]);
+        return out;
+    }
+
+    // Strongest evidence per pattern family (0 when not involved)
+    std::span<const double> cycle_points() const    { return cycle_points_; }
+    std::span<const double> smurfing_points() const { return smurfing_points_; }
+    std::span<const double> shell_points() const    { return shell_points_; }
+
+    // ── Per ring ───────────────────────────────────────────────────────
+    std::span<const NodeId> members(RingId r) const {
+        return {members_.data() + ring_off_[r], ring_off_[r + 1] - ring_off_[r]};
+    }
+    std::string_view ring_id(RingId r) const      { return ring_ids_[r]; }      // RING_NNN
+    std::string_view ring_pattern(RingId r) const { return ring_patterns_[r]; } // raw type
+
+    // Global ring ID of RingId r: RING_001, RING_002, …
+    static std::string ring_name(size_t r) {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "RING_%03zu", r + 1);
+        return std::string(buf);
+    }
+
+    // ── Evidence points (mirrors Python scoring.py) ────────────────────
+    // Cycles: length 3 → 60, 4 → 40, 5+ → 20; +10 above 10,000 moved
+    static double cycle_points(const DetectedCycle& c) {
+        double points = 20.0 * (6.0 - std::min(c.length(), 5));
+        if (c.total_amount > 10000.0) points += 10.0;
+        return points;
+    }
+
+    // Smurfing: base 25; +10 high velocity, +5 >20 counterparties, +5 >100k
+    static double smurfing_points(const DetectedSmurfing& s) {
+        double points = 25.0;
+        if (s.velocity_per_hour > HIGH_VELOCITY_PER_HOUR) points += 10.0;
+        if (s.unique_counterparties > 20)                 points += 5.0;
+        if (s.total_amount > 100000.0)                    points += 5.0;
+        return points;
+    }
+
+    // Shells: 25 per chain member, +10 per depth for intermediates
+    static constexpr double SHELL_MEMBER_POINTS = 25.0;
+    static double shell_intermediate_points(const DetectedShell& s) {
+        return SHELL_MEMBER_POINTS + 10.0 * (double)s.shell_depth();
+    }
+
+private:
+    std::pmr::vector<uint32_t>         ring_off_;        // R+1
+    std::pmr::vector<NodeId>           members_;
+    std::pmr::vector<std::pmr::string> ring_ids_;        // R
+    std::pmr::vector<std::string_view> ring_patterns_;   // string literals
+
+    std::pmr::vector<uint32_t>         node_off_;        // N+1
+    std::pmr::vector<RingId>           rings_;
+    std::pmr::vector<uint32_t>         spec_;            // N
+
+    std::pmr::vector<double>           cycle_points_;    // N
+    std::pmr::vector<double>           smurfing_points_;
+    std::pmr::vector<double>           shell_points_;
+};
+
+} // namespace mm
@@ -4,17 +4,26 @@
 //
 // Identifies legitimate accounts: payroll, merchant, salary, established
 // business patterns.  Mirrors Python filters.py exactly.
+//
+// Each account is read as columns: its outgoing amounts / timestamps are
+// one contiguous slice of the graph's transaction columns, its incoming
+// ones are gathered into reusable scratch (one time-sorted run per
+// sender).  Sums, sums of squares, maxima and round-cent counts then run
+// through the lane-parallel kernels in kernels.h; medians use nth_element.
+// Business-name checks read the graph's per-account BusinessClassifier
+// flag instead of running a regex per account.
 // ============================================================================
 
+#include "graph_engine.h"
+#include "kernels.h"
 #include "models.h"
 
 #include <algorithm>
 #include <chrono>
 #include <cmath>
-#include <regex>
+#include <cstdint>
+#include <span>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace mm {
@@ -22,209 +31,191 @@ namespace mm {
 class Filters {
 public:
     /**
-     * Enrich each AccountProfile with boolean flags for legitimate-account
-     * heuristics.  Mutates profiles in-place.
+     * Enrich each AccountProfile (indexed by NodeId) with boolean flags for
+     * legitimate-account heuristics.  Mutates profiles in-place.
+     * Per-account flows are read straight from the graph's CSR rows, so no
+     * transaction list is needed.
      */
-    static void apply(
-        std::unordered_map<std::string, AccountProfile>& profiles,
-        const std::vector<Transaction>& txns)
-    {
-        // Group transactions by receiver and sender
-        std::unordered_map<std::string, std::vector<const Transaction*>> incoming;
-        std::unordered_map<std::string, std::vector<const Transaction*>> outgoing;
+    static void apply(std::vector<AccountProfile>& profiles, const TransactionGraph& graph) {
+        Flows f;
+        for (NodeId id = 0; id < (NodeId)profiles.size(); ++id)
+            apply_one(profiles[id], graph, id, f);
+    }
 
-        for (const auto& t : txns) {
-            incoming[t.receiver].push_back(&t);
-            outgoing[t.sender].push_back(&t);
-        }
+    // Re-evaluate only `accounts` (e.g. those touched by an append)
+    static void apply(std::vector<AccountProfile>& profiles, const TransactionGraph& graph,
+                      const std::vector<NodeId>& accounts) {
+        Flows f;
+        for (NodeId id : accounts) apply_one(profiles[id], graph, id, f);
+    }
 
-        for (auto& [acct_id, profile] : profiles) {
-            const auto& inc = incoming.count(acct_id) ? incoming[acct_id]
-                                                       : empty_txns_;
-            const auto& out = outgoing.count(acct_id) ? outgoing[acct_id]
-                                                       : empty_txns_;
+private:
+    // One account's transactions as columns; buffers are reused
+    struct Flows {
+        std::vector<double>    in_amount;
+        std::vector<TimePoint> in_ts;
+        std::vector<uint32_t>  in_run;      // in_*[in_run[k], in_run[k+1]) = k-th sender
+        std::span<const double>    out_amount;
+        std::span<const TimePoint> out_ts;
+
+        std::vector<TimePoint> ts_scratch;
+        std::vector<double>    diffs;
+    };
+
+    static void apply_one(AccountProfile& profile, const TransactionGraph& graph,
+                          NodeId id, Flows& f) {
+        collect_flows(graph, id, f);
+
+        profile.is_payroll              = is_payroll(f);
+        profile.is_merchant             = is_merchant(f, graph.is_business(id));
+        profile.is_salary               = is_salary(f);
+        profile.is_established_business = is_established_business(f, graph, id);
+    }
 
-            profile.is_payroll              = is_payroll(inc);
-            profile.is_merchant             = is_merchant(inc, out);
-            profile.is_salary               = is_salary(inc, out);
-            profile.is_established_business = is_established_business(inc, out, acct_id);
+    static void collect_flows(const TransactionGraph& graph, NodeId id, Flows& f) {
+        f.in_amount.clear();
+        f.in_ts.clear();
+        f.in_run.clear();
+        for (EdgeId e : graph.in_edges(id)) {
+            f.in_run.push_back((uint32_t)f.in_amount.size());
+            auto amts = graph.edge_amounts(e);
+            auto tss  = graph.edge_timestamps(e);
+            f.in_amount.insert(f.in_amount.end(), amts.begin(), amts.end());
+            f.in_ts.insert(f.in_ts.end(), tss.begin(), tss.end());
         }
+        f.in_run.push_back((uint32_t)f.in_amount.size());
+        f.out_amount = graph.out_amounts(id);
+        f.out_ts     = graph.out_timestamps(id);
     }
 
-private:
-    static inline const std::vector<const Transaction*> empty_txns_{};
+    // Median of day gaps between consecutive (sorted) timestamps
+    static double median_gap_days(std::span<const TimePoint> sorted_ts,
+                                  std::vector<double>& diffs) {
+        diffs.clear();
+        for (size_t i = 1; i < sorted_ts.size(); ++i) {
+            auto diff = sorted_ts[i] - sorted_ts[i - 1];
+            diffs.push_back(std::chrono::duration_cast<std::chrono::hours>(diff).count() / 24.0);
+        }
+        auto mid = diffs.begin() + diffs.size() / 2;
+        std::nth_element(diffs.begin(), mid, diffs.end());
+        return *mid;
+    }
 
     // ── Payroll: single dominant sender, monthly, consistent amount ─────
-    static bool is_payroll(const std::vector<const Transaction*>& inc,
-                           double tolerance = 0.10) {
-        if (inc.size() < 3) return false;
-
-        // Count senders
-        std::unordered_map<std::string, int> sender_counts;
-        for (auto* t : inc) sender_counts[t->sender]++;
-
-        // Find dominant sender
-        std::string dominant;
-        int max_count = 0;
-        for (const auto& [s, c] : sender_counts) {
-            if (c > max_count) { max_count = c; dominant = s; }
+    static bool is_payroll(Flows& f, double tolerance = 0.10) {
+        const size_t n = f.in_amount.size();
+        if (n < 3) return false;
+
+        // Dominant sender = longest run (one run per sender)
+        size_t dom = 0, max_count = 0;
+        for (size_t k = 0; k + 1 < f.in_run.size(); ++k) {
+            size_t c = f.in_run[k + 1] - f.in_run[k];
+            if (c > max_count) { max_count = c; dom = k; }
         }
 
-        double dominant_ratio = (double)max_count / (double)inc.size();
+        double dominant_ratio = (double)max_count / (double)n;
         if (dominant_ratio < 0.80) return false;
+        if (max_count < 3) return false;
 
-        // Get amounts from dominant sender, sorted by timestamp
-        std::vector<std::pair<TimePoint, double>> dom_txns;
-        for (auto* t : inc) {
-            if (t->sender == dominant) dom_txns.push_back({t->timestamp, t->amount});
-        }
-        std::sort(dom_txns.begin(), dom_txns.end());
-        if (dom_txns.size() < 3) return false;
+        // The run is already in timestamp order
+        std::span<const double>    amts(f.in_amount.data() + f.in_run[dom], max_count);
+        std::span<const TimePoint> tss(f.in_ts.data() + f.in_run[dom], max_count);
 
         // Check amount consistency (coefficient of variation)
-        double sum = 0, sum_sq = 0;
-        for (const auto& [_, amt] : dom_txns) {
-            sum += amt;
-            sum_sq += amt * amt;
-        }
-        double mean = sum / dom_txns.size();
+        auto [sum, sum_sq] = kernels::sum_sq(amts);
+        double mean = sum / max_count;
         if (mean == 0) return false;
-        double variance = sum_sq / dom_txns.size() - mean * mean;
+        double variance = sum_sq / max_count - mean * mean;
         double std_dev = std::sqrt(std::max(variance, 0.0));
         double cv = std_dev / mean;
         if (cv > tolerance) return false;
 
         // Check roughly monthly interval (25-35 days)
-        std::vector<double> diffs;
-        for (size_t i = 1; i < dom_txns.size(); ++i) {
-            auto diff = dom_txns[i].first - dom_txns[i - 1].first;
-            double days = std::chrono::duration_cast<std::chrono::hours>(diff).count() / 24.0;
-            diffs.push_back(days);
-        }
-        if (diffs.empty()) return false;
-
-        // Median diff
-        std::sort(diffs.begin(), diffs.end());
-        double median = diffs[diffs.size() / 2];
+        double median = median_gap_days(tss, f.diffs);
         return median >= 25 && median <= 35;
     }
 
     // ── Merchant: many small inflows, fewer larger outflows ────────────
-    static bool is_merchant(const std::vector<const Transaction*>& inc,
-                            const std::vector<const Transaction*>& out) {
-        // Name check fallback (optimization)
-        if (!inc.empty() && looks_like_business(inc[0]->receiver)) return true;
+    static bool is_merchant(const Flows& f, bool business_name) {
+        const size_t n_in = f.in_amount.size(), n_out = f.out_amount.size();
 
-        if (inc.size() < 20) return false;
+        // Name check fallback (optimization)
+        if (n_in > 0 && business_name) return true;
 
-        double sum_in = 0;
-        for (auto* t : inc) sum_in += t->amount;
-        double avg_in = sum_in / inc.size();
+        if (n_in < 20) return false;
 
-        double avg_out = 0;
-        if (!out.empty()) {
-            double sum_out = 0;
-            for (auto* t : out) sum_out += t->amount;
-            avg_out = sum_out / out.size();
-        }
+        double avg_in  = kernels::sum(f.in_amount) / n_in;
+        double avg_out = n_out ? kernels::sum(f.out_amount) / n_out : 0.0;
 
         // Many small in, fewer large out
         if (avg_out <= avg_in) return false;
-        if (inc.size() < 5 * std::max(out.size(), (size_t)1)) return false;
+        if (n_in < 5 * std::max(n_out, (size_t)1)) return false;
 
         // Round-number amounts (pricing)
-        int round_count = 0;
-        for (auto* t : inc) {
-            if (is_round_number(t->amount)) ++round_count;
-        }
-        double round_ratio = (double)round_count / (double)inc.size();
+        double round_ratio = (double)kernels::count_round_cents(f.in_amount) / (double)n_in;
         return round_ratio > 0.3;
     }
 
-    static bool looks_like_business(const std::string& id) {
-        static const std::regex biz_pat(
-            "(corp|inc|llc|ltd|co\\b|merchant|store|shop|pay|bank|services|mart|pvt)",
-            std::regex::icase | std::regex::optimize);
-        return std::regex_search(id, biz_pat);
-    }
-
     // ── Salary: one large monthly deposit + regular outgoing bills ─────
-    static bool is_salary(const std::vector<const Transaction*>& inc,
-                          const std::vector<const Transaction*>& out) {
-        if (inc.size() < 2) return false;
-
-        // Find max amount
-        double max_amt = 0;
-        for (auto* t : inc) {
-            if (t->amount > max_amt) max_amt = t->amount;
-        }
+    static bool is_salary(Flows& f) {
+        if (f.in_amount.size() < 2) return false;
 
         // Large deposits (> 70% of max)
-        std::vector<TimePoint> large_ts;
-        for (auto* t : inc) {
-            if (t->amount > 0.7 * max_amt) large_ts.push_back(t->timestamp);
-        }
-        if (large_ts.size() < 2) return false;
+        const double cut = 0.7 * kernels::max(f.in_amount, 0.0);
+        if (kernels::count_greater(f.in_amount, cut) < 2) return false;
+
+        auto& large_ts = f.ts_scratch;
+        large_ts.clear();
+        for (size_t i = 0; i < f.in_amount.size(); ++i)
+            if (f.in_amount[i] > cut) large_ts.push_back(f.in_ts[i]);
 
         // Check monthly pattern
         std::sort(large_ts.begin(), large_ts.end());
-        std::vector<double> diffs;
-        for (size_t i = 1; i < large_ts.size(); ++i) {
-            auto diff = large_ts[i] - large_ts[i - 1];
-            double days = std::chrono::duration_cast<std::chrono::hours>(diff).count() / 24.0;
-            diffs.push_back(days);
-        }
-        if (diffs.empty()) return false;
-        std::sort(diffs.begin(), diffs.end());
-        double median = diffs[diffs.size() / 2];
+        double median = median_gap_days(large_ts, f.diffs);
         if (median < 25 || median > 35) return false;
 
         // Should have regular outgoing
-        return out.size() >= 3;
+        return f.out_amount.size() >= 3;
     }
 
     // ── Established business: long history, diverse counterparties ─────
     static bool is_established_business(
-        const std::vector<const Transaction*>& inc,
-        const std::vector<const Transaction*>& out,
-        const std::string& acct_id)
+        const Flows& f,
+        const TransactionGraph& graph,
+        NodeId id)
     {
-        size_t total = inc.size() + out.size();
+        size_t total = f.in_amount.size() + f.out_amount.size();
         if (total < 20) return false;
 
         // History span
         TimePoint min_ts = TimePoint::max(), max_ts = TimePoint::min();
-        for (auto* t : inc) {
-            if (t->timestamp < min_ts) min_ts = t->timestamp;
-            if (t->timestamp > max_ts) max_ts = t->timestamp;
-        }
-        for (auto* t : out) {
-            if (t->timestamp < min_ts) min_ts = t->timestamp;
-            if (t->timestamp > max_ts) max_ts = t->timestamp;
-        }
+        kernels::min_max<TimePoint>(f.in_ts, min_ts, max_ts);
+        kernels::min_max<TimePoint>(f.out_ts, min_ts, max_ts);
 
         double days = std::chrono::duration_cast<std::chrono::hours>(max_ts - min_ts).count() / 24.0;
         if (days < 180) return false; // < 6 months
 
-        // Diverse counterparties
-        std::unordered_set<std::string> cps;
-        for (auto* t : inc) cps.insert(t->sender);
-        for (auto* t : out) cps.insert(t->receiver);
-        if (cps.size() < 10) return false;
+        // Diverse counterparties – both rows are sorted by ID, so the
+        // size of their union is a merge count
+        if (distinct_counterparties(graph.predecessors(id), graph.successors(id)) < 10)
+            return false;
 
         // Business-name heuristic
-        static const std::regex biz_pat(
-            "(corp|inc|llc|ltd|co\\b|merchant|store|shop|pay|bank|services)",
-            std::regex::icase);
-        if (std::regex_search(acct_id, biz_pat)) return true;
+        if (graph.is_business(id)) return true;
 
         return total > 100; // high-volume fallback
     }
 
-    static bool is_round_number(double amount) {
-        double cents = std::fmod(std::round(amount * 100.0), 100.0) / 100.0;
-        return cents == 0.0 || cents == 0.99 || cents == 0.95
-            || cents == 0.49 || cents == 0.50;
+    static size_t distinct_counterparties(std::span<const NodeId> a,
+                                          std::span<const NodeId> b) {
+        size_t i = 0, j = 0, n = 0;
+        while (i < a.size() && j < b.size()) {
+            if (a[i] < b[j])      ++i;
+            else if (b[j] < a[i]) ++j;
+            else                  { ++i; ++j; }
+            ++n;
+        }
+        return n + (a.size() - i) + (b.size() - j);
     }
 };
 
@@ -2,30 +2,31 @@
 // ============================================================================
 // Graph Engine – directed multi-graph for transaction network analysis
 //
-// Adjacency-list representation with O(1) neighbour & edge lookups.
-// Mirrors Python graph_builder.py: build_graph, collapse, profiles, viz data.
+// Account IDs are interned to dense NodeIds as rows are parsed (see
+// transaction_table.h), and build() works on those integers.  Adjacency
+// is stored as compressed sparse rows (forward + reverse), and every
+// aggregated edge owns a contiguous slice of one flat amount/timestamp
+// array, so detectors walk plain integer arrays instead of string maps.
+// Mirrors Python graph_builder.py: build_graph, collapse, profiles (viz
+// data is assembled in scoring.h).
 // ============================================================================
 
+#include "business_classifier.h"
+#include "column.h"
+#include "interner.h"
 #include "models.h"
+#include "transaction_table.h"
 
 #include <algorithm>
 #include <cmath>
-#include <regex>
+#include <memory>
+#include <span>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <string_view>
 #include <vector>
 
 namespace mm {
 
-// ─── Multi-edge storage ────────────────────────────────────────────────────
-struct MultiEdge {
-    std::string from;
-    std::string to;
-    double      amount = 0.0;
-    TimePoint   timestamp{};
-};
-
 // ─── Node attributes ──────────────────────────────────────────────────────
 struct NodeAttr {
     double total_inflow       = 0.0;
@@ -33,6 +34,7 @@ struct NodeAttr {
     int    transaction_count  = 0;
     TimePoint first_seen{};
     TimePoint last_seen{};
+    bool   is_business        = false;   // BusinessClassifier, once per account
 };
 
 // ─── Aggregated edge (for the simple DiGraph) ─────────────────────────────
@@ -43,277 +45,339 @@ struct AggEdge {
     TimePoint latest{};
 };
 
-// ─── Transaction Graph ────────────────────────────────────────────────────
-class TransactionGraph {
+// ─── Graph Builder ────────────────────────────────────────────────────────
+//
+// A TransactionTable plus per-node attributes.  parse_csv output is
+// adopted whole; stream input (see stream_ingest.h) is added one row at a
+// time, so neither path holds per-row strings.
+// TransactionGraph::build(GraphBuilder&&) turns the columns into CSR.
+class GraphBuilder {
 public:
-    TransactionGraph() = default;
+    GraphBuilder() = default;
 
-    // Build from parsed transactions (mirrors graph_builder.build_graph)
-    void build(const std::vector<Transaction>& txns) {
-        clear();
-        txns_ = &txns;
+    // Adopt parsed rows; node attributes are folded in one pass
+    explicit GraphBuilder(TransactionTable&& rows) : rows_(std::move(rows)) {
+        accumulate(0);
+    }
+
+    void reserve(size_t txns) { rows_.reserve(txns); }
+
+    void add(std::string_view sender, std::string_view receiver,
+             double amount, TimePoint ts) {
+        rows_.add(sender, receiver, amount, ts);
+        accumulate(rows_.size() - 1);
+    }
+
+    // Append parsed rows (AnalysisSession ingests); returns the table's
+    // NodeId → builder NodeId
+    std::vector<NodeId> append(const TransactionTable& rows) {
+        const size_t first = rows_.size();
+        auto remap = rows_.append(rows);
+        accumulate(first);
+        return remap;
+    }
+
+    size_t transaction_count() const { return rows_.size(); }
+    size_t node_count() const { return nodes_.size(); }
+    const TransactionTable& rows() const { return rows_; }
 
-        for (const auto& t : txns) {
-            // Ensure nodes exist
-            ensure_node(t.sender);
-            ensure_node(t.receiver);
+private:
+    friend class TransactionGraph;
+
+    TransactionTable       rows_;
+    std::vector<NodeAttr>  nodes_;
+
+    // Classify accounts first seen since the last call, then fold rows
+    // [first, end) into the sender / receiver attributes
+    void accumulate(size_t first) {
+        for (NodeId id = (NodeId)nodes_.size(); id < (NodeId)rows_.account_count(); ++id)
+            nodes_.emplace_back().is_business = BusinessClassifier::is_business(rows_.name(id));
 
-            // Update node attributes
-            auto& sn = nodes_[t.sender];
-            sn.total_outflow      += t.amount;
+        for (size_t i = first; i < rows_.size(); ++i) {
+            const double    amount = rows_.amount(i);
+            const TimePoint ts     = rows_.timestamp(i);
+
+            auto& sn = nodes_[rows_.sender(i)];
+            sn.total_outflow      += amount;
             sn.transaction_count  += 1;
-            update_time(sn, t.timestamp);
+            update_time(sn, ts);
 
-            auto& rn = nodes_[t.receiver];
-            rn.total_inflow       += t.amount;
+            auto& rn = nodes_[rows_.receiver(i)];
+            rn.total_inflow       += amount;
             rn.transaction_count  += 1;
-            update_time(rn, t.timestamp);
+            update_time(rn, ts);
+        }
+    }
 
-            // Add multi-edge
-            multi_edges_.push_back({t.sender, t.receiver, t.amount, t.timestamp});
+    static void update_time(NodeAttr& n, TimePoint tp) {
+        if (n.transaction_count <= 1) {
+            n.first_seen = tp;
+            n.last_seen  = tp;
+        } else {
+            if (tp < n.first_seen) n.first_seen = tp;
+            if (tp > n.last_seen)  n.last_seen  = tp;
+        }
+    }
+};
 
-            // Aggregate for simple digraph
-            auto key = edge_key(t.sender, t.receiver);
-            auto& agg = agg_edges_[key];
-            agg.total_amount      += t.amount;
-            agg.transaction_count += 1;
-            if (agg.transaction_count == 1) {
-                agg.earliest = t.timestamp;
-                agg.latest   = t.timestamp;
-            } else {
-                if (t.timestamp < agg.earliest) agg.earliest = t.timestamp;
-                if (t.timestamp > agg.latest)   agg.latest   = t.timestamp;
-            }
+// ─── Transaction Graph ────────────────────────────────────────────────────
+//
+// Layout (N nodes, E unique directed edges, T transactions):
+//   out_off_[N+1]  → row u of edge_dst_[E]; EdgeId == forward CSR slot
+//   in_off_[N+1]   → row v of in_src_[E] / in_edge_[E]
+//   txn_off_[E+1]  → slice of txn_amount_[T] / txn_ts_[T] for each edge,
+//                    sorted by timestamp
+// Rows are sorted by neighbour ID, so edge lookup is a binary search.
+// Every array is a Column: owned after build(), or viewing a mapped
+// snapshot file in place (GraphSnapshot::open keeps the mapping alive).
+class TransactionGraph {
+public:
+    TransactionGraph() = default;
 
-            // Adjacency
-            adj_[t.sender].insert(t.receiver);
-            // Also track reverse adjacency for in-degree lookups
-            rev_adj_[t.receiver].insert(t.sender);
+    // Build from parsed transactions (mirrors graph_builder.build_graph);
+    // the table is consumed
+    void build(TransactionTable&& txns) { build(GraphBuilder(std::move(txns))); }
 
-            // Edge data list: (sender, receiver) → list of (amount, timestamp)
-            edge_txns_[{t.sender, t.receiver}].push_back({t.amount, t.timestamp});
-        }
+    // Build from accumulated columns; the builder is consumed
+    void build(GraphBuilder&& b) {
+        clear();
+        names_ = AccountNames(b.rows_.accounts());
+        nodes_ = std::move(b.nodes_);
+        build_edges(b);
+
+        // Input columns are no longer needed – release before the CSR passes
+        b = GraphBuilder{};
+        build_csr();
     }
 
-    // ── Node accessors ─────────────────────────────────────────────────
-    const std::unordered_map<std::string, NodeAttr>& all_nodes() const { return nodes_; }
-    bool has_node(const std::string& n) const { return nodes_.count(n); }
-    const NodeAttr& node(const std::string& n) const { return nodes_.at(n); }
+    // Build from accumulated columns, leaving the builder intact so more
+    // rows can be added and the graph rebuilt (AnalysisSession appends)
+    void build(const GraphBuilder& b) {
+        clear();
+        names_ = AccountNames(b.rows_.accounts());
+        nodes_ = b.nodes_;
+        build_edges(b);
+        build_csr();
+    }
+
+    // ── Interned IDs ───────────────────────────────────────────────────
     size_t node_count() const { return nodes_.size(); }
+    NodeId find(std::string_view id) const { return names_.find(id); }
+    bool has_node(std::string_view id) const { return find(id) != INVALID_NODE; }
+    std::string_view name(NodeId n) const { return names_.name(n); }
 
-    // ── Edge accessors ─────────────────────────────────────────────────
-    const std::unordered_map<std::string, AggEdge>& all_agg_edges() const { return agg_edges_; }
-    bool has_edge(const std::string& u, const std::string& v) const {
-        return agg_edges_.count(edge_key(u, v));
+    size_t transaction_count() const { return txn_amount_.size(); }
+
+    // ── Node accessors ─────────────────────────────────────────────────
+    const NodeAttr& node(NodeId n) const { return nodes_[n]; }
+    bool is_business(NodeId n) const { return nodes_[n].is_business; }
+    std::span<const NodeAttr> node_attrs() const { return nodes_; }
+
+    // ── Adjacency (sorted by neighbour ID) ─────────────────────────────
+    std::span<const NodeId> successors(NodeId n) const {
+        return {edge_dst_.data() + out_off_[n], out_off_[n + 1] - out_off_[n]};
     }
-    const AggEdge& agg_edge(const std::string& u, const std::string& v) const {
-        return agg_edges_.at(edge_key(u, v));
+    std::span<const NodeId> predecessors(NodeId n) const {
+        return {in_src_.data() + in_off_[n], in_off_[n + 1] - in_off_[n]};
     }
 
-    // ── Adjacency ──────────────────────────────────────────────────────
-    const std::unordered_set<std::string>& successors(const std::string& n) const {
-        static const std::unordered_set<std::string> empty;
-        auto it = adj_.find(n);
-        return it != adj_.end() ? it->second : empty;
+    int out_degree(NodeId n) const { return (int)(out_off_[n + 1] - out_off_[n]); }
+    int in_degree(NodeId n)  const { return (int)(in_off_[n + 1] - in_off_[n]); }
+
+    // ── Edge accessors ─────────────────────────────────────────────────
+    // Out-edges of u are the contiguous IDs [first_out_edge(u), +out_degree)
+    // in the same order as successors(u); in_edges(v) parallels predecessors(v).
+    size_t edge_count() const { return edge_src_.size(); }
+    EdgeId first_out_edge(NodeId u) const { return out_off_[u]; }
+    std::span<const EdgeId> in_edges(NodeId v) const {
+        return {in_edge_.data() + in_off_[v], in_off_[v + 1] - in_off_[v]};
     }
-    const std::unordered_set<std::string>& predecessors(const std::string& n) const {
-        static const std::unordered_set<std::string> empty;
-        auto it = rev_adj_.find(n);
-        return it != rev_adj_.end() ? it->second : empty;
+    NodeId edge_source(EdgeId e) const { return edge_src_[e]; }
+    NodeId edge_target(EdgeId e) const { return edge_dst_[e]; }
+    const AggEdge& agg_edge(EdgeId e) const { return agg_edges_[e]; }
+    std::span<const AggEdge> all_agg_edges() const { return agg_edges_; }
+
+    // O(log out_degree(u)); INVALID_EDGE if u never paid v
+    EdgeId find_edge(NodeId u, NodeId v) const {
+        auto row = successors(u);
+        auto it  = std::lower_bound(row.begin(), row.end(), v);
+        if (it == row.end() || *it != v) return INVALID_EDGE;
+        return out_off_[u] + (EdgeId)(it - row.begin());
     }
+    bool has_edge(NodeId u, NodeId v) const { return find_edge(u, v) != INVALID_EDGE; }
 
-    int out_degree(const std::string& n) const {
-        auto it = adj_.find(n);
-        return it != adj_.end() ? (int)it->second.size() : 0;
+    // ── Edge transaction data (timestamp order within an edge) ─────────
+    // edge_timestamps(e).front() / .back() == agg_edge(e).earliest / .latest
+    std::span<const double> edge_amounts(EdgeId e) const {
+        return {txn_amount_.data() + txn_off_[e], txn_off_[e + 1] - txn_off_[e]};
     }
-    int in_degree(const std::string& n) const {
-        auto it = rev_adj_.find(n);
-        return it != rev_adj_.end() ? (int)it->second.size() : 0;
+    std::span<const TimePoint> edge_timestamps(EdgeId e) const {
+        return {txn_ts_.data() + txn_off_[e], txn_off_[e + 1] - txn_off_[e]};
     }
 
-    // ── Edge transaction data ──────────────────────────────────────────
-    using TxnPair = std::pair<double, TimePoint>;
-    const std::vector<TxnPair>& edge_transactions(const std::string& u,
-                                                    const std::string& v) const {
-        static const std::vector<TxnPair> empty;
-        auto it = edge_txns_.find({u, v});
-        return it != edge_txns_.end() ? it->second : empty;
+    // Every outgoing transaction of u – its out-edges' slices are adjacent,
+    // so this is one contiguous column grouped by receiver
+    std::span<const double> out_amounts(NodeId u) const {
+        return {txn_amount_.data() + txn_off_[out_off_[u]],
+                txn_off_[out_off_[u + 1]] - txn_off_[out_off_[u]]};
     }
-
-    // ── All unique directed edges (u→v) ────────────────────────────────
-    std::vector<std::pair<std::string, std::string>> directed_edges() const {
-        std::vector<std::pair<std::string, std::string>> out;
-        out.reserve(agg_edges_.size());
-        for (const auto& [key, _] : agg_edges_) {
-            auto sep = key.find("→");
-            if (sep != std::string::npos) {
-                // UTF-8 "→" is 3 bytes
-                out.emplace_back(key.substr(0, sep), key.substr(sep + 3));
-            }
-        }
-        return out;
+    std::span<const TimePoint> out_timestamps(NodeId u) const {
+        return {txn_ts_.data() + txn_off_[out_off_[u]],
+                txn_off_[out_off_[u + 1]] - txn_off_[out_off_[u]]};
     }
 
     // ── Build account profiles (mirrors graph_builder.build_account_profiles) ──
-    std::unordered_map<std::string, AccountProfile> build_profiles() const {
-        std::unordered_map<std::string, AccountProfile> profiles;
+    // Indexed by NodeId
+    std::vector<AccountProfile> build_profiles() const {
+        std::vector<AccountProfile> profiles;
         profiles.reserve(nodes_.size());
-        // Pre-build business cache once — avoids repeated regex per node
-        build_business_cache();
-
-        for (const auto& [id, attr] : nodes_) {
-            AccountProfile p;
-            p.account_id        = id;
-            p.total_inflow      = attr.total_inflow;
-            p.total_outflow     = attr.total_outflow;
-            p.transaction_count = attr.transaction_count;
-            p.first_seen        = attr.first_seen;
-            p.last_seen         = attr.last_seen;
-            p.account_type      = is_business_cached(id) ? "business" : "individual";
-            profiles[id]        = std::move(p);
-        }
+        for (NodeId id = 0; id < (NodeId)nodes_.size(); ++id)
+            profiles.push_back(build_profile(id));
         return profiles;
     }
 
-    // ── Build graph visualization data ─────────────────────────────────
-    GraphData build_graph_data(
-        const std::unordered_map<std::string, double>& scores,
-        const std::unordered_map<std::string, std::vector<std::string>>& ring_map,
-        const std::unordered_map<std::string, std::vector<std::string>>& pattern_map
-    ) const {
-        GraphData gd;
-        gd.nodes.reserve(nodes_.size());
-        gd.edges.reserve(agg_edges_.size());
-        // Ensure business cache is warm
-        build_business_cache();
-
-        // Nodes
-        for (const auto& [id, attr] : nodes_) {
-            GraphNode gn;
-            gn.id                = id;
-            gn.label             = id;
-            gn.account_type      = is_business_cached(id) ? "business" : "individual";
-            gn.total_inflow      = attr.total_inflow;
-            gn.total_outflow     = attr.total_outflow;
-            gn.transaction_count = attr.transaction_count;
-
-            auto sit = scores.find(id);
-            gn.suspicion_score = sit != scores.end() ? sit->second : 0.0;
-            gn.is_suspicious   = gn.suspicion_score >= 25.0;
-
-            auto rit = ring_map.find(id);
-            if (rit != ring_map.end()) gn.ring_ids = rit->second;
-
-            // patterns = raw type strings; detected_patterns = spec-format
-            // (spec-format strings are injected by analysis_engine.h post-build)
-            auto pit = pattern_map.find(id);
-            if (pit != pattern_map.end()) gn.patterns = pit->second;
-
-            gd.nodes.push_back(std::move(gn));
-        }
-
-        // Edges
-        for (const auto& [key, agg] : agg_edges_) {
-            auto sep = key.find("→");
-            if (sep == std::string::npos) continue;
-
-            GraphEdge ge;
-            ge.source            = key.substr(0, sep);
-            ge.target            = key.substr(sep + 3);
-            ge.total_amount      = agg.total_amount;
-            ge.transaction_count = agg.transaction_count;
-
-            // Mark suspicious if either endpoint is suspicious
-            auto s1 = scores.find(ge.source);
-            auto s2 = scores.find(ge.target);
-            double sc1 = s1 != scores.end() ? s1->second : 0.0;
-            double sc2 = s2 != scores.end() ? s2->second : 0.0;
-            ge.is_suspicious = (sc1 >= 25.0 || sc2 >= 25.0);
-
-            // Determine pattern type from pattern_map
-            auto pp = pattern_map.find(ge.source);
-            if (pp != pattern_map.end() && !pp->second.empty())
-                ge.pattern_type = pp->second.front();
-
-            gd.edges.push_back(std::move(ge));
-        }
-
-        return gd;
+    // Profile of one account (before filters)
+    AccountProfile build_profile(NodeId id) const {
+        const auto& attr = nodes_[id];
+        AccountProfile p;
+        p.account_id        = name(id);
+        p.total_inflow      = attr.total_inflow;
+        p.total_outflow     = attr.total_outflow;
+        p.transaction_count = attr.transaction_count;
+        p.first_seen        = attr.first_seen;
+        p.last_seen         = attr.last_seen;
+        p.account_type      = attr.is_business ? "business" : "individual";
+        return p;
     }
 
-    void clear() {
-        nodes_.clear();
-        multi_edges_.clear();
-        agg_edges_.clear();
-        adj_.clear();
-        rev_adj_.clear();
-        edge_txns_.clear();
-        business_cache_.clear();
-        txns_ = nullptr;
-    }
+    void clear() { *this = TransactionGraph{}; }
+
+    // True when the columns view a mapped snapshot
+    bool is_mapped() const { return backing_ != nullptr; }
 
 private:
-    // Hash for pair<string,string>
-    struct PairHash {
-        size_t operator()(const std::pair<std::string, std::string>& p) const {
-            auto h1 = std::hash<std::string>{}(p.first);
-            auto h2 = std::hash<std::string>{}(p.second);
-            return h1 ^ (h2 << 32 | h2 >> 32);
+    friend class GraphSnapshot;
+
+    AccountNames           names_;
+    Column<NodeAttr>       nodes_;
+
+    Column<uint32_t>       out_off_;    // N+1
+    Column<NodeId>         edge_src_;   // E
+    Column<NodeId>         edge_dst_;   // E (forward CSR targets)
+    Column<uint32_t>       in_off_;     // N+1
+    Column<NodeId>         in_src_;     // E (reverse CSR sources)
+    Column<EdgeId>         in_edge_;    // E (reverse CSR → edge ID)
+    Column<AggEdge>        agg_edges_;  // E
+    Column<uint32_t>       txn_off_;    // E+1
+    Column<double>         txn_amount_; // T
+    Column<TimePoint>      txn_ts_;     // T
+
+    std::shared_ptr<const void> backing_;   // the mapping views point into
+
+    // ── 1. Group transactions by (sender, receiver) ────────────────────
+    // Two stable counting-sort passes (by receiver, then sender) –
+    // O(T + N) – then each edge's slice is stably sorted by timestamp, so
+    // edge_timestamps() is a sorted index (ties keep input order).
+    void build_edges(const GraphBuilder& b) {
+        const std::span<const NodeId> src = b.rows_.senders();
+        const std::span<const NodeId> dst = b.rows_.receivers();
+        const size_t T = src.size();
+        const size_t N = nodes_.size();
+
+        std::vector<uint32_t> order(T), tmp(T);
+        counting_sort(dst, nullptr, tmp, N);
+        counting_sort(src, &tmp, order, N);
+        std::vector<uint32_t>().swap(tmp);
+
+        for (size_t lo = 0, hi; lo < T; lo = hi) {
+            const uint32_t first = order[lo];
+            for (hi = lo + 1; hi < T && src[order[hi]] == src[first]
+                                     && dst[order[hi]] == dst[first]; ++hi) {}
+            if (hi - lo > 1)
+                std::stable_sort(order.begin() + lo, order.begin() + hi,
+                    [&](uint32_t a, uint32_t c) { return b.rows_.timestamp(a) < b.rows_.timestamp(c); });
         }
-    };
-
-    std::unordered_map<std::string, NodeAttr>                  nodes_;
-    std::vector<MultiEdge>                                      multi_edges_;
-    std::unordered_map<std::string, AggEdge>                   agg_edges_;  // key = "u→v"
-    std::unordered_map<std::string, std::unordered_set<std::string>> adj_;
-    std::unordered_map<std::string, std::unordered_set<std::string>> rev_adj_;
-    std::unordered_map<std::pair<std::string,std::string>,
-                       std::vector<TxnPair>, PairHash>         edge_txns_;
-    const std::vector<Transaction>* txns_ = nullptr;
-    mutable std::unordered_map<std::string, bool> business_cache_;  // id → is_business
-
-    static std::string edge_key(const std::string& u, const std::string& v) {
-        return u + "→" + v;
-    }
 
-    void ensure_node(const std::string& id) {
-        if (!nodes_.count(id)) {
-            nodes_[id] = NodeAttr{};
-        }
-    }
+        std::vector<NodeId>    edge_src, edge_dst;
+        std::vector<uint32_t>  txn_off;
+        std::vector<AggEdge>   agg_edges;
+        std::vector<double>    txn_amount(T);
+        std::vector<TimePoint> txn_ts(T);
+        for (size_t k = 0; k < T; ++k) {
+            const uint32_t i = order[k];
+            const double    amount = b.rows_.amount(i);
+            const TimePoint ts     = b.rows_.timestamp(i);
+            if (k == 0 || src[i] != edge_src.back() || dst[i] != edge_dst.back()) {
+                edge_src.push_back(src[i]);
+                edge_dst.push_back(dst[i]);
+                txn_off.push_back((uint32_t)k);
+                agg_edges.emplace_back();
+            }
+            txn_amount[k] = amount;
+            txn_ts[k]     = ts;
 
-    void update_time(NodeAttr& n, TimePoint tp) {
-        if (n.transaction_count <= 1) {
-            n.first_seen = tp;
-            n.last_seen  = tp;
-        } else {
-            if (tp < n.first_seen) n.first_seen = tp;
-            if (tp > n.last_seen)  n.last_seen  = tp;
+            auto& agg = agg_edges.back();
+            agg.total_amount      += amount;
+            agg.transaction_count += 1;
+            if (agg.transaction_count == 1) {
+                agg.earliest = ts;
+                agg.latest   = ts;
+            } else {
+                if (ts < agg.earliest) agg.earliest = ts;
+                if (ts > agg.latest)   agg.latest   = ts;
+            }
         }
+        txn_off.push_back((uint32_t)T);
+
+        edge_src_   = std::move(edge_src);
+        edge_dst_   = std::move(edge_dst);
+        txn_off_    = std::move(txn_off);
+        agg_edges_  = std::move(agg_edges);
+        txn_amount_ = std::move(txn_amount);
+        txn_ts_     = std::move(txn_ts);
     }
 
-    // Pre-populate business_cache_ for all nodes — called once per build
-    void build_business_cache() const {
-        if (business_cache_.size() == nodes_.size()) return;  // already warm
-        static const std::regex pat(
-            "(corp|inc|llc|ltd|co\\b|merchant|store|shop|pay|bank|services)",
-            std::regex::icase | std::regex::optimize);
-        for (const auto& [id, _] : nodes_) {
-            if (!business_cache_.count(id))
-                business_cache_[id] = std::regex_search(id, pat);
+    void build_csr() {
+        const size_t N = nodes_.size();
+        const size_t E = edge_src_.size();
+
+        // ── 2. Forward CSR (edges are already sorted by source) ────────
+        std::vector<uint32_t> out_off(N + 1, 0);
+        for (size_t e = 0; e < E; ++e) ++out_off[edge_src_[e] + 1];
+        for (size_t u = 0; u < N; ++u) out_off[u + 1] += out_off[u];
+
+        // ── 3. Reverse CSR (stable by target → rows sorted by source) ──
+        std::vector<EdgeId>   in_edge;
+        counting_sort(edge_dst_, nullptr, in_edge, N);
+        std::vector<uint32_t> in_off(N + 1, 0);
+        std::vector<NodeId>   in_src(E);
+        for (size_t k = 0; k < E; ++k) {
+            in_src[k] = edge_src_[in_edge[k]];
+            ++in_off[edge_dst_[in_edge[k]] + 1];
         }
-    }
+        for (size_t v = 0; v < N; ++v) in_off[v + 1] += in_off[v];
 
-    bool is_business_cached(const std::string& id) const {
-        auto it = business_cache_.find(id);
-        return it != business_cache_.end() && it->second;
+        out_off_ = std::move(out_off);
+        in_off_  = std::move(in_off);
+        in_src_  = std::move(in_src);
+        in_edge_ = std::move(in_edge);
     }
 
-    static bool looks_like_business(const std::string& id) {
-        static const std::regex pat(
-            "(corp|inc|llc|ltd|co\\b|merchant|store|shop|pay|bank|services)",
-            std::regex::icase | std::regex::optimize);
-        return std::regex_search(id, pat);
+    // Stable counting sort of indices by key[idx] (keys < buckets).
+    // Sorts 0..key.size()-1 when in == nullptr, else the permutation *in.
+    static void counting_sort(std::span<const NodeId> key,
+                              const std::vector<uint32_t>* in,
+                              std::vector<uint32_t>& out,
+                              size_t buckets) {
+        const size_t n = key.size();
+        std::vector<uint32_t> pos(buckets + 1, 0);
+        for (size_t i = 0; i < n; ++i) ++pos[key[i] + 1];
+        for (size_t b = 0; b < buckets; ++b) pos[b + 1] += pos[b];
+        out.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            uint32_t i = in ? (*in)[k] : (uint32_t)k;
+            out[pos[key[i]]++] = i;
+        }
     }
 };
 
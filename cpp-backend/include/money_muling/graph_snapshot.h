@@ -0,0 +1,401 @@
+#pragma once
+// ============================================================================
+// Graph Snapshot – a built TransactionGraph as a file that is mmap-ed and
+// used in place
+//
+// The file is the graph's own columns – name table, node attributes,
+// forward/reverse CSR, aggregated edges and the per-edge amount/timestamp
+// slices – each 64-byte aligned behind a fixed header.  open() maps it
+// read-only and points the graph's Columns straight at the mapping, so
+// re-running detectors with new thresholds skips CSV parsing and the
+// whole build; pages are read on first touch.
+//
+// The layout is native (endianness and struct sizes are recorded and
+// checked), so a snapshot is a cache for the machine that wrote it, not
+// an interchange format.  open() validates every offset and ID before
+// use, so a truncated or corrupt file is refused rather than read out of
+// bounds.
+//
+// SnapshotStore keeps one file per analysis under MM_SNAPSHOT_DIR.
+// ============================================================================
+
+#include "graph_engine.h"
+#include "models.h"
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace mm {
+
+// ─── Read-only file mapping ───────────────────────────────────────────────
+class MappedFile {
+public:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { if (data_) munmap(data_, size_); }
+
+    // nullptr if the file cannot be opened or mapped
+    static std::shared_ptr<const MappedFile> open(const std::string& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return nullptr;
+        const off_t size = lseek(fd, 0, SEEK_END);
+        void* data = size > 0 ? mmap(nullptr, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0)
+                              : MAP_FAILED;
+        ::close(fd);                               // the mapping keeps the file
+        if (data == MAP_FAILED) return nullptr;
+        return std::shared_ptr<const MappedFile>(new MappedFile(data, (size_t)size));
+    }
+
+    const unsigned char* data() const { return static_cast<const unsigned char*>(data_); }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(void* data, size_t size) : data_(data), size_(size) {}
+
+    void*  data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// ─── Snapshot format ──────────────────────────────────────────────────────
+class GraphSnapshot {
+public:
+    static constexpr char     MAGIC[8] = {'M', 'M', 'G', 'R', 'A', 'P', 'H', '\0'};
+    static constexpr uint32_t VERSION  = 1;
+    static constexpr size_t   ALIGN    = 64;
+
+    /**
+     * Write `graph` to `path` (via a temporary file and rename, so a
+     * reader never sees a partial snapshot).  On failure returns false
+     * and fills `error` if given.
+     */
+    static bool write(const TransactionGraph& g, const std::string& path,
+                      std::string* error = nullptr) {
+        Header h = header_for(g);
+        const std::vector<Bytes> sections = {
+            bytes(g.names_.offsets()), bytes(g.names_.chars()), bytes(g.names_.slots()),
+            bytes(g.nodes_),
+            bytes(g.out_off_), bytes(g.edge_src_), bytes(g.edge_dst_),
+            bytes(g.in_off_),  bytes(g.in_src_),   bytes(g.in_edge_),
+            bytes(g.agg_edges_),
+            bytes(g.txn_off_), bytes(g.txn_amount_), bytes(g.txn_ts_),
+        };
+        uint64_t offset = align(sizeof(Header));
+        for (size_t k = 0; k < SECTION_COUNT; ++k) {
+            h.sections[k] = {offset, sections[k].size};
+            offset = align(offset + sections[k].size);
+        }
+
+        const std::string tmp = path + ".tmp";
+        std::FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) return fail(error, "cannot create " + tmp);
+
+        static constexpr unsigned char zeros[ALIGN] = {};
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+        uint64_t at = sizeof(Header);
+        for (size_t k = 0; ok && k < SECTION_COUNT; ++k) {
+            ok = std::fwrite(zeros, 1, h.sections[k].offset - at, f) == h.sections[k].offset - at &&
+                 std::fwrite(sections[k].data, 1, sections[k].size, f) == sections[k].size;
+            at = h.sections[k].offset + sections[k].size;
+        }
+        ok = (std::fclose(f) == 0) && ok;
+
+        std::error_code ec;
+        if (ok) std::filesystem::rename(tmp, path, ec);
+        if (!ok || ec) {
+            std::filesystem::remove(tmp, ec);
+            return fail(error, "cannot write " + path);
+        }
+        return true;
+    }
+
+    /**
+     * Map `path` and return a graph viewing it.  std::nullopt (and
+     * `error`) if the file is missing, from another build, or corrupt.
+     */
+    static std::optional<TransactionGraph> open(const std::string& path,
+                                                std::string* error = nullptr) {
+        auto file = MappedFile::open(path);
+        if (!file) { fail(error, "snapshot not found"); return std::nullopt; }
+        if (file->size() < sizeof(Header)) { fail(error, "snapshot truncated"); return std::nullopt; }
+
+        Header h;
+        std::memcpy(&h, file->data(), sizeof(h));
+        const Header expect = header_for(TransactionGraph{});
+        if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION ||
+            h.endian != expect.endian ||
+            std::memcmp(h.layout, expect.layout, sizeof(h.layout)) != 0) {
+            fail(error, "not a snapshot of this build");
+            return std::nullopt;
+        }
+        if (h.nodes >= INVALID_NODE || h.edges >= INVALID_EDGE || h.txns > UINT32_MAX) {
+            fail(error, "snapshot corrupt");
+            return std::nullopt;
+        }
+
+        Mapper m{*file, h};
+        const size_t N = (size_t)h.nodes, E = (size_t)h.edges, T = (size_t)h.txns;
+        auto name_off  = m.column<uint32_t>(NAME_OFFSETS, N + 1);
+        auto name_char = m.column<char>(NAME_CHARS, m.count<char>(NAME_CHARS));
+        auto slots     = m.column<NodeId>(NAME_SLOTS, AccountNames::slot_capacity(N));
+
+        TransactionGraph g;
+        g.nodes_      = m.column<NodeAttr>(NODES, N);
+        g.out_off_    = m.column<uint32_t>(OUT_OFF, N + 1);
+        g.edge_src_   = m.column<NodeId>(EDGE_SRC, E);
+        g.edge_dst_   = m.column<NodeId>(EDGE_DST, E);
+        g.in_off_     = m.column<uint32_t>(IN_OFF, N + 1);
+        g.in_src_     = m.column<NodeId>(IN_SRC, E);
+        g.in_edge_    = m.column<EdgeId>(IN_EDGE, E);
+        g.agg_edges_  = m.column<AggEdge>(AGG_EDGES, E);
+        g.txn_off_    = m.column<uint32_t>(TXN_OFF, E + 1);
+        g.txn_amount_ = m.column<double>(TXN_AMOUNT, T);
+        g.txn_ts_     = m.column<TimePoint>(TXN_TS, T);
+
+        if (!m.ok ||
+            !offsets_ok(name_off, name_char.size()) ||
+            !offsets_ok(g.out_off_, E) || !offsets_ok(g.in_off_, E) ||
+            !offsets_ok(g.txn_off_, T) ||
+            !ids_below(g.edge_src_, N) || !ids_below(g.edge_dst_, N) ||
+            !ids_below(g.in_src_, N)   || !ids_below(g.in_edge_, E) ||
+            !slots_ok(slots, N) || !flags_ok(g.nodes_)) {
+            fail(error, "snapshot corrupt");
+            return std::nullopt;
+        }
+
+        g.names_   = AccountNames(std::move(name_off), std::move(name_char), std::move(slots));
+        g.backing_ = std::move(file);
+        return g;
+    }
+
+private:
+    enum Section : size_t {
+        NAME_OFFSETS, NAME_CHARS, NAME_SLOTS, NODES,
+        OUT_OFF, EDGE_SRC, EDGE_DST, IN_OFF, IN_SRC, IN_EDGE,
+        AGG_EDGES, TXN_OFF, TXN_AMOUNT, TXN_TS,
+        SECTION_COUNT
+    };
+
+    struct Extent { uint64_t offset, bytes; };
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t endian;             // 0x01020304 as written
+        uint32_t layout[4];          // sizeof NodeAttr / AggEdge / TimePoint, ticks per second
+        uint64_t nodes, edges, txns;
+        Extent   sections[SECTION_COUNT];
+    };
+
+    struct Bytes { const void* data; uint64_t size; };
+
+    template <class T>
+    static Bytes bytes(const Column<T>& c) { return {c.data(), c.size_bytes()}; }
+
+    static uint64_t align(uint64_t n) { return (n + ALIGN - 1) / ALIGN * ALIGN; }
+
+    static bool fail(std::string* error, std::string msg) {
+        if (error) *error = std::move(msg);
+        return false;
+    }
+
+    static Header header_for(const TransactionGraph& g) {
+        Header h{};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version   = VERSION;
+        h.endian    = 0x01020304u;
+        h.layout[0] = (uint32_t)sizeof(NodeAttr);
+        h.layout[1] = (uint32_t)sizeof(AggEdge);
+        h.layout[2] = (uint32_t)sizeof(TimePoint);
+        h.layout[3] = (uint32_t)TimePoint::period::den;
+        h.nodes     = g.node_count();
+        h.edges     = g.edge_count();
+        h.txns      = g.transaction_count();
+        return h;
+    }
+
+    // Bounds-checked views of the sections of one mapped file
+    struct Mapper {
+        const MappedFile& file;
+        const Header&     h;
+        bool              ok = true;
+
+        template <class T>
+        size_t count(Section s) const { return (size_t)(h.sections[s].bytes / sizeof(T)); }
+
+        template <class T>
+        Column<T> column(Section s, size_t n) {
+            const Extent& x = h.sections[s];
+            if (x.offset % ALIGN != 0 || x.offset > file.size() ||
+                x.bytes > file.size() - x.offset || x.bytes != (uint64_t)n * sizeof(T)) {
+                ok = false;
+                return {};
+            }
+            return Column<T>::view({reinterpret_cast<const T*>(file.data() + x.offset), n});
+        }
+    };
+
+    // off[0] == 0, non-decreasing, off.back() == total
+    static bool offsets_ok(std::span<const uint32_t> off, size_t total) {
+        if (off.empty() || off[0] != 0 || off.back() != total) return false;
+        for (size_t i = 1; i < off.size(); ++i)
+            if (off[i] < off[i - 1]) return false;
+        return true;
+    }
+
+    static bool ids_below(std::span<const uint32_t> ids, size_t n) {
+        for (uint32_t id : ids) if (id >= n) return false;
+        return true;
+    }
+
+    // Every node exactly once, the rest empty (so probing terminates)
+    static bool slots_ok(std::span<const NodeId> slots, size_t n) {
+        std::vector<uint8_t> seen(n, 0);
+        size_t filled = 0;
+        for (NodeId id : slots) {
+            if (id == INVALID_NODE) continue;
+            if (id >= n || seen[id]) return false;
+            seen[id] = 1;
+            ++filled;
+        }
+        return filled == n;
+    }
+
+    // bool members must hold 0 or 1
+    static bool flags_ok(std::span<const NodeAttr> nodes) {
+        for (const auto& a : nodes) {
+            unsigned char b;
+            std::memcpy(&b, &a.is_business, 1);
+            if (b > 1) return false;
+        }
+        return true;
+    }
+};
+
+// ─── Snapshot directory ───────────────────────────────────────────────────
+//
+// <dir>/<analysis_id>.mmg; disabled until configured with a directory.
+// Files older than the TTL are pruned (at most once a minute, on save).
+class SnapshotStore {
+public:
+    static constexpr std::chrono::seconds DEFAULT_TTL{86400};
+    static constexpr std::chrono::seconds PRUNE_INTERVAL{60};
+
+    static SnapshotStore& instance() {
+        static SnapshotStore inst;
+        return inst;
+    }
+
+    // Call before first use; an empty `dir` disables snapshots
+    void configure(const std::string& dir, std::chrono::seconds ttl = DEFAULT_TTL) {
+        dir_ = dir;
+        ttl_ = ttl;
+        if (!dir_.empty()) {
+            std::error_code ec;
+            std::filesystem::create_directories(dir_, ec);
+            if (ec) dir_.clear();
+        }
+    }
+
+    bool enabled() const { return !dir_.empty(); }
+
+    // Best effort: a failed write only means no re-analysis for this ID
+    bool save(const std::string& analysis_id, const TransactionGraph& graph) {
+        auto path = path_for(analysis_id);
+        if (!path) return false;
+        prune();
+        return GraphSnapshot::write(graph, *path);
+    }
+
+    bool exists(const std::string& analysis_id) const {
+        auto path = path_for(analysis_id);
+        std::error_code ec;
+        return path && std::filesystem::is_regular_file(*path, ec);
+    }
+
+    std::optional<TransactionGraph> open(const std::string& analysis_id,
+                                         std::string* error = nullptr) const {
+        auto path = path_for(analysis_id);
+        if (!path) {
+            if (error) *error = "snapshot not found";
+            return std::nullopt;
+        }
+        return GraphSnapshot::open(*path, error);
+    }
+
+    // Make `analysis_id` share `source_id`'s snapshot (a hard link, so
+    // re-analyses can themselves be re-analysed); refreshes its age
+    bool link(const std::string& analysis_id, const std::string& source_id) {
+        auto path = path_for(analysis_id), source = path_for(source_id);
+        if (!path || !source) return false;
+        std::error_code ec;
+        std::filesystem::create_hard_link(*source, *path, ec);
+        if (ec) return false;
+        std::filesystem::last_write_time(*path, std::filesystem::file_time_type::clock::now(), ec);
+        return true;
+    }
+
+    // Drop `analysis_id`'s snapshot (a link shared with other analyses
+    // keeps the graph for them)
+    bool remove(const std::string& analysis_id) {
+        auto path = path_for(analysis_id);
+        if (!path) return false;
+        std::error_code ec;
+        return std::filesystem::remove(*path, ec);
+    }
+
+private:
+    SnapshotStore() = default;
+
+    std::string           dir_;
+    std::chrono::seconds  ttl_ = DEFAULT_TTL;
+    std::mutex            prune_mtx_;
+    std::chrono::steady_clock::time_point last_prune_{};
+
+    // IDs come from URLs: only UUID characters, so no path can escape dir_
+    std::optional<std::string> path_for(const std::string& analysis_id) const {
+        if (dir_.empty() || analysis_id.empty() || analysis_id.size() > 64) return std::nullopt;
+        for (char c : analysis_id) {
+            const bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+                            (c >= 'A' && c <= 'F') || c == '-';
+            if (!ok) return std::nullopt;
+        }
+        return (std::filesystem::path(dir_) / (analysis_id + ".mmg")).string();
+    }
+
+    void prune() {
+        std::unique_lock<std::mutex> lock(prune_mtx_, std::try_to_lock);
+        if (!lock) return;                                  // someone else is pruning
+        const auto now = std::chrono::steady_clock::now();
+        if (last_prune_ != std::chrono::steady_clock::time_point{} &&
+            now - last_prune_ < PRUNE_INTERVAL)
+            return;
+        last_prune_ = now;
+
+        namespace fs = std::filesystem;
+        const auto cutoff = fs::file_time_type::clock::now() - ttl_;
+        std::error_code ec;
+        for (fs::directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code fec;
+            if (it->path().extension() != ".mmg") continue;
+            if (it->last_write_time(fec) < cutoff && !fec) fs::remove(it->path(), fec);
+        }
+    }
+};
+
+} // namespace mm
@@ -0,0 +1,166 @@
+#pragma once
+// ============================================================================
+// Account Interner – maps account ID strings to dense NodeId integers
+//
+// Each distinct account string is stored exactly once.  IDs are assigned
+// in first-seen order, so the same input always yields the same numbering.
+//
+// A built graph keeps the frozen AccountNames form instead: flat arrays
+// that a graph snapshot can map from disk and use as they are.
+// ============================================================================
+
+#include "column.h"
+#include "models.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mm {
+
+class AccountInterner {
+public:
+    AccountInterner() = default;
+    AccountInterner(AccountInterner&&) noexcept = default;
+    AccountInterner& operator=(AccountInterner&&) noexcept = default;
+
+    // names_ points into index_'s nodes, so a copy must re-point it
+    AccountInterner(const AccountInterner& o) : index_(o.index_) { relink(); }
+    AccountInterner& operator=(const AccountInterner& o) {
+        if (this != &o) { index_ = o.index_; relink(); }
+        return *this;
+    }
+
+    // Return the ID for s, assigning the next dense ID if it is new
+    NodeId intern(std::string_view s) {
+        auto it = index_.find(s);
+        if (it != index_.end()) return it->second;
+
+        NodeId id = (NodeId)names_.size();
+        auto [ins, _] = index_.emplace(std::string(s), id);
+        names_.push_back(&ins->first);  // map keys are node-stable
+        return id;
+    }
+
+    // Look up without inserting; INVALID_NODE if unknown
+    NodeId find(std::string_view s) const {
+        auto it = index_.find(s);
+        return it != index_.end() ? it->second : INVALID_NODE;
+    }
+
+    const std::string& name(NodeId id) const { return *names_[id]; }
+    size_t size() const { return names_.size(); }
+    bool empty()  const { return names_.empty(); }
+
+    void reserve(size_t n) {
+        index_.reserve(n);
+        names_.reserve(n);
+    }
+
+    void clear() {
+        index_.clear();
+        names_.clear();
+    }
+
+private:
+    // Transparent hash so string_view lookups don't allocate a key
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+
+    std::unordered_map<std::string, NodeId, Hash, std::equal_to<>> index_;
+    std::vector<const std::string*>                                names_;
+
+    void relink() {
+        names_.assign(index_.size(), nullptr);
+        for (const auto& [key, id] : index_) names_[id] = &key;
+    }
+};
+
+// ─── Frozen name table ────────────────────────────────────────────────────
+//
+// Every name in one char array (name i = chars[offsets[i], offsets[i+1])),
+// indexed by an open-addressing hash table of NodeIds (FNV-1a, linear
+// probing, at least half empty).  The hash is fixed rather than
+// std::hash so the table stays valid inside a snapshot file.
+class AccountNames {
+public:
+    AccountNames() = default;
+
+    explicit AccountNames(const AccountInterner& ids) {
+        const size_t n = ids.size();
+        size_t total = 0;
+        for (NodeId id = 0; id < (NodeId)n; ++id) total += ids.name(id).size();
+
+        std::vector<uint32_t> offsets(n + 1);
+        std::vector<char>     chars;
+        chars.reserve(total);
+        for (NodeId id = 0; id < (NodeId)n; ++id) {
+            offsets[id] = (uint32_t)chars.size();
+            chars.insert(chars.end(), ids.name(id).begin(), ids.name(id).end());
+        }
+        offsets[n] = (uint32_t)chars.size();
+
+        std::vector<NodeId> slots(slot_capacity(n), INVALID_NODE);
+        const size_t mask = slots.size() - 1;
+        for (NodeId id = 0; id < (NodeId)n; ++id) {
+            size_t i = hash(ids.name(id)) & mask;
+            while (slots[i] != INVALID_NODE) i = (i + 1) & mask;
+            slots[i] = id;
+        }
+
+        offsets_ = std::move(offsets);
+        chars_   = std::move(chars);
+        slots_   = std::move(slots);
+    }
+
+    // Adopt existing columns (a mapped snapshot, already validated)
+    AccountNames(Column<uint32_t> offsets, Column<char> chars, Column<NodeId> slots)
+        : offsets_(std::move(offsets)), chars_(std::move(chars)), slots_(std::move(slots)) {}
+
+    size_t size() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+
+    std::string_view name(NodeId id) const {
+        return {chars_.data() + offsets_[id], offsets_[id + 1] - offsets_[id]};
+    }
+
+    // INVALID_NODE if unknown
+    NodeId find(std::string_view s) const {
+        if (slots_.empty()) return INVALID_NODE;
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = hash(s) & mask;; i = (i + 1) & mask) {
+            const NodeId id = slots_[i];
+            if (id == INVALID_NODE || name(id) == s) return id;
+        }
+    }
+
+    const Column<uint32_t>& offsets() const { return offsets_; }
+    const Column<char>&     chars() const   { return chars_; }
+    const Column<NodeId>&   slots() const   { return slots_; }
+
+    static uint64_t hash(std::string_view s) {
+        uint64_t h = 1469598103934665603ull;             // FNV-1a 64
+        for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+        return h;
+    }
+
+    // Power of two, >= 2n
+    static size_t slot_capacity(size_t n) {
+        size_t cap = 16;
+        while (cap < 2 * n) cap <<= 1;
+        return cap;
+    }
+
+private:
+    Column<uint32_t> offsets_;   // N+1
+    Column<char>     chars_;
+    Column<NodeId>   slots_;
+};
+
+} // namespace mm
@@ -1,209 +1,265 @@
 #pragma once
 // ============================================================================
-// JSON Serializer – nlohmann/json serialisation for all model types
+// JSON Serializer – JSON serialisation for all model types
 //
 // Produces identical JSON output to Python Pydantic models so the
 // React frontend works unchanged.
+//
+// Everything is written through JsonWriter straight into one output
+// string – no nlohmann DOM is built.  The bytes are the same as the old
+// json{...}.dump() output, so members are written in the order dump()
+// used: sorted by key.
 // ============================================================================
 
 #include "models.h"
-#include <nlohmann/json.hpp>
+#include "json_writer.h"
 
-namespace mm {
+#include <cmath>
+#include <optional>
+#include <string>
 
-using json = nlohmann::json;
+namespace mm {
 
 // ── helpers ──────────────────────────────────────────────────────────────
 
-inline json summary_to_json(const Summary& s) {
-    return json{
-        {"total_accounts_analyzed",     s.total_accounts_analyzed},
-        {"suspicious_accounts_flagged", s.suspicious_accounts_flagged},
-        {"fraud_rings_detected",        s.fraud_rings_detected},
-        {"processing_time_seconds",     s.processing_time_seconds},
-        {"total_transactions",          s.total_transactions},
-        {"total_cycles",                s.total_cycles},
-        {"total_smurfing_patterns",     s.total_smurfing_patterns},
-        {"total_shell_patterns",        s.total_shell_patterns},
-        {"total_amount_at_risk",        s.total_amount_at_risk}
-    };
-}
-
-inline json cycle_to_json(const CycleResult& c) {
-    return json{
-        {"ring_id",          c.ring_id},
-        {"nodes",            c.nodes},
-        {"length",           c.length},
-        {"total_amount",     c.total_amount},
-        {"time_span_hours",  c.time_span_hours},
-        {"edge_count",       c.edge_count},
-        {"pattern_type",     "cycle"}
-    };
-}
-
-inline json smurfing_to_json(const SmurfingResult& s) {
-    return json{
-        {"account_id",           s.account_id},
-        {"pattern_type",         s.pattern_type},
-        {"unique_counterparties", s.unique_counterparties},
-        {"total_amount",         s.total_amount},
-        {"velocity_per_hour",    s.velocity_per_hour},
-        {"window_start",         s.window_start},
-        {"window_end",           s.window_end},
-        {"ring_id",              s.ring_id}
-    };
-}
-
-inline json shell_to_json(const ShellResult& s) {
-    return json{
-        {"ring_id",                s.ring_id},
-        {"pattern_type",           "shell"},
-        {"chain",                  s.chain},
-        {"intermediate_accounts",  s.intermediate_accounts},
-        {"total_amount",           s.total_amount},
-        {"shell_depth",            s.shell_depth},
-        {"risk_score",             s.risk_score}
-    };
-}
-
-inline json suspicious_account_to_json(const SuspiciousAccount& sa) {
-    return json{
-        {"account_id",         sa.account_id},
-        {"suspicion_score",    sa.suspicion_score},
-        {"detected_patterns",  sa.detected_patterns},
-        {"ring_id",            sa.ring_id},
-        {"account_type",       sa.account_type},
-        {"total_inflow",       sa.total_inflow},
-        {"total_outflow",      sa.total_outflow},
-        {"transaction_count",  sa.transaction_count},
-        {"connected_accounts", sa.connected_accounts},
-        {"ring_ids",           sa.ring_ids}
-    };
-}
-
-inline json fraud_ring_to_json(const FraudRing& fr) {
-    return json{
-        {"ring_id",          fr.ring_id},
-        {"member_accounts",  fr.member_accounts},
-        {"pattern_type",     fr.pattern_type},
-        {"risk_score",       fr.risk_score}
-    };
-}
-
-inline json graph_node_to_json(const GraphNode& n) {
-    return json{
-        {"id",                n.id},
-        {"label",             n.label},
-        {"account_type",      n.account_type},
-        {"suspicion_score",   n.suspicion_score},
-        {"total_inflow",      n.total_inflow},
-        {"total_outflow",     n.total_outflow},
-        {"transaction_count", n.transaction_count},
-        {"is_suspicious",     n.is_suspicious},
-        {"ring_ids",          n.ring_ids},
-        // detected_patterns: spec-format strings ("cycle_length_3", "high_velocity", etc.)
-        // patterns: raw strings ("cycle", "shell", etc.) kept for backward compat
-        {"detected_patterns", n.detected_patterns.empty() ? n.patterns : n.detected_patterns},
-        {"patterns",          n.patterns}
-    };
-}
-
-inline json graph_edge_to_json(const GraphEdge& e) {
-    return json{
-        {"source",            e.source},
-        {"target",            e.target},
-        {"amount",            e.total_amount},
-        {"transaction_count", e.transaction_count},
-        {"is_suspicious",     e.is_suspicious},
-        {"pattern_type",      e.pattern_type}
-    };
-}
-
-inline json graph_data_to_json(const GraphData& gd) {
-    json nodes_arr = json::array();
-    for (const auto& n : gd.nodes) nodes_arr.push_back(graph_node_to_json(n));
-
-    json edges_arr = json::array();
-    for (const auto& e : gd.edges) edges_arr.push_back(graph_edge_to_json(e));
-
-    return json{
-        {"nodes", nodes_arr},
-        {"edges", edges_arr}
-    };
+inline void write_summary(JsonWriter& w, const Summary& s) {
+    w.begin_object()
+     .field("fraud_rings_detected",        s.fraud_rings_detected)
+     .field("processing_time_seconds",     s.processing_time_seconds)
+     .field("suspicious_accounts_flagged", s.suspicious_accounts_flagged)
+     .field("total_accounts_analyzed",     s.total_accounts_analyzed)
+     .field("total_amount_at_risk",        s.total_amount_at_risk)
+     .field("total_cycles",                s.total_cycles)
+     .field("total_shell_patterns",        s.total_shell_patterns)
+     .field("total_smurfing_patterns",     s.total_smurfing_patterns)
+     .field("total_transactions",          s.total_transactions)
+     .end_object();
 }
 
-// ── Full analysis result (status polling endpoint) ───────────────────────
+inline void write_timings(JsonWriter& w, const Timings& t) {
+    w.begin_object()
+     .field("cycle_step_capped_roots", t.cycle_step_capped_roots)
+     .field("cycle_steps",             t.cycle_steps)
+     .field("cycle_temporal_rejects",  t.cycle_temporal_rejects)
+     .field("max_chains_reached",      t.max_chains_reached)
+     .field("max_cycles_reached",      t.max_cycles_reached)
+     .field("peak_rss_bytes",          t.peak_rss_bytes)
+     .field("shell_steps",             t.shell_steps);
+    // Pipeline order
+    w.key("stages").begin_array();
+    for (size_t s = 0; s < STAGE_COUNT; ++s)
+        w.begin_object()
+         .field("seconds", t.stage_seconds[s])
+         .field("stage",   stage_to_string((Stage)s))
+         .end_object();
+    w.end_array();
+    w.end_object();
+}
 
-inline json analysis_result_to_json(const AnalysisResult& r) {
-    json j;
-    j["analysis_id"]       = r.analysis_id;
-    j["status"]            = status_to_string(r.status);
+inline void write_cycle(JsonWriter& w, const CycleResult& c) {
+    w.begin_object()
+     .field("edge_count",       c.edge_count)
+     .field("length",           c.length)
+     .field("nodes",            c.nodes)
+     .field("pattern_type",     "cycle")
+     .field("ring_id",          c.ring_id)
+     .field("time_span_hours",  c.time_span_hours)
+     .field("total_amount",     c.total_amount)
+     .end_object();
+}
 
-    if (r.status == AnalysisStatus::COMPLETED) {
-        // Nest completed data under "result" for frontend AnalysisStatusResponse
-        json result_obj;
-        result_obj["summary"] = summary_to_json(r.summary);
+inline void write_smurfing(JsonWriter& w, const SmurfingResult& s) {
+    w.begin_object()
+     .field("account_id",            s.account_id)
+     .field("pattern_type",          s.pattern_type)
+     .field("ring_id",               s.ring_id)
+     .field("total_amount",          s.total_amount)
+     .field("unique_counterparties", s.unique_counterparties)
+     .field("velocity_per_hour",     s.velocity_per_hour)
+     .field("window_end",            s.window_end)
+     .field("window_start",          s.window_start)
+     .end_object();
+}
+
+inline void write_shell(JsonWriter& w, const ShellResult& s) {
+    w.begin_object()
+     .field("chain",                  s.chain)
+     .field("intermediate_accounts",  s.intermediate_accounts)
+     .field("pattern_type",           "shell")
+     .field("ring_id",                s.ring_id)
+     .field("risk_score",             s.risk_score)
+     .field("shell_depth",            s.shell_depth)
+     .field("total_amount",           s.total_amount)
+     .end_object();
+}
+
+inline void write_suspicious_account(JsonWriter& w, const SuspiciousAccount& sa) {
+    w.begin_object()
+     .field("account_id",         sa.account_id)
+     .field("account_type",       sa.account_type)
+     .field("connected_account_count", sa.connected_account_count)
+     .field("connected_accounts", sa.connected_accounts)
+     .field("detected_patterns",  sa.detected_patterns)
+     .field("ring_id",            sa.ring_id)
+     .field("ring_ids",           sa.ring_ids)
+     .field("suspicion_score",    sa.suspicion_score)
+     .field("total_inflow",       sa.total_inflow)
+     .field("total_outflow",      sa.total_outflow)
+     .field("transaction_count",  sa.transaction_count)
+     .end_object();
+}
+
+inline void write_fraud_ring(JsonWriter& w, const FraudRing& fr) {
+    w.begin_object()
+     .field("member_accounts",  fr.member_accounts)
+     .field("pattern_type",     fr.pattern_type)
+     .field("ring_id",          fr.ring_id)
+     .field("risk_score",       fr.risk_score)
+     .end_object();
+}
 
-        json sa_arr = json::array();
-        for (const auto& sa : r.suspicious_accounts)
-            sa_arr.push_back(suspicious_account_to_json(sa));
-        result_obj["suspicious_accounts"] = sa_arr;
+inline void write_graph_node(JsonWriter& w, const GraphNode& n) {
+    w.begin_object()
+     .field("account_type",      n.account_type)
+     // detected_patterns: spec-format strings ("cycle_length_3", "high_velocity", etc.)
+     // patterns: raw strings ("cycle", "shell", etc.) kept for backward compat
+     .field("detected_patterns", n.detected_patterns.empty() ? n.patterns : n.detected_patterns)
+     .field("id",                n.id)
+     .field("is_suspicious",     n.is_suspicious)
+     .field("label",             n.label)
+     .field("patterns",          n.patterns)
+     .field("ring_ids",          n.ring_ids)
+     .field("suspicion_score",   n.suspicion_score)
+     .field("total_inflow",      n.total_inflow)
+     .field("total_outflow",     n.total_outflow)
+     .field("transaction_count", n.transaction_count)
+     .end_object();
+}
 
-        json fr_arr = json::array();
-        for (const auto& fr : r.fraud_rings)
-            fr_arr.push_back(fraud_ring_to_json(fr));
-        result_obj["fraud_rings"] = fr_arr;
+inline void write_graph_edge(JsonWriter& w, const GraphEdge& e) {
+    w.begin_object()
+     .field("amount",            e.total_amount)
+     .field("is_suspicious",     e.is_suspicious)
+     .field("pattern_type",      e.pattern_type)
+     .field("source",            e.source)
+     .field("target",            e.target)
+     .field("transaction_count", e.transaction_count)
+     .end_object();
+}
 
-        j["result"] = result_obj;
+inline void write_graph_data(JsonWriter& w, const GraphData& gd) {
+    w.begin_object();
+    w.key("edges").begin_array();
+    for (const auto& e : gd.edges) write_graph_edge(w, e);
+    w.end_array();
+    w.key("nodes").begin_array();
+    for (const auto& n : gd.nodes) write_graph_node(w, n);
+    w.end_array();
+    w.end_object();
+}
 
-    } else if (r.status == AnalysisStatus::FAILED) {
-        j["error"] = r.error;
+// ── Full analysis result (status polling endpoint) ───────────────────────
+
+// `status` overrides r.status (the store tracks status beside the payload);
+// `queue_position` is reported for analyses still waiting to run, and
+// `progress` (0..1, also tracked by the store) for unfinished ones
+inline void write_analysis_result(JsonWriter& w, const AnalysisResult& r,
+                                  AnalysisStatus status,
+                                  std::optional<size_t> queue_position = std::nullopt,
+                                  double progress = 0.0) {
+    w.begin_object();
+    w.field("analysis_id", r.analysis_id);
+
+    if (status == AnalysisStatus::COMPLETED) {
+        // Nest completed data under "result" for frontend AnalysisStatusResponse
+        w.key("result").begin_object();
+        w.key("fraud_rings").begin_array();
+        for (const auto& fr : r.fraud_rings) write_fraud_ring(w, fr);
+        w.end_array();
+        w.key("summary");
+        write_summary(w, r.summary);
+        w.key("suspicious_accounts").begin_array();
+        for (const auto& sa : r.suspicious_accounts) write_suspicious_account(w, sa);
+        w.end_array();
+        w.key("timings");
+        write_timings(w, r.timings);
+        w.field("truncated", r.truncated);
+        w.end_object();
+
+    } else if (status == AnalysisStatus::FAILED) {
+        w.field("error", r.error);
 
     } else {
         // PENDING / PROCESSING – minimal
-        j["result"] = nullptr;
+        w.field("progress", progress);
+        if (queue_position) w.field("queue_position", *queue_position);
+        w.field("result", nullptr);
     }
 
-    return j;
+    w.field("status", status_to_string(status));
+    w.end_object();
 }
 
-// ── Spec-compliant download JSON ─────────────────────────────────────────
-// Only includes spec-mandated fields for line-by-line test matching.
+inline std::string analysis_result_json(const AnalysisResult& r, AnalysisStatus status,
+                                        std::optional<size_t> queue_position = std::nullopt,
+                                        double progress = 0.0) {
+    std::string out;
+    JsonWriter w(out);
+    write_analysis_result(w, r, status, queue_position, progress);
+    return out;
+}
 
-inline json download_suspicious_account_to_json(const SuspiciousAccount& sa) {
-    return json{
-        {"account_id",        sa.account_id},
-        {"suspicion_score",   sa.suspicion_score},
-        {"detected_patterns", sa.detected_patterns},
-        {"ring_id",           sa.ring_id}
-    };
+inline std::string analysis_result_json(const AnalysisResult& r) {
+    return analysis_result_json(r, r.status);
 }
 
-inline json download_summary_to_json(const Summary& s) {
-    return json{
-        {"total_accounts_analyzed",     s.total_accounts_analyzed},
-        {"suspicious_accounts_flagged", s.suspicious_accounts_flagged},
-        {"fraud_rings_detected",        s.fraud_rings_detected},
-        {"processing_time_seconds",     std::round(s.processing_time_seconds * 1000.0) / 1000.0}
-    };
+inline std::string graph_data_json(const GraphData& gd) {
+    std::string out;
+    JsonWriter w(out);
+    write_graph_data(w, gd);
+    return out;
 }
 
-inline json download_result_to_json(const AnalysisResult& r) {
-    json j;
+// ── Spec-compliant download JSON ─────────────────────────────────────────
+// Only includes spec-mandated fields for line-by-line test matching.
 
-    json sa_arr = json::array();
-    for (const auto& sa : r.suspicious_accounts)
-        sa_arr.push_back(download_suspicious_account_to_json(sa));
-    j["suspicious_accounts"] = sa_arr;
+inline void write_download_suspicious_account(JsonWriter& w, const SuspiciousAccount& sa) {
+    w.begin_object()
+     .field("account_id",        sa.account_id)
+     .field("detected_patterns", sa.detected_patterns)
+     .field("ring_id",           sa.ring_id)
+     .field("suspicion_score",   sa.suspicion_score)
+     .end_object();
+}
 
-    json fr_arr = json::array();
-    for (const auto& fr : r.fraud_rings)
-        fr_arr.push_back(fraud_ring_to_json(fr));
-    j["fraud_rings"] = fr_arr;
+inline void write_download_summary(JsonWriter& w, const Summary& s) {
+    w.begin_object()
+     .field("fraud_rings_detected",        s.fraud_rings_detected)
+     .field("processing_time_seconds",     std::round(s.processing_time_seconds * 1000.0) / 1000.0)
+     .field("suspicious_accounts_flagged", s.suspicious_accounts_flagged)
+     .field("total_accounts_analyzed",     s.total_accounts_analyzed)
+     .end_object();
+}
 
-    j["summary"] = download_summary_to_json(r.summary);
+inline void write_download_result(JsonWriter& w, const AnalysisResult& r) {
+    w.begin_object();
+    w.key("fraud_rings").begin_array();
+    for (const auto& fr : r.fraud_rings) write_fraud_ring(w, fr);
+    w.end_array();
+    w.key("summary");
+    write_download_summary(w, r.summary);
+    w.key("suspicious_accounts").begin_array();
+    for (const auto& sa : r.suspicious_accounts) write_download_suspicious_account(w, sa);
+    w.end_array();
+    w.end_object();
+}
 
-    return j;
+// Pretty-printed (indent 2), as served for download
+inline std::string download_result_json(const AnalysisResult& r) {
+    std::string out;
+    JsonWriter w(out, 2);
+    write_download_result(w, r);
+    return out;
 }
 
 } // namespace mm
@@ -0,0 +1,203 @@
+#pragma once
+// ============================================================================
+// JSON Writer – streaming JSON straight into a caller-owned buffer
+//
+// Writes exactly what nlohmann::json::dump() / dump(indent) would for the
+// same document, with no intermediate DOM:
+//   • doubles go through nlohmann's own Grisu2 to_chars (shortest round-
+//     trip digits, "1.0" for integral values), non-finite ones as null
+//   • strings are escaped like dump() with ensure_ascii = false; invalid
+//     UTF-8 is replaced by U+FFFD instead of throwing
+//   • pretty output puts each member on its own line, "key": value, and
+//     "{}" / "[]" for empty containers
+// Callers must emit object keys in sorted order – dump() sorts them.
+// Bodies are built whole; chunked transfer of a body still being
+// written is out of scope.  That covers the cached poll / graph /
+// download bodies (see ResponseBodies) and also the on-demand ones,
+// ResultIndex::accounts_json / graph_json / neighbours_json.  Those
+// filter a stored result, so they are never larger than the cached
+// bodies, and the server's send_body() needs the finished body for its
+// ETag and gzip variant before any byte goes out.
+// ============================================================================
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mm {
+
+class JsonWriter {
+public:
+    // indent < 0: compact, like dump(); otherwise like dump(indent)
+    explicit JsonWriter(std::string& out, int indent = -1) : out_(out), indent_(indent) {}
+
+    // ── Containers ─────────────────────────────────────────────────────
+    JsonWriter& begin_object() { before_value(); open('{'); return *this; }
+    JsonWriter& end_object()   { close('}'); return *this; }
+    JsonWriter& begin_array()  { before_value(); open('['); return *this; }
+    JsonWriter& end_array()    { close(']'); return *this; }
+
+    // Object member name; the next call writes its value
+    JsonWriter& key(std::string_view k) {
+        separate();
+        write_string(k);
+        out_ += indent_ < 0 ? ":" : ": ";
+        after_key_ = true;
+        return *this;
+    }
+
+    // ── Scalars ────────────────────────────────────────────────────────
+    JsonWriter& value(std::string_view s)  { before_value(); write_string(s); return *this; }
+    JsonWriter& value(const char* s)       { return value(std::string_view(s)); }
+    JsonWriter& value(const std::string& s){ return value(std::string_view(s)); }
+    JsonWriter& value(bool b)              { before_value(); out_ += b ? "true" : "false"; return *this; }
+    JsonWriter& value(std::nullptr_t)      { before_value(); out_ += "null"; return *this; }
+
+    JsonWriter& value(double d) {
+        before_value();
+        if (!std::isfinite(d)) {
+            out_ += "null";
+        } else {
+            std::array<char, 64> buf;
+            char* end = nlohmann::detail::to_chars(buf.data(), buf.data() + buf.size(), d);
+            out_.append(buf.data(), end);
+        }
+        return *this;
+    }
+
+    JsonWriter& value(int64_t i) {
+        before_value();
+        char buf[24];
+        char* p = buf + sizeof(buf);
+        uint64_t u = i < 0 ? 0 - (uint64_t)i : (uint64_t)i;
+        do { *--p = char('0' + u % 10); u /= 10; } while (u);
+        if (i < 0) *--p = '-';
+        out_.append(p, buf + sizeof(buf));
+        return *this;
+    }
+    JsonWriter& value(int i)    { return value((int64_t)i); }
+    JsonWriter& value(size_t i) { return value((int64_t)i); }
+
+    JsonWriter& value(const std::vector<std::string>& v) {
+        begin_array();
+        for (const auto& s : v) value(std::string_view(s));
+        return end_array();
+    }
+
+    // key(k).value(v)
+    template <class T>
+    JsonWriter& field(std::string_view k, const T& v) { key(k); return value(v); }
+
+private:
+    std::string&      out_;
+    int               indent_;
+    std::vector<bool> has_items_;      // per open container
+    bool              after_key_ = false;
+
+    void newline_indent(size_t depth) {
+        out_ += '\n';
+        out_.append(depth * (size_t)indent_, ' ');
+    }
+
+    // Separator + indentation before a member / element
+    void separate() {
+        if (has_items_.empty()) return;
+        if (has_items_.back()) out_ += ',';
+        has_items_.back() = true;
+        if (indent_ >= 0) newline_indent(has_items_.size());
+    }
+
+    void before_value() {
+        if (after_key_) { after_key_ = false; return; }
+        separate();
+    }
+
+    void open(char c) {
+        out_ += c;
+        has_items_.push_back(false);
+    }
+
+    void close(char c) {
+        const bool items = has_items_.back();
+        has_items_.pop_back();
+        if (items && indent_ >= 0) newline_indent(has_items_.size());
+        out_ += c;
+    }
+
+    // ── Strings ────────────────────────────────────────────────────────
+    static bool plain(unsigned char c) {
+        return c >= 0x20 && c != '"' && c != '\\' && c < 0x80;
+    }
+
+    void write_string(std::string_view s) {
+        out_ += '"';
+        size_t i = 0;
+        while (i < s.size()) {
+            size_t j = i;
+            while (j < s.size() && plain((unsigned char)s[j])) ++j;
+            out_.append(s.data() + i, j - i);
+            if (j == s.size()) break;
+            i = escape_one(s, j);
+        }
+        out_ += '"';
+    }
+
+    // Escape / validate the character at s[i]; returns the next index
+    size_t escape_one(std::string_view s, size_t i) {
+        const unsigned char c = (unsigned char)s[i];
+        switch (c) {
+            case '\b': out_ += "\\b";  return i + 1;
+            case '\t': out_ += "\\t";  return i + 1;
+            case '\n': out_ += "\\n";  return i + 1;
+            case '\f': out_ += "\\f";  return i + 1;
+            case '\r': out_ += "\\r";  return i + 1;
+            case '"':  out_ += "\\\""; return i + 1;
+            case '\\': out_ += "\\\\"; return i + 1;
+            default: break;
+        }
+        if (c < 0x20) {
+            static constexpr char hex[] = "0123456789abcdef";
+            const char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+            out_.append(u, 6);
+            return i + 1;
+        }
+        const size_t n = utf8_length(s, i);
+        if (n == 0) {
+            out_ += "\xEF\xBF\xBD";           // U+FFFD
+            return i + 1;
+        }
+        out_.append(s.data() + i, n);
+        return i + n;
+    }
+
+    // Length of the well-formed UTF-8 sequence at s[i] (lead byte >= 0x80),
+    // or 0 if it is malformed (overlong, surrogate, > U+10FFFF, truncated)
+    static size_t utf8_length(std::string_view s, size_t i) {
+        const unsigned char c = (unsigned char)s[i];
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xBF;     // bounds for the 2nd byte
+        if (c >= 0xC2 && c <= 0xDF)      n = 2;
+        else if (c == 0xE0)              { n = 3; lo = 0xA0; }
+        else if (c >= 0xE1 && c <= 0xEC) n = 3;
+        else if (c == 0xED)              { n = 3; hi = 0x9F; }
+        else if (c >= 0xEE && c <= 0xEF) n = 3;
+        else if (c == 0xF0)              { n = 4; lo = 0x90; }
+        else if (c >= 0xF1 && c <= 0xF3) n = 4;
+        else if (c == 0xF4)              { n = 4; hi = 0x8F; }
+        else return 0;
+        if (i + n > s.size()) return 0;
+        const unsigned char c1 = (unsigned char)s[i + 1];
+        if (c1 < lo || c1 > hi) return 0;
+        for (size_t k = 2; k < n; ++k)
+            if (((unsigned char)s[i + k] & 0xC0) != 0x80) return 0;
+        return n;
+    }
+};
+
+} // namespace mm
@@ -0,0 +1,103 @@
+#pragma once
+// ============================================================================
+// Kernels – reductions over contiguous numeric columns
+//
+// Each kernel keeps LANES independent accumulators and combines them in a
+// fixed order at the end.  The loop bodies have no cross-lane dependence,
+// so the compiler maps them straight onto SIMD registers (the Release
+// build uses -O3 -march=native), yet the result is bit-identical on every
+// ISA and vector width – no -ffast-math reassociation involved.
+// ============================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+namespace mm::kernels {
+
+inline constexpr size_t LANES = 4;
+
+struct SumSq {
+    double sum    = 0.0;
+    double sum_sq = 0.0;
+};
+
+// Σx
+inline double sum(std::span<const double> x) {
+    double acc[LANES] = {};
+    const size_t n = x.size(), body = n - n % LANES;
+    for (size_t i = 0; i < body; i += LANES)
+        for (size_t l = 0; l < LANES; ++l) acc[l] += x[i + l];
+    for (size_t i = body; i < n; ++i) acc[i - body] += x[i];
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+// Σx and Σx² in one pass
+inline SumSq sum_sq(std::span<const double> x) {
+    double s[LANES] = {}, q[LANES] = {};
+    const size_t n = x.size(), body = n - n % LANES;
+    for (size_t i = 0; i < body; i += LANES)
+        for (size_t l = 0; l < LANES; ++l) { s[l] += x[i + l]; q[l] += x[i + l] * x[i + l]; }
+    for (size_t i = body; i < n; ++i) { s[i - body] += x[i]; q[i - body] += x[i] * x[i]; }
+    return {(s[0] + s[1]) + (s[2] + s[3]), (q[0] + q[1]) + (q[2] + q[3])};
+}
+
+// max(x), or `init` for an empty column
+inline double max(std::span<const double> x, double init = 0.0) {
+    double acc[LANES] = {init, init, init, init};
+    const size_t n = x.size(), body = n - n % LANES;
+    for (size_t i = 0; i < body; i += LANES)
+        for (size_t l = 0; l < LANES; ++l) acc[l] = std::max(acc[l], x[i + l]);
+    for (size_t i = body; i < n; ++i) acc[0] = std::max(acc[0], x[i]);
+    return std::max(std::max(acc[0], acc[1]), std::max(acc[2], acc[3]));
+}
+
+// #{ i : x[i] > threshold }
+inline size_t count_greater(std::span<const double> x, double threshold) {
+    size_t acc[LANES] = {};
+    const size_t n = x.size(), body = n - n % LANES;
+    for (size_t i = 0; i < body; i += LANES)
+        for (size_t l = 0; l < LANES; ++l) acc[l] += x[i + l] > threshold;
+    for (size_t i = body; i < n; ++i) acc[0] += x[i] > threshold;
+    return acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+/**
+ * #{ i : x[i] ends in .00 / .99 / .95 / .49 / .50 } (pricing amounts).
+ * Works on whole cents: c = round(100·x), cents = c − 100·trunc(c / 100),
+ * which equals fmod(c, 100) for every amount a double holds to the cent.
+ */
+inline size_t count_round_cents(std::span<const double> x) {
+    auto is_round = [](double v) -> size_t {
+        const double c     = std::round(v * 100.0);
+        const double cents = c - 100.0 * std::trunc(c / 100.0);
+        return (cents == 0.0) | (cents == 99.0) | (cents == 95.0)
+             | (cents == 49.0) | (cents == 50.0);
+    };
+    size_t acc[LANES] = {};
+    const size_t n = x.size(), body = n - n % LANES;
+    for (size_t i = 0; i < body; i += LANES)
+        for (size_t l = 0; l < LANES; ++l) acc[l] += is_round(x[i + l]);
+    for (size_t i = body; i < n; ++i) acc[0] += is_round(x[i]);
+    return acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+// Element-wise min / max of any ordered trivially-copyable column
+template <class T>
+inline void min_max(std::span<const T> x, T& lo, T& hi) {
+    T mn[LANES] = {lo, lo, lo, lo}, mx[LANES] = {hi, hi, hi, hi};
+    const size_t n = x.size(), body = n - n % LANES;
+    for (size_t i = 0; i < body; i += LANES)
+        for (size_t l = 0; l < LANES; ++l) {
+            mn[l] = std::min(mn[l], x[i + l]);
+            mx[l] = std::max(mx[l], x[i + l]);
+        }
+    for (size_t i = body; i < n; ++i) { mn[0] = std::min(mn[0], x[i]); mx[0] = std::max(mx[0], x[i]); }
+    lo = std::min(std::min(mn[0], mn[1]), std::min(mn[2], mn[3]));
+    hi = std::max(std::max(mx[0], mx[1]), std::max(mx[2], mx[3]));
+}
+
+} // namespace mm::kernels
@@ -0,0 +1,210 @@
+#pragma once
+// ============================================================================
+// Metrics – stage timers and the process-wide Prometheus aggregate
+//
+// Each analysis records its own Timings (models.h) as it runs: ScopedStage
+// adds the wall time of a block to one stage, and the detectors report
+// their search counters.  When a finished result is stored, Metrics folds
+// its Timings into running totals (plus the time spent serialising its
+// bodies), and /metrics renders those totals in the Prometheus text
+// format together with gauges the caller supplies (queue depth, store
+// size …).  Totals are relaxed atomics: a scrape may see one analysis
+// half-added, never a torn value.
+// ============================================================================
+
+#include "models.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace mm {
+
+// Peak resident set size of this process so far (0 where unsupported)
+inline uint64_t peak_rss_bytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage ru{};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+    return (uint64_t)ru.ru_maxrss;                 // bytes
+#else
+    return (uint64_t)ru.ru_maxrss * 1024;          // KiB
+#endif
+#else
+    return 0;
+#endif
+}
+
+// Adds the wall time of its scope to timings[stage]
+class ScopedStage {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    ScopedStage(Timings& timings, Stage stage)
+        : timings_(timings), stage_(stage), start_(Clock::now()) {}
+    ~ScopedStage() {
+        timings_[stage_] += std::chrono::duration<double>(Clock::now() - start_).count();
+    }
+
+    ScopedStage(const ScopedStage&) = delete;
+    ScopedStage& operator=(const ScopedStage&) = delete;
+
+private:
+    Timings&          timings_;
+    Stage             stage_;
+    Clock::time_point start_;
+};
+
+class Metrics {
+public:
+    // Upper bounds (seconds) of the analysis duration histogram
+    static constexpr std::array<double, 10> DURATION_BUCKETS = {
+        0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60,
+    };
+
+    // A point-in-time value rendered next to the totals
+    struct Gauge {
+        const char* name;
+        const char* help;
+        double      value;
+    };
+
+    static Metrics& instance() {
+        static Metrics m;
+        return m;
+    }
+
+    // Fold in a finished result; `serialize_seconds` = building its bodies
+    void record(const AnalysisResult& r, double serialize_seconds) {
+        if (r.status == AnalysisStatus::FAILED) {
+            add(failed_, 1);
+            return;
+        }
+        add(completed_, 1);
+        add(truncated_, r.truncated ? 1 : 0);
+        const Timings& t = r.timings;
+        for (size_t s = 0; s < STAGE_COUNT; ++s) add(stage_ns_[s], nanos(t.stage_seconds[s]));
+        add(serialize_ns_, nanos(serialize_seconds));
+        add(cycle_steps_, t.cycle_steps);
+        add(cycle_temporal_rejects_, t.cycle_temporal_rejects);
+        add(cycle_step_capped_roots_, t.cycle_step_capped_roots);
+        add(max_cycles_reached_, t.max_cycles_reached ? 1 : 0);
+        add(shell_steps_, t.shell_steps);
+        add(max_chains_reached_, t.max_chains_reached ? 1 : 0);
+        add(transactions_, (uint64_t)r.summary.total_transactions);
+
+        const double secs = r.summary.processing_time_seconds;
+        size_t b = 0;
+        while (b < DURATION_BUCKETS.size() && secs > DURATION_BUCKETS[b]) ++b;
+        add(duration_buckets_[b], 1);
+        add(duration_ns_, nanos(secs));
+    }
+
+    // An analysis stopped by DELETE before it finished (never stored)
+    void record_cancelled() { add(cancelled_, 1); }
+
+    // Prometheus text exposition (format 0.0.4)
+    std::string render(std::span<const Gauge> gauges) const {
+        std::string out;
+        header(out, "mm_analyses_total", "Finished analyses by status.", "counter");
+        line(out, "mm_analyses_total{status=\"completed\"}", (double)load(completed_));
+        line(out, "mm_analyses_total{status=\"failed\"}", (double)load(failed_));
+        line(out, "mm_analyses_total{status=\"cancelled\"}", (double)load(cancelled_));
+        counter(out, "mm_truncated_analyses_total",
+                "Completed analyses whose detection was cut short by the deadline.", truncated_);
+
+        header(out, "mm_stage_seconds_total",
+               "Wall time spent per pipeline stage by completed analyses.", "counter");
+        for (size_t s = 0; s < STAGE_COUNT; ++s)
+            line(out, std::string("mm_stage_seconds_total{stage=\"") +
+                      stage_to_string((Stage)s) + "\"}", seconds(stage_ns_[s]));
+        line(out, "mm_stage_seconds_total{stage=\"serialize\"}", seconds(serialize_ns_));
+
+        header(out, "mm_analysis_duration_seconds",
+               "Processing time of completed analyses.", "histogram");
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b < DURATION_BUCKETS.size(); ++b) {
+            cumulative += load(duration_buckets_[b]);
+            char le[32];
+            std::snprintf(le, sizeof(le), "%g", DURATION_BUCKETS[b]);
+            line(out, std::string("mm_analysis_duration_seconds_bucket{le=\"") + le + "\"}",
+                 (double)cumulative);
+        }
+        cumulative += load(duration_buckets_[DURATION_BUCKETS.size()]);
+        line(out, "mm_analysis_duration_seconds_bucket{le=\"+Inf\"}", (double)cumulative);
+        line(out, "mm_analysis_duration_seconds_sum", seconds(duration_ns_));
+        line(out, "mm_analysis_duration_seconds_count", (double)cumulative);
+
+        counter(out, "mm_transactions_total", "Transactions in completed analyses.",
+                transactions_);
+        counter(out, "mm_cycle_search_steps_total", "Successor visits in the cycle DFS.",
+                cycle_steps_);
+        counter(out, "mm_cycle_temporal_rejects_total",
+                "Cycle extensions dropped by the time-window check.", cycle_temporal_rejects_);
+        counter(out, "mm_cycle_step_capped_roots_total",
+                "Cycle roots whose search hit max_steps_per_root.", cycle_step_capped_roots_);
+        counter(out, "mm_max_cycles_reached_total",
+                "Analyses whose cycle list was cut at max_cycles.", max_cycles_reached_);
+        counter(out, "mm_shell_search_steps_total", "Successor visits in the shell DFS.",
+                shell_steps_);
+        counter(out, "mm_max_chains_reached_total",
+                "Analyses whose shell chain list was cut at max_chains.", max_chains_reached_);
+
+        header(out, "mm_process_peak_rss_bytes", "Peak resident set size.", "gauge");
+        line(out, "mm_process_peak_rss_bytes", (double)peak_rss_bytes());
+        for (const auto& g : gauges) {
+            header(out, g.name, g.help, "gauge");
+            line(out, g.name, g.value);
+        }
+        return out;
+    }
+
+private:
+    using Counter = std::atomic<uint64_t>;
+
+    Counter completed_{0}, failed_{0}, cancelled_{0}, truncated_{0};
+    std::array<Counter, STAGE_COUNT> stage_ns_{};
+    Counter serialize_ns_{0};
+    std::array<Counter, DURATION_BUCKETS.size() + 1> duration_buckets_{};   // + overflow
+    Counter duration_ns_{0};
+    Counter transactions_{0};
+    Counter cycle_steps_{0}, cycle_temporal_rejects_{0}, cycle_step_capped_roots_{0};
+    Counter max_cycles_reached_{0};
+    Counter shell_steps_{0}, max_chains_reached_{0};
+
+    Metrics() = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    static void     add(Counter& c, uint64_t v) { c.fetch_add(v, std::memory_order_relaxed); }
+    static uint64_t load(const Counter& c)      { return c.load(std::memory_order_relaxed); }
+    static uint64_t nanos(double s)             { return s > 0 ? (uint64_t)(s * 1e9) : 0; }
+    static double   seconds(const Counter& c)   { return (double)load(c) / 1e9; }
+
+    static void header(std::string& out, const char* name, const char* help, const char* type) {
+        out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+        out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+    }
+
+    static void line(std::string& out, const std::string& series, double value) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.15g", value);
+        out += series; out += ' '; out += buf; out += '\n';
+    }
+
+    static void counter(std::string& out, const char* name, const char* help, const Counter& c) {
+        header(out, name, help, "counter");
+        line(out, name, (double)load(c));
+    }
+};
+
+} // namespace mm
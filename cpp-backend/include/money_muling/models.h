@@ -4,8 +4,12 @@
 // Mirrors the Python Pydantic models exactly for API compatibility.
 // ============================================================================
 
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -16,6 +20,16 @@ namespace mm {
 // ─── Time helpers ───────────────────────────────────────────────────────────
 using TimePoint = std::chrono::system_clock::time_point;
 
+// ─── Interned identifiers ───────────────────────────────────────────────────
+// Account IDs are mapped to dense integers once, as rows are parsed (see
+// interner.h, transaction_table.h); detectors, profiles, scores and the
+// DetectionIndex work on these, and strings are only resolved for the
+// output structs.
+using NodeId = std::uint32_t;
+using EdgeId = std::uint32_t;
+inline constexpr NodeId INVALID_NODE = std::numeric_limits<NodeId>::max();
+inline constexpr EdgeId INVALID_EDGE = std::numeric_limits<EdgeId>::max();
+
 // ─── Enums ──────────────────────────────────────────────────────────────────
 enum class AnalysisStatus { PENDING, PROCESSING, COMPLETED, FAILED };
 
@@ -41,15 +55,6 @@ inline const char* pattern_to_string(PatternType p) {
     return "unknown";
 }
 
-// ─── Transaction (single CSV row) ──────────────────────────────────────────
-struct Transaction {
-    std::string transaction_id;
-    std::string sender;
-    std::string receiver;
-    double      amount    = 0.0;
-    TimePoint   timestamp{};
-};
-
 // ─── Account Profile ────────────────────────────────────────────────────────
 struct AccountProfile {
     std::string account_id;
@@ -65,6 +70,36 @@ struct AccountProfile {
     TimePoint last_seen{};
 };
 
+// ─── Detector output ───────────────────────────────────────────────────────
+// What the detectors return and AnalysisSession caches: accounts as
+// NodeIds of the analysed graph, amounts already rounded to cents.  Rings
+// get their RING_NNN id and names only in AnalysisEngine::assemble, which
+// turns these into the *Result structs below.
+struct DetectedCycle {
+    std::vector<NodeId> nodes;             // in cycle order
+    double              total_amount    = 0.0;
+    double              time_span_hours = 0.0;
+
+    int length() const { return (int)nodes.size(); }
+};
+
+struct DetectedSmurfing {
+    NodeId      account               = INVALID_NODE;
+    PatternType pattern               = PatternType::FAN_IN;   // FAN_IN or FAN_OUT
+    int         unique_counterparties = 0;
+    double      total_amount          = 0.0;
+    double      velocity_per_hour     = 0.0;
+    TimePoint   window_start{};
+    TimePoint   window_end{};
+};
+
+struct DetectedShell {
+    std::vector<NodeId> chain;             // source, intermediates…, sink
+    double              total_amount = 0.0;
+
+    int shell_depth() const { return (int)chain.size() - 2; }
+};
+
 // ─── Cycle Detection Result ────────────────────────────────────────────────
 struct CycleResult {
     std::string              ring_id;
@@ -85,7 +120,7 @@ struct SmurfingResult {
     double      velocity_per_hour     = 0.0;
     std::string window_start;          // ISO-8601
     std::string window_end;            // ISO-8601
-    std::string ring_id;               // assigned during scoring
+    std::string ring_id;               // assigned during assembly
 };
 
 // ─── Shell Detection Result ────────────────────────────────────────────────
@@ -109,7 +144,8 @@ struct SuspiciousAccount {
     double                   total_inflow  = 0.0;
     double                   total_outflow = 0.0;
     int                      transaction_count = 0;
-    std::vector<std::string> connected_accounts;
+    std::vector<std::string> connected_accounts;       // first N by NodeId (capped)
+    int                      connected_account_count = 0;   // before the cap
     std::vector<std::string> ring_ids;
 };
 
@@ -134,6 +170,44 @@ struct Summary {
     double processing_time_seconds  = 0.0;
 };
 
+// ─── Stage Timings ─────────────────────────────────────────────────────────
+// Wall time per pipeline stage of one analysis, plus what the bounded
+// searches did.  Stages a path skips stay 0 (re-analysis does not parse;
+// a session append only times – and counts – what it recomputed).
+enum class Stage {
+    PARSE, GRAPH_BUILD, CYCLES, SMURFING, SHELLS, PROFILES, FILTERS, SCORING, ASSEMBLY
+};
+inline constexpr size_t STAGE_COUNT = 9;
+
+inline const char* stage_to_string(Stage s) {
+    switch (s) {
+        case Stage::PARSE:       return "parse";
+        case Stage::GRAPH_BUILD: return "graph_build";
+        case Stage::CYCLES:      return "cycles";
+        case Stage::SMURFING:    return "smurfing";
+        case Stage::SHELLS:      return "shells";
+        case Stage::PROFILES:    return "profiles";
+        case Stage::FILTERS:     return "filters";
+        case Stage::SCORING:     return "scoring";
+        case Stage::ASSEMBLY:    return "assembly";
+    }
+    return "unknown";
+}
+
+struct Timings {
+    std::array<double, STAGE_COUNT> stage_seconds{};
+    uint64_t cycle_steps             = 0;      // successor visits in the cycle DFS
+    uint64_t cycle_temporal_rejects  = 0;      // extensions past the time window
+    uint64_t cycle_step_capped_roots = 0;      // roots stopped by max_steps_per_root
+    bool     max_cycles_reached      = false;  // max_cycles dropped a cycle
+    uint64_t shell_steps             = 0;      // successor visits in the shell DFS
+    bool     max_chains_reached      = false;  // max_chains dropped a chain
+    uint64_t peak_rss_bytes          = 0;      // process-wide, at completion
+
+    double& operator[](Stage s)       { return stage_seconds[(size_t)s]; }
+    double  operator[](Stage s) const { return stage_seconds[(size_t)s]; }
+};
+
 // ─── Graph Visualization Data ──────────────────────────────────────────────
 struct GraphNode {
     std::string              id;
@@ -174,8 +248,10 @@ struct AnalysisResult {
     std::vector<SmurfingResult>    smurfing;
     std::vector<ShellResult>       shells;
     GraphData                      graph_data;
+    Timings                        timings;
     double                         processing_time_ms = 0.0;
-    double                         progress = 0.0;
+    double                         progress = 0.0;        // 0..1, see AnalysisEngine::Progress
+    bool                           truncated = false;     // detection cut short by the deadline
     std::string                    error;
 };
 
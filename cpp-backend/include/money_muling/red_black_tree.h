@@ -2,216 +2,275 @@
 // ============================================================================
 // Red-Black Tree – Custom implementation for time-series transaction queries
 //
-// Stores transactions indexed by timestamp for O(log n) range queries.
-// Supports:  insert, range_query(start, end), all(), size()
+// Indexes the rows of a caller-owned TransactionTable by timestamp for
+// O(log n + k) range queries.  Nodes hold a row index (never a copy) and
+// live in one contiguous arena addressed by 32-bit indices, so there is no
+// per-insert allocation and teardown is a single free.
+//
+// Every node is linked into three trees at once: the global time tree, its
+// sender's time tree and its receiver's time tree.  by_sender / by_receiver
+// therefore cost O(k) instead of a full walk; their roots are indexed by
+// the table's NodeIds, so no account string is hashed or stored.
+//
+// Supports:  insert, insert_all, range_query(start, end), all(),
+//            by_sender / by_receiver (optionally time-bounded), size()
+// All traversals are iterative (parent links), so depth is never an issue.
+// Ties keep insertion order.  The table may grow between inserts (append-
+// only feeds); rows already inserted must not change.
 // ============================================================================
 
 #include "models.h"
-#include <functional>
-#include <memory>
+#include "transaction_table.h"
+
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 namespace mm {
 
 class RedBlackTree {
 public:
-    RedBlackTree()  = default;
-    ~RedBlackTree() { clear(); }
+    explicit RedBlackTree(const TransactionTable& txns) : txns_(&txns) {}
 
-    // No copy (move only)
     RedBlackTree(const RedBlackTree&) = delete;
     RedBlackTree& operator=(const RedBlackTree&) = delete;
-    RedBlackTree(RedBlackTree&& o) noexcept : root_(o.root_), size_(o.size_) {
-        o.root_ = nullptr; o.size_ = 0;
-    }
-    RedBlackTree& operator=(RedBlackTree&& o) noexcept {
-        if (this != &o) { clear(); root_ = o.root_; size_ = o.size_; o.root_ = nullptr; o.size_ = 0; }
-        return *this;
+    RedBlackTree(RedBlackTree&&) noexcept = default;
+    RedBlackTree& operator=(RedBlackTree&&) noexcept = default;
+
+    // ── Insert row `index` (key = timestamp) ───────────────────────────
+    void insert(uint32_t index) {
+        const uint32_t z = (uint32_t)nodes_.size();
+        nodes_.push_back(Node{txns_->timestamp(index), index, {}});
+        link(GLOBAL, z, root_);
+        link(BY_SENDER, z, root_for(sender_roots_, txns_->sender(index)));
+        link(BY_RECEIVER, z, root_for(receiver_roots_, txns_->receiver(index)));
     }
 
-    // ── Insert a transaction (key = timestamp) ─────────────────────────
-    void insert(const Transaction& txn) {
-        auto* z = new Node{txn, Color::RED};
-        bst_insert(z);
-        fix_insert(z);
-        ++size_;
+    // ── Index every transaction appended since the last call ───────────
+    void insert_all() {
+        nodes_.reserve(txns_->size());
+        for (size_t i = nodes_.size(); i < txns_->size(); ++i) insert((uint32_t)i);
     }
 
     // ── Range query: all transactions with start <= ts <= end ──────────
-    std::vector<const Transaction*> range_query(TimePoint start, TimePoint end) const {
-        std::vector<const Transaction*> out;
-        out.reserve(64);
-        range_collect(root_, start, end, out);
-        return out;
+    std::vector<uint32_t> range_query(TimePoint start, TimePoint end) const {
+        return collect(GLOBAL, root_, start, end);
     }
 
-    // ── Collect all transactions (in-order) ────────────────────────────
-    std::vector<const Transaction*> all() const {
-        std::vector<const Transaction*> out;
-        out.reserve(size_);
-        inorder(root_, out);
-        return out;
+    // ── Collect all transactions (time order) ──────────────────────────
+    std::vector<uint32_t> all() const {
+        return collect(GLOBAL, root_, TimePoint::min(), TimePoint::max());
     }
 
-    // ── Get all transactions for a specific sender ─────────────────────
-    std::vector<const Transaction*> by_sender(const std::string& s) const {
-        std::vector<const Transaction*> out;
-        collect_if(root_, out, [&](const Transaction& t){ return t.sender == s; });
-        return out;
+    // ── Transactions sent by `s`, optionally within [start, end] ───────
+    std::vector<uint32_t> by_sender(NodeId s,
+                                    TimePoint start = TimePoint::min(),
+                                    TimePoint end   = TimePoint::max()) const {
+        return s < sender_roots_.size() ? collect(BY_SENDER, sender_roots_[s], start, end)
+                                        : std::vector<uint32_t>{};
+    }
+    std::vector<uint32_t> by_sender(std::string_view s,
+                                    TimePoint start = TimePoint::min(),
+                                    TimePoint end   = TimePoint::max()) const {
+        return by_sender(txns_->find(s), start, end);
     }
 
-    // ── Get all transactions for a specific receiver ───────────────────
-    std::vector<const Transaction*> by_receiver(const std::string& r) const {
-        std::vector<const Transaction*> out;
-        collect_if(root_, out, [&](const Transaction& t){ return t.receiver == r; });
-        return out;
+    // ── Transactions received by `r`, optionally within [start, end] ───
+    std::vector<uint32_t> by_receiver(NodeId r,
+                                      TimePoint start = TimePoint::min(),
+                                      TimePoint end   = TimePoint::max()) const {
+        return r < receiver_roots_.size() ? collect(BY_RECEIVER, receiver_roots_[r], start, end)
+                                          : std::vector<uint32_t>{};
+    }
+    std::vector<uint32_t> by_receiver(std::string_view r,
+                                      TimePoint start = TimePoint::min(),
+                                      TimePoint end   = TimePoint::max()) const {
+        return by_receiver(txns_->find(r), start, end);
+    }
+
+    /**
+     * Visit every row index i with start <= ts <= end in time order,
+     * without materialising a vector.
+     */
+    template <class F>
+    void for_each_in_range(TimePoint start, TimePoint end, F&& fn) const {
+        for (uint32_t n = lower_bound(GLOBAL, root_, start);
+             n != NIL && nodes_[n].ts <= end; n = successor(GLOBAL, n))
+            fn(nodes_[n].txn);
     }
 
-    size_t size() const { return size_; }
-    bool empty()  const { return size_ == 0; }
+    const TransactionTable& transactions() const { return *txns_; }
 
-    void clear() { destroy(root_); root_ = nullptr; size_ = 0; }
+    size_t size() const { return nodes_.size(); }
+    bool empty()  const { return nodes_.empty(); }
+
+    void clear() {
+        nodes_.clear();
+        root_ = NIL;
+        sender_roots_.clear();
+        receiver_roots_.clear();
+    }
 
 private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    // Which of a node's three link sets a tree uses
+    enum Tree : uint8_t { GLOBAL = 0, BY_SENDER = 1, BY_RECEIVER = 2 };
     enum class Color : uint8_t { RED, BLACK };
 
+    struct Links {
+        uint32_t left   = NIL;
+        uint32_t right  = NIL;
+        uint32_t parent = NIL;
+        Color    color  = Color::RED;
+    };
+
     struct Node {
-        Transaction txn;
-        Color       color  = Color::RED;
-        Node*       left   = nullptr;
-        Node*       right  = nullptr;
-        Node*       parent = nullptr;
+        TimePoint ts;           // cached key – no indirection while descending
+        uint32_t  txn;          // row of *txns_
+        Links     links[3];
     };
 
-    Node*  root_ = nullptr;
-    size_t size_ = 0;
+    const TransactionTable* txns_;
+    std::vector<Node>       nodes_;           // arena
+    uint32_t                root_ = NIL;
+    std::vector<uint32_t>   sender_roots_;    // by NodeId
+    std::vector<uint32_t>   receiver_roots_;
+
+    static uint32_t& root_for(std::vector<uint32_t>& roots, NodeId id) {
+        if (id >= roots.size()) roots.resize((size_t)id + 1, NIL);
+        return roots[id];
+    }
 
-    // ── BST insert ─────────────────────────────────────────────────────
-    void bst_insert(Node* z) {
-        Node* y = nullptr;
-        Node* x = root_;
-        while (x) {
+    Links&       L(Tree t, uint32_t n)       { return nodes_[n].links[t]; }
+    const Links& L(Tree t, uint32_t n) const { return nodes_[n].links[t]; }
+
+    bool is_red(Tree t, uint32_t n) const {
+        return n != NIL && L(t, n).color == Color::RED;
+    }
+
+    // ── BST insert + RB fix-up into the tree rooted at `root` ──────────
+    void link(Tree t, uint32_t z, uint32_t& root) {
+        uint32_t y = NIL;
+        uint32_t x = root;
+        while (x != NIL) {
             y = x;
-            x = (z->txn.timestamp < x->txn.timestamp) ? x->left : x->right;
+            x = (nodes_[z].ts < nodes_[x].ts) ? L(t, x).left : L(t, x).right;
         }
-        z->parent = y;
-        if (!y)
-            root_ = z;
-        else if (z->txn.timestamp < y->txn.timestamp)
-            y->left = z;
+        L(t, z).parent = y;
+        if (y == NIL)
+            root = z;
+        else if (nodes_[z].ts < nodes_[y].ts)
+            L(t, y).left = z;
         else
-            y->right = z;
+            L(t, y).right = z;
+        fix_insert(t, z, root);
     }
 
-    // ── Fix RB properties after insert ─────────────────────────────────
-    void fix_insert(Node* z) {
-        while (z != root_ && z->parent->color == Color::RED) {
-            Node* gp = z->parent->parent;
-            if (!gp) break;
+    void fix_insert(Tree t, uint32_t z, uint32_t& root) {
+        while (z != root && is_red(t, L(t, z).parent)) {
+            uint32_t p  = L(t, z).parent;
+            uint32_t gp = L(t, p).parent;
+            if (gp == NIL) break;
 
-            if (z->parent == gp->left) {
-                Node* uncle = gp->right;
-                if (uncle && uncle->color == Color::RED) {
-                    z->parent->color = Color::BLACK;
-                    uncle->color     = Color::BLACK;
-                    gp->color        = Color::RED;
+            if (p == L(t, gp).left) {
+                uint32_t uncle = L(t, gp).right;
+                if (is_red(t, uncle)) {
+                    L(t, p).color     = Color::BLACK;
+                    L(t, uncle).color = Color::BLACK;
+                    L(t, gp).color    = Color::RED;
                     z = gp;
                 } else {
-                    if (z == z->parent->right) {
-                        z = z->parent;
-                        rotate_left(z);
+                    if (z == L(t, p).right) {
+                        z = p;
+                        rotate_left(t, z, root);
+                        p = L(t, z).parent;
                     }
-                    z->parent->color = Color::BLACK;
-                    gp->color        = Color::RED;
-                    rotate_right(gp);
+                    L(t, p).color  = Color::BLACK;
+                    L(t, gp).color = Color::RED;
+                    rotate_right(t, gp, root);
                 }
             } else {
-                Node* uncle = gp->left;
-                if (uncle && uncle->color == Color::RED) {
-                    z->parent->color = Color::BLACK;
-                    uncle->color     = Color::BLACK;
-                    gp->color        = Color::RED;
+                uint32_t uncle = L(t, gp).left;
+                if (is_red(t, uncle)) {
+                    L(t, p).color     = Color::BLACK;
+                    L(t, uncle).color = Color::BLACK;
+                    L(t, gp).color    = Color::RED;
                     z = gp;
                 } else {
-                    if (z == z->parent->left) {
-                        z = z->parent;
-                        rotate_right(z);
+                    if (z == L(t, p).left) {
+                        z = p;
+                        rotate_right(t, z, root);
+                        p = L(t, z).parent;
                     }
-                    z->parent->color = Color::BLACK;
-                    gp->color        = Color::RED;
-                    rotate_left(gp);
+                    L(t, p).color  = Color::BLACK;
+                    L(t, gp).color = Color::RED;
+                    rotate_left(t, gp, root);
                 }
             }
         }
-        root_->color = Color::BLACK;
+        L(t, root).color = Color::BLACK;
     }
 
     // ── Rotations ──────────────────────────────────────────────────────
-    void rotate_left(Node* x) {
-        Node* y = x->right;
-        x->right = y->left;
-        if (y->left) y->left->parent = x;
-        y->parent = x->parent;
-        if (!x->parent)
-            root_ = y;
-        else if (x == x->parent->left)
-            x->parent->left = y;
+    void rotate_left(Tree t, uint32_t x, uint32_t& root) {
+        uint32_t y = L(t, x).right;
+        L(t, x).right = L(t, y).left;
+        if (L(t, y).left != NIL) L(t, L(t, y).left).parent = x;
+        L(t, y).parent = L(t, x).parent;
+        if (L(t, x).parent == NIL)
+            root = y;
+        else if (x == L(t, L(t, x).parent).left)
+            L(t, L(t, x).parent).left = y;
         else
-            x->parent->right = y;
-        y->left   = x;
-        x->parent = y;
-    }
-
-    void rotate_right(Node* x) {
-        Node* y = x->left;
-        x->left = y->right;
-        if (y->right) y->right->parent = x;
-        y->parent = x->parent;
-        if (!x->parent)
-            root_ = y;
-        else if (x == x->parent->right)
-            x->parent->right = y;
+            L(t, L(t, x).parent).right = y;
+        L(t, y).left   = x;
+        L(t, x).parent = y;
+    }
+
+    void rotate_right(Tree t, uint32_t x, uint32_t& root) {
+        uint32_t y = L(t, x).left;
+        L(t, x).left = L(t, y).right;
+        if (L(t, y).right != NIL) L(t, L(t, y).right).parent = x;
+        L(t, y).parent = L(t, x).parent;
+        if (L(t, x).parent == NIL)
+            root = y;
+        else if (x == L(t, L(t, x).parent).right)
+            L(t, L(t, x).parent).right = y;
         else
-            x->parent->left = y;
-        y->right  = x;
-        x->parent = y;
-    }
-
-    // ── Range collection (in-order, pruned) ────────────────────────────
-    void range_collect(Node* n, TimePoint lo, TimePoint hi,
-                       std::vector<const Transaction*>& out) const {
-        if (!n) return;
-        if (n->txn.timestamp >= lo)
-            range_collect(n->left, lo, hi, out);
-        if (n->txn.timestamp >= lo && n->txn.timestamp <= hi)
-            out.push_back(&n->txn);
-        if (n->txn.timestamp <= hi)
-            range_collect(n->right, lo, hi, out);
-    }
-
-    // ── In-order traversal ─────────────────────────────────────────────
-    void inorder(Node* n, std::vector<const Transaction*>& out) const {
-        if (!n) return;
-        inorder(n->left, out);
-        out.push_back(&n->txn);
-        inorder(n->right, out);
-    }
-
-    // ── Conditional collection ─────────────────────────────────────────
-    void collect_if(Node* n, std::vector<const Transaction*>& out,
-                    const std::function<bool(const Transaction&)>& pred) const {
-        if (!n) return;
-        collect_if(n->left, out, pred);
-        if (pred(n->txn)) out.push_back(&n->txn);
-        collect_if(n->right, out, pred);
-    }
-
-    // ── Destructor helper ──────────────────────────────────────────────
-    void destroy(Node* n) {
-        if (!n) return;
-        destroy(n->left);
-        destroy(n->right);
-        delete n;
+            L(t, L(t, x).parent).left = y;
+        L(t, y).right  = x;
+        L(t, x).parent = y;
+    }
+
+    // ── First node with ts >= lo (NIL if none) ─────────────────────────
+    uint32_t lower_bound(Tree t, uint32_t n, TimePoint lo) const {
+        uint32_t best = NIL;
+        while (n != NIL) {
+            if (nodes_[n].ts >= lo) { best = n; n = L(t, n).left; }
+            else                    { n = L(t, n).right; }
+        }
+        return best;
+    }
+
+    // ── In-order successor via parent links ────────────────────────────
+    uint32_t successor(Tree t, uint32_t n) const {
+        if (L(t, n).right != NIL) {
+            n = L(t, n).right;
+            while (L(t, n).left != NIL) n = L(t, n).left;
+            return n;
+        }
+        uint32_t p = L(t, n).parent;
+        while (p != NIL && n == L(t, p).right) { n = p; p = L(t, p).parent; }
+        return p;
+    }
+
+    std::vector<uint32_t> collect(Tree t, uint32_t root, TimePoint lo, TimePoint hi) const {
+        std::vector<uint32_t> out;
+        for (uint32_t n = lower_bound(t, root, lo);
+             n != NIL && nodes_[n].ts <= hi; n = successor(t, n))
+            out.push_back(nodes_[n].txn);
+        return out;
     }
 };
 
@@ -0,0 +1,208 @@
+#pragma once
+// ============================================================================
+// Redis Backend – shared, restart-proof result persistence (ENABLE_REDIS)
+//
+// Results are stored under `analysis:<id>` in the BinaryCodec format with
+// the store's TTL, so any replica pointed at the same Redis can serve any
+// analysis.
+//
+// persist() never blocks on Redis: it queues the (immutable) result and
+// one writer thread encodes and pipelines the SETs.  A result re-put
+// before its write went out is coalesced – only the latest is sent.
+// erase() queues a DEL the same way.
+// load() runs on the caller.  Both draw from a small pool of persistent
+// connections; a connection that errored is dropped and the next use
+// reconnects.
+// ============================================================================
+
+#ifdef ENABLE_REDIS
+
+#include "binary_codec.h"
+#include "models.h"
+
+#include <hiredis/hiredis.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace mm {
+
+class RedisBackend {
+public:
+    static constexpr size_t POOL_SIZE    = 4;    // idle connections kept
+    static constexpr size_t PIPELINE_MAX = 64;   // SETs / DELs per round trip
+
+    RedisBackend() = default;
+    RedisBackend(const RedisBackend&) = delete;
+    RedisBackend& operator=(const RedisBackend&) = delete;
+
+    ~RedisBackend() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            stopping_ = true;
+        }
+        queue_cv_.notify_all();
+        if (writer_.joinable()) writer_.join();       // drains the queue first
+        for (redisContext* ctx : idle_) redisFree(ctx);
+    }
+
+    // Call before first use
+    void configure(const std::string& host, int port, int db) {
+        host_ = host;
+        port_ = port;
+        db_   = db;
+    }
+
+    // Queue `result` for writing; returns immediately
+    void persist(const std::string& id, std::shared_ptr<const AnalysisResult> result,
+                 std::chrono::seconds ttl) {
+        enqueue(id, {std::move(result), ttl});
+    }
+
+    // Queue deleting `analysis:<id>`; returns immediately
+    void erase(const std::string& id) {
+        enqueue(id, {nullptr, std::chrono::seconds(0)});
+    }
+
+    // Fetch and decode `analysis:<id>`; nullptr if absent, unreadable or
+    // Redis is down
+    std::shared_ptr<const AnalysisResult> load(const std::string& id) {
+        redisContext* ctx = acquire();
+        if (!ctx) return nullptr;
+
+        const std::string key = "analysis:" + id;
+        const char*  argv[] = {"GET", key.c_str()};
+        const size_t lens[] = {3, key.size()};
+        auto* reply = (redisReply*)redisCommandArgv(ctx, 2, argv, lens);
+
+        std::shared_ptr<const AnalysisResult> out;
+        if (reply && reply->type == REDIS_REPLY_STRING) {
+            if (auto r = BinaryCodec::decode(std::string_view(reply->str, reply->len)))
+                out = std::make_shared<const AnalysisResult>(std::move(*r));
+        }
+        if (reply) freeReplyObject(reply);
+        release(ctx);
+        return out;
+    }
+
+private:
+    struct Pending {
+        std::shared_ptr<const AnalysisResult> result;   // null = DEL
+        std::chrono::seconds                  ttl{0};
+    };
+
+    std::string host_ = "127.0.0.1";
+    int         port_ = 6379;
+    int         db_   = 0;
+
+    std::mutex                  pool_mtx_;
+    std::vector<redisContext*>  idle_;
+
+    std::mutex                               queue_mtx_;
+    std::condition_variable                  queue_cv_;
+    std::unordered_map<std::string, Pending> queued_;
+    std::deque<std::string>                  order_;
+    std::thread                              writer_;
+    bool                                     stopping_ = false;
+
+    // ── Connection pool ────────────────────────────────────────────────
+    redisContext* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(pool_mtx_);
+            if (!idle_.empty()) {
+                redisContext* ctx = idle_.back();
+                idle_.pop_back();
+                return ctx;
+            }
+        }
+        redisContext* ctx = redisConnect(host_.c_str(), port_);
+        if (ctx == nullptr || ctx->err) {
+            if (ctx) redisFree(ctx);
+            return nullptr;
+        }
+        if (db_ != 0) {
+            redisReply* reply = (redisReply*)redisCommand(ctx, "SELECT %d", db_);
+            if (reply) freeReplyObject(reply);
+        }
+        return ctx;
+    }
+
+    void release(redisContext* ctx) {
+        if (!ctx->err) {
+            std::lock_guard<std::mutex> lock(pool_mtx_);
+            if (idle_.size() < POOL_SIZE) { idle_.push_back(ctx); return; }
+        }
+        redisFree(ctx);
+    }
+
+    // ── Writer thread ──────────────────────────────────────────────────
+    void enqueue(const std::string& id, Pending p) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            if (stopping_) return;
+            if (!writer_.joinable()) writer_ = std::thread([this] { write_loop(); });
+            auto [it, fresh] = queued_.try_emplace(id);
+            it->second = std::move(p);
+            if (fresh) order_.push_back(id);
+        }
+        queue_cv_.notify_one();
+    }
+
+    void write_loop() {
+        std::vector<std::pair<std::string, Pending>> batch;
+        for (;;) {
+            batch.clear();
+            {
+                std::unique_lock<std::mutex> lock(queue_mtx_);
+                queue_cv_.wait(lock, [this] { return stopping_ || !order_.empty(); });
+                if (order_.empty()) return;                   // stopping, drained
+                while (!order_.empty() && batch.size() < PIPELINE_MAX) {
+                    auto it = queued_.find(order_.front());
+                    batch.emplace_back(order_.front(), std::move(it->second));
+                    queued_.erase(it);
+                    order_.pop_front();
+                }
+            }
+            write_batch(batch);
+        }
+    }
+
+    // Pipelined SET … EX / DEL; a batch that hits a dead connection is dropped
+    void write_batch(const std::vector<std::pair<std::string, Pending>>& batch) {
+        redisContext* ctx = acquire();
+        if (!ctx) return;
+
+        for (const auto& [id, p] : batch) {
+            const std::string key   = "analysis:" + id;
+            if (!p.result) {
+                const char*  argv[] = {"DEL", key.c_str()};
+                const size_t lens[] = {3, key.size()};
+                redisAppendCommandArgv(ctx, 2, argv, lens);
+                continue;
+            }
+            const std::string value = BinaryCodec::encode(*p.result);
+            const std::string ttl   = std::to_string(p.ttl.count());
+            const char*  argv[] = {"SET", key.c_str(), value.data(), "EX", ttl.c_str()};
+            const size_t lens[] = {3, key.size(), value.size(), 2, ttl.size()};
+            redisAppendCommandArgv(ctx, 5, argv, lens);
+        }
+        for (size_t k = 0; k < batch.size(); ++k) {
+            void* reply = nullptr;
+            if (redisGetReply(ctx, &reply) != REDIS_OK) break;
+            freeReplyObject(reply);
+        }
+        release(ctx);
+    }
+};
+
+} // namespace mm
+
+#endif // ENABLE_REDIS
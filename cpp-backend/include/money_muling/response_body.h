@@ -0,0 +1,155 @@
+#pragma once
+// ============================================================================
+// Response Bodies – pre-serialised HTTP bodies of a finished analysis
+//
+// A completed (or failed) result never changes, so the three GET bodies –
+// status poll, graph and download – are serialised once when the result
+// is stored and served as-is afterwards.  Each body carries a strong ETag
+// (FNV-1a of its bytes) and, when built with ENABLE_GZIP, a gzip variant
+// for clients that send `Accept-Encoding: gzip`.  The gzip variant has its
+// own ETag (`-gz` suffix), as a different representation must.
+// ============================================================================
+
+#include "models.h"
+#include "json_serializer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef ENABLE_GZIP
+#include <zlib.h>
+#endif
+
+namespace mm {
+
+struct EncodedBody {
+    std::string data;
+    std::string etag;        // quoted, e.g. "\"9f3a…\""
+    std::string gzip;        // empty when not compressed
+    std::string gzip_etag;
+
+    static constexpr size_t GZIP_MIN_BYTES = 1024;   // smaller bodies go out as-is
+
+    static EncodedBody make(std::string data) {
+        EncodedBody b;
+        b.data = std::move(data);
+        b.etag = etag_of(b.data, "");
+#ifdef ENABLE_GZIP
+        if (b.data.size() >= GZIP_MIN_BYTES) {
+            b.gzip = gzip_compress(b.data);
+            if (!b.gzip.empty()) b.gzip_etag = etag_of(b.data, "-gz");
+        }
+#endif
+        return b;
+    }
+
+    size_t bytes() const {
+        return data.capacity() + etag.capacity() + gzip.capacity() + gzip_etag.capacity();
+    }
+
+private:
+    static std::string etag_of(std::string_view data, const char* suffix) {
+        uint64_t h = 1469598103934665603ull;            // FNV-1a 64
+        for (unsigned char c : data) { h ^= c; h *= 1099511628211ull; }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "\"%016llx%s\"", (unsigned long long)h, suffix);
+        return buf;
+    }
+
+#ifdef ENABLE_GZIP
+    // gzip container (windowBits 15 + 16); empty on failure
+    static std::string gzip_compress(std::string_view in) {
+        z_stream zs{};
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+            return {};
+        std::string out(deflateBound(&zs, (uLong)in.size()), '\0');
+        zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        zs.avail_in  = (uInt)in.size();
+        zs.next_out  = reinterpret_cast<Bytef*>(out.data());
+        zs.avail_out = (uInt)out.size();
+        const int rc = deflate(&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END) return {};
+        out.shrink_to_fit();
+        return out;
+    }
+#endif
+};
+
+// The cached bodies of one finished result
+struct ResponseBodies {
+    EncodedBody status;     // GET /analysis/{id}
+    EncodedBody graph;      // GET /analysis/{id}/graph
+    EncodedBody download;   // GET /analysis/{id}/download (pretty-printed)
+
+    static std::shared_ptr<const ResponseBodies> build(const AnalysisResult& r) {
+        auto b = std::make_shared<ResponseBodies>();
+        b->status = EncodedBody::make(analysis_result_json(r));
+        if (r.status == AnalysisStatus::COMPLETED) {
+            b->graph    = EncodedBody::make(graph_data_json(r.graph_data));
+            b->download = EncodedBody::make(download_result_json(r));
+        }
+        return b;
+    }
+
+    size_t bytes() const {
+        return sizeof(*this) + status.bytes() + graph.bytes() + download.bytes();
+    }
+};
+
+// ── Header helpers ───────────────────────────────────────────────────────
+
+namespace http {
+
+inline std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+// Does an If-None-Match header list `etag` (or "*")?  Weak tags compare
+// by value, as RFC 9110 requires for If-None-Match.
+inline bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    while (!if_none_match.empty()) {
+        const size_t comma = if_none_match.find(',');
+        std::string_view tag = trim(if_none_match.substr(0, comma));
+        if (tag.substr(0, 2) == "W/") tag.remove_prefix(2);
+        if (tag == "*" || tag == etag) return true;
+        if (comma == std::string_view::npos) break;
+        if_none_match.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Does Accept-Encoding allow gzip (listed, or via "*", without q=0)?
+inline bool accepts_gzip(std::string_view accept_encoding) {
+    while (!accept_encoding.empty()) {
+        const size_t comma = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, comma);
+        const size_t semi = item.find(';');
+        std::string_view coding = trim(item.substr(0, semi));
+        if (coding == "gzip" || coding == "x-gzip" || coding == "*") {
+            double q = 1.0;
+            if (semi != std::string_view::npos) {
+                std::string_view param = trim(item.substr(semi + 1));
+                if (param.substr(0, 2) == "q=")
+                    q = std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+            }
+            if (q > 0.0) return true;
+        }
+        if (comma == std::string_view::npos) break;
+        accept_encoding.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+} // namespace http
+
+} // namespace mm
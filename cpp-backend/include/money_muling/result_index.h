@@ -0,0 +1,346 @@
+#pragma once
+// ============================================================================
+// Result Index – query indexes over a finished analysis
+//
+// Built once when a completed result is stored (next to its cached
+// bodies), so the poll and graph endpoints can answer filtered requests
+// without re-serialising – or even scanning – the whole result:
+//
+//   suspicious_accounts   already score-sorted, so top-K, min_score and
+//                         cursor pages are a binary search plus a slice
+//   by_score_[N]          graph node positions, score descending
+//   node_off_[N+1]        → adj_[]  undirected CSR over graph_data edges
+//                         (edge positions), for k-hop neighbourhoods
+//   ring_off_[R+1]        → ring_nodes_[] fraud ring → graph node positions
+//
+// The adjacency also serves the uncapped connected_accounts of any
+// account (graph_data nodes are in NodeId order, so the capped list in a
+// SuspiciousAccount is a prefix of it).
+//
+// Positions index the result's own vectors, so query output keeps the
+// order of the full response.  The index holds the result it describes.
+// ============================================================================
+
+#include "models.h"
+#include "json_serializer.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace mm {
+
+// ── Query parameters ─────────────────────────────────────────────────────
+
+// GET /analysis/{id}: a page of suspicious_accounts
+struct AccountQuery {
+    std::optional<size_t> limit;           // top-K / page size
+    size_t                cursor    = 0;   // position to resume from (next_cursor)
+    double                min_score = 0.0;
+};
+
+// GET /analysis/{id}/graph: a subgraph
+struct GraphQuery {
+    std::string           account;         // k-hop neighbourhood of an account …
+    std::string           ring;            // … or of a fraud ring's members
+    int                   hops = 1;
+    bool                  suspicious_only = false;   // edges touching is_suspicious nodes
+    double                min_score = 0.0;
+    std::optional<size_t> limit;           // top-K nodes by score
+
+    bool neighbourhood() const { return !account.empty() || !ring.empty(); }
+};
+
+class ResultIndex {
+public:
+    static constexpr size_t DEFAULT_PAGE = 100;   // limit when only a cursor is given
+    static constexpr size_t MAX_LIMIT    = 10000;
+    static constexpr int    MAX_HOPS     = 5;
+
+    explicit ResultIndex(std::shared_ptr<const AnalysisResult> result)
+        : result_(std::move(result))
+    {
+        const auto& nodes = result_->graph_data.nodes;
+        const auto& edges = result_->graph_data.edges;
+        const size_t N = nodes.size(), E = edges.size();
+
+        position_.reserve(N);
+        for (uint32_t i = 0; i < (uint32_t)N; ++i) position_.emplace(nodes[i].id, i);
+
+        // ── Score order (ties by position, i.e. graph order) ───────────
+        by_score_.resize(N);
+        for (uint32_t i = 0; i < (uint32_t)N; ++i) by_score_[i] = i;
+        std::stable_sort(by_score_.begin(), by_score_.end(), [&](uint32_t a, uint32_t b) {
+            return nodes[a].suspicion_score > nodes[b].suspicion_score;
+        });
+
+        // ── Undirected adjacency by counting sort ──────────────────────
+        edge_src_.resize(E);
+        edge_dst_.resize(E);
+        node_off_.assign(N + 1, 0);
+        for (uint32_t e = 0; e < (uint32_t)E; ++e) {
+            edge_src_[e] = node(edges[e].source);
+            edge_dst_[e] = node(edges[e].target);
+            if (edge_src_[e] == NONE || edge_dst_[e] == NONE) continue;
+            ++node_off_[edge_src_[e] + 1];
+            if (edge_dst_[e] != edge_src_[e]) ++node_off_[edge_dst_[e] + 1];
+        }
+        for (size_t n = 0; n < N; ++n) node_off_[n + 1] += node_off_[n];
+        adj_.resize(node_off_[N]);
+        std::vector<uint32_t> cursor(node_off_.begin(), node_off_.end() - 1);
+        for (uint32_t e = 0; e < (uint32_t)E; ++e) {
+            if (edge_src_[e] == NONE || edge_dst_[e] == NONE) continue;
+            adj_[cursor[edge_src_[e]]++] = e;
+            if (edge_dst_[e] != edge_src_[e]) adj_[cursor[edge_dst_[e]]++] = e;
+        }
+
+        // ── Fraud ring → member nodes ──────────────────────────────────
+        ring_off_.reserve(result_->fraud_rings.size() + 1);
+        ring_off_.push_back(0);
+        for (uint32_t r = 0; r < (uint32_t)result_->fraud_rings.size(); ++r) {
+            const auto& ring = result_->fraud_rings[r];
+            ring_position_.emplace(ring.ring_id, r);
+            for (const auto& m : ring.member_accounts)
+                if (const uint32_t n = node(m); n != NONE) ring_nodes_.push_back(n);
+            ring_off_.push_back((uint32_t)ring_nodes_.size());
+        }
+    }
+
+    const AnalysisResult& result() const { return *result_; }
+
+    bool has_account(std::string_view id) const { return node(id) != NONE; }
+    bool has_ring(std::string_view id) const    { return ring_position_.count(id) != 0; }
+
+    // ── Suspicious-account pages ───────────────────────────────────────
+    /**
+     * Poll body (completed) with suspicious_accounts cut to the accounts
+     * at or above min_score, from `cursor`, at most `limit` of them.  The
+     * result object gains `next_cursor` (null on the last page, and on an
+     * empty one so a zero limit cannot loop a client) and
+     * `total_matching`, and carries `truncated` like the full body.
+     */
+    std::string accounts_json(const AccountQuery& q) const {
+        const auto& accounts = result_->suspicious_accounts;
+        const size_t matching = std::partition_point(accounts.begin(), accounts.end(),
+            [&](const SuspiciousAccount& a) { return a.suspicion_score >= q.min_score; })
+            - accounts.begin();
+        const size_t first = std::min(q.cursor, matching);
+        const size_t last  = std::min(matching, first + q.limit.value_or(matching - first));
+
+        std::string out;
+        JsonWriter w(out);
+        w.begin_object();
+        w.field("analysis_id", result_->analysis_id);
+        w.key("result").begin_object();
+        w.key("fraud_rings").begin_array();
+        for (const auto& fr : result_->fraud_rings) write_fraud_ring(w, fr);
+        w.end_array();
+        w.key("next_cursor");
+        if (first < last && last < matching) w.value(std::to_string(last));
+        else                 w.value(nullptr);
+        w.key("summary");
+        write_summary(w, result_->summary);
+        w.key("suspicious_accounts").begin_array();
+        for (size_t i = first; i < last; ++i) write_suspicious_account(w, accounts[i]);
+        w.end_array();
+        w.key("timings");
+        write_timings(w, result_->timings);
+        w.field("total_matching", matching);
+        w.field("truncated", result_->truncated);
+        w.end_object();
+        w.field("status", status_to_string(AnalysisStatus::COMPLETED));
+        w.end_object();
+        return out;
+    }
+
+    // ── Neighbours ─────────────────────────────────────────────────────
+    /**
+     * Every account `account` sent to or received from, in graph order
+     * (the uncapped connected_accounts), from `cursor`, at most `limit`.
+     * Empty for an unknown account.  next_cursor is null on the last page
+     * and on an empty one, as in accounts_json.
+     */
+    std::string neighbours_json(std::string_view account, size_t cursor,
+                                std::optional<size_t> limit) const {
+        std::vector<uint32_t> nbrs;
+        if (const uint32_t n = node(account); n != NONE) {
+            nbrs.reserve(node_off_[n + 1] - node_off_[n]);
+            for (uint32_t k = node_off_[n]; k < node_off_[n + 1]; ++k) {
+                const uint32_t e = adj_[k];
+                const uint32_t m = edge_src_[e] == n ? edge_dst_[e] : edge_src_[e];
+                if (m != n) nbrs.push_back(m);
+            }
+            std::sort(nbrs.begin(), nbrs.end());
+            nbrs.erase(std::unique(nbrs.begin(), nbrs.end()), nbrs.end());
+        }
+        const size_t first = std::min(cursor, nbrs.size());
+        const size_t last  = std::min(nbrs.size(), first + limit.value_or(nbrs.size() - first));
+
+        std::string out;
+        JsonWriter w(out);
+        w.begin_object();
+        w.field("account_id", account);
+        w.field("connected_account_count", nbrs.size());
+        w.key("connected_accounts").begin_array();
+        for (size_t i = first; i < last; ++i) w.value(result_->graph_data.nodes[nbrs[i]].id);
+        w.end_array();
+        w.key("next_cursor");
+        if (first < last && last < nbrs.size()) w.value(std::to_string(last));
+        else                    w.value(nullptr);
+        w.end_object();
+        return out;
+    }
+
+    // ── Subgraphs ──────────────────────────────────────────────────────
+    /**
+     * graph_data restricted to a node set and the edges among it:
+     *   1. all nodes, or those within `hops` of the account / ring members
+     *   2. suspicious_only: only is_suspicious edges, and only nodes on one
+     *      (or suspicious themselves)
+     *   3. nodes below min_score dropped, then the top `limit` by score
+     * Nodes and edges keep their order in the full graph.
+     */
+    std::string graph_json(const GraphQuery& q) const {
+        const auto& gd = result_->graph_data;
+        const size_t N = gd.nodes.size();
+        std::vector<char> keep(N, 0);
+        std::vector<uint32_t> selected;
+
+        if (q.neighbourhood()) {
+            selected = within_hops(seeds(q), q.hops, q.suspicious_only);
+        } else {
+            // Score order: min_score is a prefix, so the top-K is too
+            const size_t above = std::partition_point(by_score_.begin(), by_score_.end(),
+                [&](uint32_t n) { return gd.nodes[n].suspicion_score >= q.min_score; })
+                - by_score_.begin();
+            selected.reserve(above);
+            for (size_t i = 0; i < above; ++i) {
+                const uint32_t n = by_score_[i];
+                if (q.suspicious_only && !on_suspicious_edge(n)) continue;
+                selected.push_back(n);
+                if (q.limit && selected.size() == *q.limit) break;
+            }
+        }
+
+        // min_score / limit for neighbourhoods (score order already applied above)
+        if (q.neighbourhood()) {
+            std::erase_if(selected, [&](uint32_t n) {
+                return gd.nodes[n].suspicion_score < q.min_score;
+            });
+            std::stable_sort(selected.begin(), selected.end(), [&](uint32_t a, uint32_t b) {
+                return gd.nodes[a].suspicion_score > gd.nodes[b].suspicion_score;
+            });
+        }
+        if (q.limit && selected.size() > *q.limit) selected.resize(*q.limit);
+        for (uint32_t n : selected) keep[n] = 1;
+
+        // Induced edges, each once (from its source's adjacency)
+        std::vector<uint32_t> edge_list;
+        for (uint32_t n : selected) {
+            for (uint32_t k = node_off_[n]; k < node_off_[n + 1]; ++k) {
+                const uint32_t e = adj_[k];
+                if (edge_src_[e] != n || !keep[edge_dst_[e]]) continue;
+                if (q.suspicious_only && !gd.edges[e].is_suspicious) continue;
+                edge_list.push_back(e);
+            }
+        }
+        std::sort(edge_list.begin(), edge_list.end());
+        std::sort(selected.begin(), selected.end());
+
+        std::string out;
+        JsonWriter w(out);
+        w.begin_object();
+        w.key("edges").begin_array();
+        for (uint32_t e : edge_list) write_graph_edge(w, gd.edges[e]);
+        w.end_array();
+        w.key("nodes").begin_array();
+        for (uint32_t n : selected) write_graph_node(w, gd.nodes[n]);
+        w.end_array();
+        w.end_object();
+        return out;
+    }
+
+    // Rough heap footprint, for the store's memory budget
+    size_t bytes() const {
+        const size_t words = by_score_.capacity() + node_off_.capacity() + adj_.capacity()
+                           + edge_src_.capacity() + edge_dst_.capacity()
+                           + ring_off_.capacity() + ring_nodes_.capacity();
+        const size_t entry = sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*);
+        return sizeof(*this) + words * sizeof(uint32_t)
+             + (position_.size() + ring_position_.size()) * entry;
+    }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::shared_ptr<const AnalysisResult> result_;
+
+    std::unordered_map<std::string_view, uint32_t> position_;        // node id → position
+    std::unordered_map<std::string_view, uint32_t> ring_position_;   // ring id → fraud_rings pos
+    std::vector<uint32_t> by_score_;                                 // N
+    std::vector<uint32_t> node_off_;                                 // N+1
+    std::vector<uint32_t> adj_;                                      // edge positions
+    std::vector<uint32_t> edge_src_, edge_dst_;                      // E (NONE if unknown)
+    std::vector<uint32_t> ring_off_;                                 // R+1
+    std::vector<uint32_t> ring_nodes_;
+
+    uint32_t node(std::string_view id) const {
+        auto it = position_.find(id);
+        return it == position_.end() ? NONE : it->second;
+    }
+
+    std::vector<uint32_t> seeds(const GraphQuery& q) const {
+        std::vector<uint32_t> out;
+        if (!q.account.empty()) {
+            if (const uint32_t n = node(q.account); n != NONE) out.push_back(n);
+        }
+        if (!q.ring.empty()) {
+            if (auto it = ring_position_.find(q.ring); it != ring_position_.end())
+                out.insert(out.end(), ring_nodes_.begin() + ring_off_[it->second],
+                           ring_nodes_.begin() + ring_off_[it->second + 1]);
+        }
+        return out;
+    }
+
+    bool on_suspicious_edge(uint32_t n) const {
+        if (result_->graph_data.nodes[n].is_suspicious) return true;
+        for (uint32_t k = node_off_[n]; k < node_off_[n + 1]; ++k)
+            if (result_->graph_data.edges[adj_[k]].is_suspicious) return true;
+        return false;
+    }
+
+    // BFS over undirected edges (suspicious ones only, if asked), seeds first
+    std::vector<uint32_t> within_hops(const std::vector<uint32_t>& seeds, int hops,
+                                      bool suspicious_only) const {
+        const auto& edges = result_->graph_data.edges;
+        std::vector<char> seen(result_->graph_data.nodes.size(), 0);
+        std::vector<uint32_t> order;
+        for (uint32_t s : seeds)
+            if (!seen[s]) { seen[s] = 1; order.push_back(s); }
+
+        size_t frontier = 0;
+        for (int h = 0; h < hops && frontier < order.size(); ++h) {
+            const size_t end = order.size();
+            for (size_t i = frontier; i < end; ++i) {
+                const uint32_t n = order[i];
+                for (uint32_t k = node_off_[n]; k < node_off_[n + 1]; ++k) {
+                    const uint32_t e = adj_[k];
+                    if (suspicious_only && !edges[e].is_suspicious) continue;
+                    const uint32_t m = edge_src_[e] == n ? edge_dst_[e] : edge_src_[e];
+                    if (!seen[m]) { seen[m] = 1; order.push_back(m); }
+                }
+            }
+            frontier = end;
+        }
+        return order;
+    }
+};
+
+} // namespace mm
@@ -1,114 +1,126 @@
 #pragma once
 // ============================================================================
-// Scoring – build suspicious accounts & fraud rings
+// Scoring – build suspicious accounts, fraud rings & graph data
 //
 // Mirrors Python scoring.py:
 //   calculate_scores()        → DecisionTree::score_all  (in decision_tree.h)
 //   build_suspicious_accounts → Scoring::build_suspicious_accounts
 //   build_fraud_rings         → Scoring::build_fraud_rings
+// and graph_builder.py's build_graph_data → Scoring::build_graph_data.
+//
+// All of them read the analysis' DetectionIndex and take scores and
+// profiles as NodeId-indexed arrays, so assembly is linear passes over
+// integer IDs; strings are only produced for the output structs.
 // ============================================================================
 
 #include "models.h"
 #include "graph_engine.h"
 #include "decision_tree.h"
+#include "detection_index.h"
 
 #include <algorithm>
 #include <cmath>
-#include <set>
+#include <memory_resource>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <span>
+#include <string_view>
 #include <vector>
 
 namespace mm {
 
 class Scoring {
 public:
+    // Graph nodes / edges at or above this score are marked suspicious
+    static constexpr double SUSPICIOUS_SCORE = 25.0;
+
+    // connected_accounts listed per suspicious account (0 = all); the
+    // full list is served by the neighbours endpoint
+    static constexpr int DEFAULT_MAX_CONNECTED = 100;
+
+    /**
+     * Union of two ID-sorted adjacency rows minus `self`, in ID order:
+     * emit(n) for each of the first `cap` (0 = no cap), and the size of
+     * the whole union returned.  No allocation.
+     */
+    template <class Emit>
+    static size_t merge_neighbours(std::span<const NodeId> a, std::span<const NodeId> b,
+                                   NodeId self, size_t cap, Emit&& emit) {
+        size_t count = 0, i = 0, j = 0;
+        while (i < a.size() || j < b.size()) {
+            NodeId n;
+            if (j == b.size() || (i < a.size() && a[i] < b[j])) n = a[i++];
+            else if (i == a.size() || b[j] < a[i])              n = b[j++];
+            else { n = a[i++]; ++j; }                            // in both rows
+            if (n == self) continue;
+            if (cap == 0 || count < cap) emit(n);
+            ++count;
+        }
+        return count;
+    }
 
     // -----------------------------------------------------------------------
     // calculate_scores – delegates to DecisionTree
     // -----------------------------------------------------------------------
-    static std::unordered_map<std::string, double> calculate_scores(
-        const std::unordered_map<std::string, AccountProfile>& profiles,
-        const std::vector<CycleResult>&   cycles,
-        const std::vector<SmurfingResult>& smurfing,
-        const std::vector<ShellResult>&    shells)
+    static std::vector<double> calculate_scores(
+        const std::vector<AccountProfile>& profiles,
+        const DetectionIndex&              index)
     {
-        return DecisionTree::score_all(profiles, cycles, smurfing, shells);
+        return DecisionTree::score_all(profiles, index);
     }
 
     // -----------------------------------------------------------------------
     // build_suspicious_accounts
+    //
+    // connected_accounts is capped at `max_connected` (0 = all);
+    // connected_account_count is always the full count.  Scratch
+    // allocates from `mem` (the analysis arena).
     // -----------------------------------------------------------------------
     static std::vector<SuspiciousAccount> build_suspicious_accounts(
-        const std::unordered_map<std::string, double>&          scores,
-        const std::unordered_map<std::string, AccountProfile>&  profiles,
-        const std::vector<CycleResult>&   cycles,
-        const std::vector<SmurfingResult>& smurfing,
-        const std::vector<ShellResult>&    shells,
-        const TransactionGraph&            graph)
+        const std::vector<double>&         scores,
+        const std::vector<AccountProfile>& profiles,
+        const DetectionIndex&              index,
+        const TransactionGraph&            graph,
+        int                                max_connected = DEFAULT_MAX_CONNECTED,
+        std::pmr::memory_resource*         mem = std::pmr::get_default_resource())
     {
-        // Build pattern_map  account_id -> set of pattern strings
-        // Build ring_map     account_id -> set of ring_ids
-        std::unordered_map<std::string, std::set<std::string>> pattern_map;
-        std::unordered_map<std::string, std::set<std::string>> ring_map;
-
-        for (const auto& c : cycles) {
-            for (const auto& node : c.nodes) {
-                pattern_map[node].insert("cycle");
-                ring_map[node].insert(c.ring_id);
-            }
-        }
-        for (const auto& s : smurfing) {
-            pattern_map[s.account_id].insert(s.pattern_type);
-            ring_map[s.account_id].insert(s.ring_id);
-        }
-        for (const auto& s : shells) {
-            for (const auto& node : s.chain) {
-                pattern_map[node].insert("shell");
-                ring_map[node].insert(s.ring_id);
-            }
-        }
+        std::pmr::vector<std::string_view> ring_ids(mem);
 
         // Build suspicious accounts (score > 0)
         std::vector<SuspiciousAccount> result;
 
-        for (const auto& [acct_id, score] : scores) {
+        for (NodeId id = 0; id < (NodeId)scores.size(); ++id) {
+            const double score = scores[id];
             if (score <= 0.0) continue;
+            const AccountProfile& profile = profiles[id];
 
             SuspiciousAccount sa;
-            sa.account_id     = acct_id;
+            sa.account_id      = graph.name(id);
             sa.suspicion_score = score;
 
-            // Detected patterns
-            auto pit = pattern_map.find(acct_id);
-            if (pit != pattern_map.end()) {
-                sa.detected_patterns.assign(pit->second.begin(),
-                                            pit->second.end());
-            }
+            // Detected patterns (spec format, sorted)
+            sa.detected_patterns = index.spec_patterns(id);
 
-            // Ring IDs
-            auto rit = ring_map.find(acct_id);
-            if (rit != ring_map.end()) {
-                sa.ring_ids.assign(rit->second.begin(), rit->second.end());
-                if (!sa.ring_ids.empty()) sa.ring_id = sa.ring_ids.front();
-            }
+            // Ring IDs (sorted, unique)
+            ring_ids.clear();
+            for (DetectionIndex::RingId r : index.rings(id)) ring_ids.push_back(index.ring_id(r));
+            std::sort(ring_ids.begin(), ring_ids.end());
+            ring_ids.erase(std::unique(ring_ids.begin(), ring_ids.end()), ring_ids.end());
+            sa.ring_ids.assign(ring_ids.begin(), ring_ids.end());
+            if (!sa.ring_ids.empty()) sa.ring_id = sa.ring_ids.front();
 
             // Profile data
-            auto profi = profiles.find(acct_id);
-            if (profi != profiles.end()) {
-                sa.account_type      = profi->second.account_type;
-                sa.total_inflow      = profi->second.total_inflow;
-                sa.total_outflow     = profi->second.total_outflow;
-                sa.transaction_count = profi->second.transaction_count;
-            }
-
-            // Connected accounts (graph neighbours)
-            std::unordered_set<std::string> connected;
-            for (const auto& s : graph.successors(acct_id))   connected.insert(s);
-            for (const auto& p : graph.predecessors(acct_id)) connected.insert(p);
-            connected.erase(acct_id);
-            sa.connected_accounts.assign(connected.begin(), connected.end());
+            sa.account_type      = profile.account_type;
+            sa.total_inflow      = profile.total_inflow;
+            sa.total_outflow     = profile.total_outflow;
+            sa.transaction_count = profile.transaction_count;
+
+            // Connected accounts (graph neighbours, both rows ID-sorted)
+            const auto out = graph.successors(id), in = graph.predecessors(id);
+            const size_t cap = (size_t)std::max(max_connected, 0);
+            sa.connected_accounts.reserve(cap ? std::min(cap, out.size() + in.size())
+                                              : out.size() + in.size());
+            sa.connected_account_count = (int)merge_neighbours(out, in, id, cap,
+                [&](NodeId n) { sa.connected_accounts.emplace_back(graph.name(n)); });
 
             result.push_back(std::move(sa));
         }
@@ -125,88 +137,109 @@ public:
     }
 
     // -----------------------------------------------------------------------
-    // build_fraud_rings – aggregate from cycles, smurfing groups, shells
+    // build_fraud_rings – one ring per cycle, smurfing account and shell
+    // chain; members sorted and unique, risk = max member score.  Sorted by
+    // risk descending, ties in ring (RING_NNN) order.
     // -----------------------------------------------------------------------
     static std::vector<FraudRing> build_fraud_rings(
-        const std::unordered_map<std::string, double>& scores,
-        const std::vector<CycleResult>&   cycles,
-        const std::vector<SmurfingResult>& smurfing,
-        const std::vector<ShellResult>&    shells)
+        const std::vector<double>& scores,
+        const DetectionIndex&      index,
+        const TransactionGraph&    graph,
+        std::pmr::memory_resource* mem = std::pmr::get_default_resource())
     {
-        std::unordered_map<std::string, FraudRing> ring_map;
-
-        // From cycles
-        for (const auto& c : cycles) {
-            FraudRing& ring = ring_map[c.ring_id];
-            ring.ring_id      = c.ring_id;
-            ring.pattern_type = "cycle";
-            std::set<std::string> members(c.nodes.begin(), c.nodes.end());
-            ring.member_accounts.assign(members.begin(), members.end());
-
-            // Risk = max score among members
-            double max_score = 0.0;
-            for (const auto& node : c.nodes) {
-                auto it = scores.find(node);
-                if (it != scores.end())
-                    max_score = std::max(max_score, it->second);
-            }
-            ring.risk_score = max_score;
-        }
-
-        // From smurfing  –  group by ring_id
-        {
-            std::unordered_map<std::string, std::set<std::string>> smurf_groups;
-            std::unordered_map<std::string, std::string> smurf_pattern;
-            for (const auto& s : smurfing) {
-                smurf_groups[s.ring_id].insert(s.account_id);
-                smurf_pattern[s.ring_id] = s.pattern_type;
-            }
-            for (auto& [rid, members] : smurf_groups) {
-                FraudRing& ring = ring_map[rid];
-                ring.ring_id      = rid;
-                ring.pattern_type = smurf_pattern[rid];
-                ring.member_accounts.assign(members.begin(), members.end());
-
-                double max_score = 0.0;
-                for (const auto& acct : members) {
-                    auto it = scores.find(acct);
-                    if (it != scores.end())
-                        max_score = std::max(max_score, it->second);
-                }
-                ring.risk_score = max_score;
-            }
-        }
+        std::vector<FraudRing> result;
+        result.reserve(index.ring_count());
+        std::pmr::vector<std::string_view> members(mem);
 
-        // From shells
-        for (const auto& s : shells) {
-            FraudRing& ring = ring_map[s.ring_id];
-            ring.ring_id      = s.ring_id;
-            ring.pattern_type = "shell";
-            std::set<std::string> members(s.chain.begin(), s.chain.end());
-            ring.member_accounts.assign(members.begin(), members.end());
+        for (DetectionIndex::RingId r = 0; r < (DetectionIndex::RingId)index.ring_count(); ++r) {
+            FraudRing ring;
+            ring.ring_id      = index.ring_id(r);
+            ring.pattern_type = index.ring_pattern(r);
 
+            members.clear();
             double max_score = 0.0;
-            for (const auto& node : s.chain) {
-                auto it = scores.find(node);
-                if (it != scores.end())
-                    max_score = std::max(max_score, it->second);
+            for (NodeId m : index.members(r)) {
+                members.push_back(graph.name(m));
+                max_score = std::max(max_score, scores[m]);
             }
+            std::sort(members.begin(), members.end());
+            members.erase(std::unique(members.begin(), members.end()), members.end());
+            ring.member_accounts.assign(members.begin(), members.end());
             ring.risk_score = max_score;
-        }
 
-        // Flatten and sort by risk_score descending
-        std::vector<FraudRing> result;
-        result.reserve(ring_map.size());
-        for (auto& [_, ring] : ring_map) {
             result.push_back(std::move(ring));
         }
-        std::sort(result.begin(), result.end(),
+
+        std::stable_sort(result.begin(), result.end(),
             [](const FraudRing& a, const FraudRing& b) {
                 return a.risk_score > b.risk_score;
             });
 
         return result;
     }
+
+    // -----------------------------------------------------------------------
+    // build_graph_data – every account and aggregated edge for the frontend
+    // -----------------------------------------------------------------------
+    static GraphData build_graph_data(
+        const TransactionGraph&    graph,
+        const std::vector<double>& scores,
+        const DetectionIndex&      index)
+    {
+        const size_t N = graph.node_count();
+        GraphData gd;
+        gd.nodes.reserve(N);
+        gd.edges.reserve(graph.edge_count());
+
+        // Nodes
+        for (NodeId id = 0; id < (NodeId)N; ++id) {
+            const auto& attr = graph.node(id);
+            const std::string_view key = graph.name(id);
+            GraphNode gn;
+            gn.id                = key;
+            gn.label             = key;
+            gn.account_type      = attr.is_business ? "business" : "individual";
+            gn.total_inflow      = attr.total_inflow;
+            gn.total_outflow     = attr.total_outflow;
+            gn.transaction_count = attr.transaction_count;
+            gn.suspicion_score   = scores[id];
+            gn.is_suspicious     = gn.suspicion_score >= SUSPICIOUS_SCORE;
+
+            // patterns = raw type per ring membership; detected_patterns = spec-format
+            const auto rings = index.rings(id);
+            gn.ring_ids.reserve(rings.size());
+            gn.patterns.reserve(rings.size());
+            for (DetectionIndex::RingId r : rings) {
+                gn.ring_ids.emplace_back(index.ring_id(r));
+                gn.patterns.emplace_back(index.ring_pattern(r));
+            }
+            gn.detected_patterns = index.spec_patterns(id);
+
+            gd.nodes.push_back(std::move(gn));
+        }
+
+        // Edges
+        for (EdgeId e = 0; e < (EdgeId)graph.edge_count(); ++e) {
+            const NodeId u = graph.edge_source(e), v = graph.edge_target(e);
+            const auto& agg = graph.agg_edge(e);
+
+            GraphEdge ge;
+            ge.source            = graph.name(u);
+            ge.target            = graph.name(v);
+            ge.total_amount      = agg.total_amount;
+            ge.transaction_count = agg.transaction_count;
+
+            // Mark suspicious if either endpoint is suspicious
+            ge.is_suspicious = (scores[u] >= SUSPICIOUS_SCORE || scores[v] >= SUSPICIOUS_SCORE);
+
+            // Determine pattern type from the source's first pattern
+            if (index.flagged(u)) ge.pattern_type = index.ring_pattern(index.rings(u).front());
+
+            gd.edges.push_back(std::move(ge));
+        }
+
+        return gd;
+    }
 };
 
 } // namespace mm
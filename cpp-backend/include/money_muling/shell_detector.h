@@ -4,207 +4,327 @@
 //
 // Finds chains of 3+ hops where intermediate accounts have very low
 // activity (<=3 total transactions), indicating pass-through behaviour.
-// Uses BFS path enumeration.  Mirrors Python shell_detector.py.
+// Mirrors Python shell_detector.py.
+//
+// Every intermediate of a valid chain must be a shell candidate that also
+// passes the inflow/outflow ratio test – a property of the node alone.
+// prepare() marks those "pass-through" nodes once, and the search walks
+// only the subgraph they induce: a chain is a source's edge into it, a
+// simple path inside it, and an edge out to a sink.  High-activity
+// intermediates are never expanded, so the caps only ever bound valid
+// chains.
+//
+//   • DFS over a shared path stack + on-path bitmap (no per-frame copies)
+//   • Per-source searches are independent and run in parallel on the
+//     shared ThreadPool
+//   • A CancelToken stops the search between batches, before each source
+//     and every CHECK_INTERVAL steps; the chains found so far are kept
 // ============================================================================
 
+#include "cancel_token.h"
 #include "graph_engine.h"
 #include "models.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <cmath>
-#include <queue>
+#include <cstdint>
+#include <optional>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace mm {
 
 class ShellDetector {
 public:
-    static constexpr int MAX_PATHS                     = 100;
-    static constexpr int DEFAULT_MAX_INTERMEDIATE_TXNS = 3;
-    static constexpr int DEFAULT_MIN_CHAIN_LENGTH      = 3;
-    static constexpr int DEFAULT_MAX_CHAIN_LENGTH      = 6;
+    static constexpr int    DEFAULT_MAX_CHAINS            = 5000;
+    static constexpr int    DEFAULT_MAX_INTERMEDIATE_TXNS = 3;
+    static constexpr int    DEFAULT_MIN_CHAIN_LENGTH      = 3;
+    static constexpr int    DEFAULT_MAX_CHAIN_LENGTH      = 6;
+    static constexpr double MIN_PASS_THROUGH_RATIO        = 0.5;
+    // Sources handed to the pool per round of collect()
+    static constexpr size_t SOURCE_BATCH = 512;
+
+    // Per-graph classification shared by every per-source search
+    struct Context {
+        std::vector<uint8_t> shell_candidate;   // low-activity node
+        std::vector<uint8_t> pass_through;      // candidate with inflow ≈ outflow
+        std::vector<uint8_t> is_sink;
+        std::vector<NodeId>  sources;
+        bool sources_fallback = false;          // no natural sources → all nodes
+        bool sinks_fallback   = false;          // no natural sinks → all nodes
+        int  min_chain_length = DEFAULT_MIN_CHAIN_LENGTH;
+        int  max_chain_length = DEFAULT_MAX_CHAIN_LENGTH;
+    };
+
+    // Per-thread scratch reused across sources (sized to the graph once)
+    struct Workspace {
+        std::vector<uint8_t>  on_path;
+        std::vector<NodeId>   path;
+        std::vector<uint32_t> cursor;   // next successor index per depth
+        std::vector<EdgeId>   edges;    // edges[i] = path[i] → path[i+1]
+        uint64_t              steps = 0;   // successor visits, summed per analysis
+
+        explicit Workspace(size_t nodes = 0) : on_path(nodes, 0) {}
+    };
 
     /**
      * Find layered shell networks – chains A→B→C→D where intermediate
-     * nodes (B, C) have very low total transaction counts.
+     * nodes (B, C) have very low total transaction counts and pass funds
+     * through.  At most max_chains are returned, in source order.  Sources
+     * are searched in parallel on `pool`; the result does not depend on
+     * its size.  Successor visits are added to `steps`, if given;
+     * `capped` is set to whether max_chains dropped a chain.  Once
+     * `cancel` requests a stop, the chains found so far are returned.
      */
-    static std::vector<ShellResult> detect(
+    static std::vector<DetectedShell> detect(
         const TransactionGraph& graph,
         int max_intermediate_txns = DEFAULT_MAX_INTERMEDIATE_TXNS,
         int min_chain_length      = DEFAULT_MIN_CHAIN_LENGTH,
-        int max_chain_length      = DEFAULT_MAX_CHAIN_LENGTH)
+        int max_chain_length      = DEFAULT_MAX_CHAIN_LENGTH,
+        int max_chains            = DEFAULT_MAX_CHAINS,
+        ThreadPool& pool          = ThreadPool::shared(),
+        uint64_t*   steps         = nullptr,
+        const CancelToken* cancel = nullptr,
+        bool*       capped        = nullptr)
     {
-        // Pre-compute node transaction counts
-        std::unordered_map<std::string, int> txn_counts;
-        for (const auto& [id, attr] : graph.all_nodes()) {
-            txn_counts[id] = attr.transaction_count;
-        }
+        if (capped) *capped = false;
+        auto ctx = prepare(graph, max_intermediate_txns,
+                           min_chain_length, max_chain_length);
+        if (!ctx) return {};
+
+        std::vector<Workspace> ws(pool.max_workers());
+        std::vector<std::vector<DetectedShell>> found(graph.node_count());
+        auto results = collect(*ctx, max_chains, pool,
+            [&](NodeId source, int limit, size_t worker) -> const std::vector<DetectedShell>& {
+                auto& out = found[source];
+                out.clear();
+                search_source(graph, *ctx, source, ws[worker], out, limit, cancel);
+                return out;
+            }, cancel, capped);
+        if (steps) for (const auto& w : ws) *steps += w.steps;
+        return results;
+    }
 
-        // Identify shell candidates (low-activity nodes with > 0 txns)
-        std::unordered_set<std::string> shell_candidates;
-        for (const auto& [id, cnt] : txn_counts) {
+    /**
+     * Classify candidates, pass-through nodes, sources and sinks.  Returns
+     * nullopt when no node can be an intermediate (nothing can be found).
+     */
+    static std::optional<Context> prepare(
+        const TransactionGraph& graph,
+        int max_intermediate_txns = DEFAULT_MAX_INTERMEDIATE_TXNS,
+        int min_chain_length      = DEFAULT_MIN_CHAIN_LENGTH,
+        int max_chain_length      = DEFAULT_MAX_CHAIN_LENGTH)
+    {
+        const NodeId N = (NodeId)graph.node_count();
+        Context ctx;
+        ctx.min_chain_length = min_chain_length;
+        ctx.max_chain_length = max_chain_length;
+
+        // Identify shell candidates (low-activity nodes with > 0 txns) and,
+        // among them, nodes whose inflow and outflow roughly match
+        ctx.shell_candidate.assign(N, 0);
+        ctx.pass_through.assign(N, 0);
+        bool any_pass_through = false;
+        for (NodeId id = 0; id < N; ++id) {
+            const auto& attr = graph.node(id);
+            int cnt = attr.transaction_count;
             if (cnt > 0 && cnt <= max_intermediate_txns) {
-                shell_candidates.insert(id);
+                ctx.shell_candidate[id] = 1;
+                if (passes_through(attr)) {
+                    ctx.pass_through[id] = 1;
+                    any_pass_through = true;
+                }
             }
         }
 
-        if (shell_candidates.empty()) return {};
+        if (!any_pass_through) return std::nullopt;
 
         // Find sources and sinks
-        std::vector<std::string> sources, sinks;
-        for (const auto& [id, _] : graph.all_nodes()) {
+        ctx.is_sink.assign(N, 0);
+        bool any_sink = false;
+        for (NodeId id = 0; id < N; ++id) {
             int in_d  = graph.in_degree(id);
             int out_d = graph.out_degree(id);
-            if (in_d == 0 || out_d > in_d) sources.push_back(id);
-            if (out_d == 0 || in_d > out_d) sinks.push_back(id);
+            if (in_d == 0 || out_d > in_d) ctx.sources.push_back(id);
+            if (out_d == 0 || in_d > out_d) { ctx.is_sink[id] = 1; any_sink = true; }
         }
 
         // Fallback
-        if (sources.empty()) {
-            for (const auto& [id, _] : graph.all_nodes()) sources.push_back(id);
+        if (ctx.sources.empty()) {
+            ctx.sources_fallback = true;
+            for (NodeId id = 0; id < N; ++id) ctx.sources.push_back(id);
         }
-        if (sinks.empty()) {
-            for (const auto& [id, _] : graph.all_nodes()) sinks.push_back(id);
+        if (!any_sink) {
+            ctx.sinks_fallback = true;
+            std::fill(ctx.is_sink.begin(), ctx.is_sink.end(), 1);
         }
+        return ctx;
+    }
 
-        // Convert sinks to set for O(1) lookup
-        std::unordered_set<std::string> sink_set(sinks.begin(), sinks.end());
-
-        std::vector<ShellResult> results;
-        std::unordered_set<std::string> seen_chains;
-        int ring_counter = 0;
-
-        for (const auto& source : sources) {
-            if (ring_counter >= MAX_PATHS) break;
-
-            // BFS for paths from source through shell candidates to sinks
-            // Stack: {node, path}
-            struct Frame {
-                std::string              node;
-                std::vector<std::string> path;
-            };
-
-            std::vector<Frame> stack;
-            stack.push_back({source, {source}});
-
-            int paths_from_source = 0;
-
-            while (!stack.empty() && ring_counter < MAX_PATHS) {
-                auto [curr, path] = std::move(stack.back());
-                stack.pop_back();
-
-                if ((int)path.size() > max_chain_length + 1) continue;
-                if (paths_from_source > 20) break; // safety cap per source
-
-                for (const auto& next : graph.successors(curr)) {
-                    // Check if already in path (simple path)
-                    bool in_path = false;
-                    for (const auto& p : path) {
-                        if (p == next) { in_path = true; break; }
-                    }
-                    if (in_path) continue;
-
-                    auto new_path = path;
-                    new_path.push_back(next);
-
-                    int edges = (int)new_path.size() - 1;
-
-                    // Check if this forms a valid shell chain to a sink
-                    if (edges >= min_chain_length && sink_set.count(next)) {
-                        auto chain_result = validate_shell_chain(
-                            graph, new_path, shell_candidates,
-                            seen_chains, ring_counter);
-                        if (chain_result.has_value()) {
-                            results.push_back(std::move(*chain_result));
-                            ++paths_from_source;
-                            if (ring_counter >= MAX_PATHS) break;
-                        }
-                    }
-
-                    // Continue exploring if not too long
-                    if (edges < max_chain_length) {
-                        stack.push_back({next, std::move(new_path)});
-                    }
-                }
+    /**
+     * Concatenate per-source chain lists in source order and stop at
+     * max_chains.
+     *
+     * source_chains(source, limit, worker) returns the chains found from
+     * `source` (at least the first `limit`); the list must stay valid
+     * until collect() returns.  Sources are searched concurrently in
+     * batches of SOURCE_BATCH, each with the limit left at the start of
+     * its batch, which yields the same prefix as a serial run.
+     * AnalysisSession serves cached lists for sources that cannot reach an
+     * appended transaction.  No batch starts once `cancel` requests a stop.
+     * As in CycleDetector::collect, limits are one more than still fits,
+     * so `capped` (if given) is set exactly when max_chains dropped a chain.
+     */
+    template <class SourceChains>
+    static std::vector<DetectedShell> collect(const Context& ctx, int max_chains,
+                                              ThreadPool& pool, SourceChains&& source_chains,
+                                              const CancelToken* cancel = nullptr,
+                                              bool*              capped = nullptr)
+    {
+        std::vector<DetectedShell> results;
+        std::vector<const std::vector<DetectedShell>*> batch;
+        bool dropped = false;
+        const size_t S = ctx.sources.size();
+        for (size_t begin = 0; begin < S && !dropped; begin += SOURCE_BATCH) {
+            const int limit = max_chains - (int)results.size() + 1;
+            if (stop_requested(cancel)) break;
+            batch.assign(std::min(SOURCE_BATCH, S - begin), nullptr);
+            pool.parallel_for(batch.size(), [&](size_t i, size_t worker) {
+                batch[i] = &source_chains(ctx.sources[begin + i], limit, worker);
+            });
+            for (const auto* found : batch) {
+                const size_t room = (size_t)max_chains - results.size();
+                const size_t take = std::min(found->size(), room);
+                results.insert(results.end(), found->begin(), found->begin() + take);
+                if (take < found->size()) dropped = true;
             }
         }
-
+        if (capped) *capped = dropped;
         return results;
     }
 
-private:
-    static std::optional<ShellResult> validate_shell_chain(
-        const TransactionGraph& graph,
-        const std::vector<std::string>& path,
-        const std::unordered_set<std::string>& shell_candidates,
-        std::unordered_set<std::string>& seen_chains,
-        int& ring_counter)
-    {
-        // Extract intermediates (exclude first and last)
-        std::vector<std::string> intermediates(path.begin() + 1, path.end() - 1);
-        if (intermediates.empty()) return std::nullopt;
-
-        // All intermediates must be shell candidates
-        for (const auto& n : intermediates) {
-            if (!shell_candidates.count(n)) return std::nullopt;
-        }
+    /**
+     * Name a detected chain for output (ring_id is left to the caller,
+     * see AnalysisEngine::assemble).
+     */
+    static ShellResult to_result(const TransactionGraph& graph, const DetectedShell& s) {
+        ShellResult sr;
+        sr.pattern_type = "shell";
+        sr.chain.reserve(s.chain.size());
+        for (NodeId n : s.chain) sr.chain.emplace_back(graph.name(n));
+        sr.intermediate_accounts.assign(sr.chain.begin() + 1, sr.chain.end() - 1);
+        sr.total_amount = s.total_amount;
+        sr.shell_depth  = s.shell_depth();
+        sr.risk_score   = 0.0; // Calculated later by scoring engine
+        return sr;
+    }
 
-        // Build chain key for deduplication
-        std::string chain_key;
-        for (const auto& n : path) {
-            if (!chain_key.empty()) chain_key += "→";
-            chain_key += n;
-        }
-        if (!seen_chains.insert(chain_key).second) return std::nullopt;
-
-        // Verify pass-through: inflow ≈ outflow for intermediates
-        for (const auto& inode : intermediates) {
-            const auto& attr = graph.node(inode);
-            double inflow  = attr.total_inflow;
-            double outflow = attr.total_outflow;
-            if (inflow > 0 && outflow > 0) {
-                double ratio = std::min(inflow, outflow) / std::max(inflow, outflow);
-                if (ratio < 0.5) return std::nullopt;
-            } else {
-                return std::nullopt;
+    /**
+     * Enumerate chains source → pass-through nodes → sink and append at
+     * most `limit` to out.  Only pass-through nodes are ever pushed on
+     * the path, so the walk stays inside the induced subgraph; sinks are
+     * attached from each intermediate's row.  Stops early (keeping what it
+     * appended) once `cancel` requests a stop.
+     */
+    static void search_source(
+        const TransactionGraph&   graph,
+        const Context&            ctx,
+        NodeId                    source,
+        Workspace&                ws,
+        std::vector<DetectedShell>& out,
+        int                       limit,
+        const CancelToken*        cancel = nullptr)
+    {
+        if (limit <= 0 || stop_requested(cancel)) return;
+        if (ws.on_path.size() < graph.node_count())
+            ws.on_path.resize(graph.node_count(), 0);
+
+        auto& path   = ws.path;
+        auto& cursor = ws.cursor;
+        auto& edges  = ws.edges;
+        path.assign(1, source);
+        cursor.assign(1, 0);
+        edges.clear();
+        ws.on_path[source] = 1;
+
+        int      found = 0;
+        uint64_t steps = 0;
+
+        while (!path.empty()) {
+            const NodeId u    = path.back();
+            const auto   succ = graph.successors(u);
+            uint32_t&    idx  = cursor.back();
+
+            if (idx == succ.size()) {
+                // Row exhausted – backtrack
+                ws.on_path[u] = 0;
+                path.pop_back();
+                cursor.pop_back();
+                if (!edges.empty()) edges.pop_back();
+                continue;
             }
-        }
 
-        // Calculate total amount through chain
-        double total_amount = chain_amount(graph, path);
+            const EdgeId e    = graph.first_out_edge(u) + idx;
+            const NodeId next = succ[idx++];
+            if (++steps % CancelToken::CHECK_INTERVAL == 0 && stop_requested(cancel)) break;
+            if (ws.on_path[next]) continue;
 
-        ++ring_counter;
+            const int hops = (int)path.size();   // edges once next is added
 
-        ShellResult sr;
-        sr.ring_id               = "RING_" + pad3(ring_counter);
-        sr.pattern_type          = "shell";
-        sr.chain                 = path;
-        sr.intermediate_accounts = intermediates;
-        sr.total_amount          = std::round(total_amount * 100.0) / 100.0;
-        sr.shell_depth           = (int)intermediates.size();
-        sr.risk_score            = 0.0; // Calculated later by scoring engine
-        return sr;
-    }
+            // Exit to a sink (needs at least one intermediate)
+            if (path.size() >= 2 && hops >= ctx.min_chain_length && ctx.is_sink[next]) {
+                edges.push_back(e);
+                out.push_back(make_chain(graph, path, next, edges));
+                edges.pop_back();
+                if (++found >= limit) break;
+            }
 
-    static double chain_amount(const TransactionGraph& graph,
-                                const std::vector<std::string>& path) {
-        double total = 0.0;
-        for (size_t i = 0; i + 1 < path.size(); ++i) {
-            const auto& txns = graph.edge_transactions(path[i], path[i + 1]);
-            for (const auto& [amt, _] : txns) {
-                total += amt;
+            // Extend through the pass-through subgraph
+            if (ctx.pass_through[next] && hops < ctx.max_chain_length) {
+                path.push_back(next);
+                cursor.push_back(0);
+                edges.push_back(e);
+                ws.on_path[next] = 1;
             }
         }
-        return total;
+
+        // Leave the bitmap clean for the next source
+        for (NodeId n : path) ws.on_path[n] = 0;
+        path.clear();
+        cursor.clear();
+        edges.clear();
+        ws.steps += steps;
     }
 
-    static std::string pad3(int n) {
-        char buf[8];
-        snprintf(buf, sizeof(buf), "%03d", n);
-        return std::string(buf);
+private:
+    // Verify pass-through: inflow ≈ outflow
+    static bool passes_through(const NodeAttr& attr) {
+        double inflow  = attr.total_inflow;
+        double outflow = attr.total_outflow;
+        if (inflow <= 0 || outflow <= 0) return false;
+        double ratio = std::min(inflow, outflow) / std::max(inflow, outflow);
+        return ratio >= MIN_PASS_THROUGH_RATIO;
+    }
+
+    // Build the result for path + sink; edges[i] = chain[i] → chain[i+1]
+    static DetectedShell make_chain(
+        const TransactionGraph&    graph,
+        const std::vector<NodeId>& path,
+        NodeId                     sink,
+        const std::vector<EdgeId>& edges)
+    {
+        // Calculate total amount through chain
+        double total_amount = 0.0;
+        for (EdgeId e : edges)
+            for (double amt : graph.edge_amounts(e)) total_amount += amt;
+
+        DetectedShell ds;
+        ds.chain.reserve(path.size() + 1);
+        ds.chain.assign(path.begin(), path.end());
+        ds.chain.push_back(sink);
+        ds.total_amount = std::round(total_amount * 100.0) / 100.0;
+        return ds;
     }
 };
 
@@ -6,21 +6,32 @@
 // Fan-out: sender with >=10 unique receivers within a configured window.
 //
 // Performance optimisations:
-//   • Uses RedBlackTree for O(log n) time-range queries per account
-//   • Pre-groups transaction indices by account using unordered_map
-//   • Inner sliding window uses a deque + hash set for O(1) amortised ops
-//   • Sorts once globally, reuses sorted order for all accounts
+//   • Per-account transactions come from the graph's CSR rows (NodeIds);
+//     edge slices are already time-sorted, so an account's sweep order is
+//     a merge of its rows
+//   • Fan-in and fan-out are scanned in the same pass over accounts,
+//     sharing one Workspace
+//   • Accounts with fewer distinct counterparties than the threshold skipped
+//   • Inner sliding window counts counterparties in an epoch-stamped array
+//     indexed by NodeId – O(1) ops, no hashing, no per-account allocation
+//   • The per-account scan is a template on the direction, so fan-in and
+//     fan-out each get their own branch-free instantiation
+//   • A CancelToken is polled every CHECK_INTERVAL accounts; accounts
+//     scanned so far keep their results
 // ============================================================================
 
+#include "cancel_token.h"
+#include "graph_engine.h"
 #include "models.h"
-#include "red_black_tree.h"
 
 #include <algorithm>
 #include <chrono>
-#include <deque>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <optional>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 namespace mm {
@@ -30,142 +41,225 @@ public:
     static constexpr int    DEFAULT_FAN_THRESHOLD = 10;
     static constexpr double DEFAULT_WINDOW_HRS    = 72.0;
 
+    struct Entry {
+        TimePoint timestamp;
+        NodeId    counterparty;
+        double    amount;
+    };
+
+    // Scratch reused across accounts (sized to the graph on first use).
+    // count[cp] is only meaningful while stamp[cp] == epoch, so starting
+    // a new account is a single increment instead of a clear.
+    struct Workspace {
+        std::vector<Entry>    entries;
+        std::vector<size_t>   runs;     // entries offset where each edge starts
+        std::vector<int>      count;
+        std::vector<uint32_t> stamp;
+        uint32_t              epoch = 0;
+
+        explicit Workspace(size_t nodes = 0) : count(nodes, 0), stamp(nodes, 0) {}
+    };
+
     /**
      * Detect fan-in and fan-out smurfing patterns.
      *
-     * Uses a globally-sorted index + per-account sliding window for
-     * O(N log N) overall complexity (vs original O(N²) per account window).
-     * RedBlackTree provides the sorted timestamp index.
+     * Each account's incoming / outgoing transactions are read straight
+     * from the graph's CSR rows (interned counterparty IDs), ordered by
+     * timestamp, then scanned with an O(n) sliding window.  Once `cancel`
+     * requests a stop, the patterns found so far are returned.
      */
-    static std::vector<SmurfingResult> detect(
-        const std::vector<Transaction>& txns,
-        int    fan_threshold = DEFAULT_FAN_THRESHOLD,
-        double window_hours  = DEFAULT_WINDOW_HRS)
+    static std::vector<DetectedSmurfing> detect(
+        const TransactionGraph& graph,
+        int    fan_threshold      = DEFAULT_FAN_THRESHOLD,
+        double window_hours       = DEFAULT_WINDOW_HRS,
+        const CancelToken* cancel = nullptr)
     {
-        if (txns.empty()) return {};
-
-        std::vector<SmurfingResult> results;
-
-        // Build RBT over all transactions (sorted by timestamp)
-        RedBlackTree rbt;
-        for (const auto& t : txns)
-            rbt.insert(t);
-
-        // Get all transactions in timestamp order via RBT in-order traversal
-        auto sorted_ptrs = rbt.all();  // O(N), already sorted
-
-        // Build sorted index array (indices into txns)
-        std::vector<size_t> sorted_idx;
-        sorted_idx.reserve(sorted_ptrs.size());
-        // Map pointer back to index (needed for fan detection referencing txns[])
-        std::unordered_map<const Transaction*, size_t> ptr_to_idx;
-        ptr_to_idx.reserve(txns.size());
-        for (size_t i = 0; i < txns.size(); ++i)
-            ptr_to_idx[&txns[i]] = i;
-
-        for (const auto* p : sorted_ptrs)
-            sorted_idx.push_back(ptr_to_idx[p]);
+        if (graph.node_count() == 0) return {};
 
         auto window_dur = std::chrono::duration_cast<std::chrono::system_clock::duration>(
             std::chrono::duration<double, std::ratio<3600>>(window_hours));
 
-        // Fan-in:  group by receiver, sliding window over counterparty senders
-        detect_fan_opt(txns, sorted_idx, results, fan_threshold, window_dur, false);
+        // One pass: fan-in groups by receiver (counterparties = senders),
+        // fan-out by sender (counterparties = receivers).  Fan-in results
+        // are reported first.
+        std::vector<DetectedSmurfing> results, fan_out;
+        Workspace ws(graph.node_count());
+        for (NodeId acct = 0; acct < (NodeId)graph.node_count(); ++acct) {
+            if (acct % CancelToken::CHECK_INTERVAL == 0 && stop_requested(cancel)) break;
+            if (auto sr = scan_account<false>(graph, acct, fan_threshold, window_dur, ws))
+                results.push_back(std::move(*sr));
+            if (auto sr = scan_account<true>(graph, acct, fan_threshold, window_dur, ws))
+                fan_out.push_back(std::move(*sr));
+        }
+        results.insert(results.end(), std::make_move_iterator(fan_out.begin()),
+                       std::make_move_iterator(fan_out.end()));
+        return results;
+    }
 
-        // Fan-out: group by sender, sliding window over counterparty receivers
-        detect_fan_opt(txns, sorted_idx, results, fan_threshold, window_dur, true);
+    /**
+     * Fan-in (group_by_sender = false) or fan-out pattern for one account.
+     * An account's result depends only on its own in/out transactions, so
+     * AnalysisSession re-runs this just for accounts touched by an append,
+     * passing one Workspace for all of them.
+     */
+    static std::optional<DetectedSmurfing> detect_account(
+        const TransactionGraph& graph,
+        NodeId                  acct,
+        bool                    group_by_sender,
+        Workspace&              ws,
+        int    fan_threshold = DEFAULT_FAN_THRESHOLD,
+        double window_hours  = DEFAULT_WINDOW_HRS)
+    {
+        auto window_dur = std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::duration<double, std::ratio<3600>>(window_hours));
+        return group_by_sender
+            ? scan_account<true>(graph, acct, fan_threshold, window_dur, ws)
+            : scan_account<false>(graph, acct, fan_threshold, window_dur, ws);
+    }
 
-        return results;
+    /**
+     * Name a detected pattern for output (ring_id is left to the caller,
+     * see AnalysisEngine::assemble).
+     */
+    static SmurfingResult to_result(const TransactionGraph& graph, const DetectedSmurfing& s) {
+        SmurfingResult sr;
+        sr.account_id            = std::string(graph.name(s.account));
+        sr.pattern_type          = pattern_to_string(s.pattern);
+        sr.unique_counterparties = s.unique_counterparties;
+        sr.total_amount          = s.total_amount;
+        sr.velocity_per_hour     = s.velocity_per_hour;
+        sr.window_start          = timepoint_to_iso(s.window_start);
+        sr.window_end            = timepoint_to_iso(s.window_end);
+        return sr;
     }
 
 private:
     /**
-     * Optimised fan detection using a proper O(N) per-account sliding window.
-     *
-     * Key: instead of rebuilding the counterparty set on every right-pointer
-     * move (O(window_size)), we maintain a count map.  Adding/removing a
-     * counterparty is O(1).  Total complexity per account = O(txns_for_account).
+     * O(n) sliding window over one account's transactions in time order.
+     * Adding / removing a counterparty is O(1) via ws.count, so the cost
+     * per account is O(txns_for_account) after merging its rows.
+     * GroupBySender: fan-out (counterparties = receivers), else fan-in.
      */
-    static void detect_fan_opt(
-        const std::vector<Transaction>& txns,
-        const std::vector<size_t>&      sorted_idx,
-        std::vector<SmurfingResult>&    results,
-        int                             threshold,
+    template <bool GroupBySender>
+    static std::optional<DetectedSmurfing> scan_account(
+        const TransactionGraph&             graph,
+        NodeId                              acct,
+        int                                 threshold,
         std::chrono::system_clock::duration window,
-        bool                            group_by_sender)
+        Workspace&                          ws)
     {
-        // Group indices by account (in sorted order → already sorted per account)
-        std::unordered_map<std::string, std::vector<size_t>> groups;
-        groups.reserve(256);
-        for (auto idx : sorted_idx) {
-            const auto& key = group_by_sender ? txns[idx].sender : txns[idx].receiver;
-            groups[key].push_back(idx);
+        // Degree bounds unique counterparties – skip hopeless accounts
+        int degree = GroupBySender ? graph.out_degree(acct) : graph.in_degree(acct);
+        if (degree < threshold) return std::nullopt;
+
+        if (ws.count.size() < graph.node_count()) {
+            ws.count.resize(graph.node_count(), 0);
+            ws.stamp.resize(graph.node_count(), 0);
+        }
+        if (++ws.epoch == 0) {                    // wrapped – invalidate all
+            std::fill(ws.stamp.begin(), ws.stamp.end(), 0);
+            ws.epoch = 1;
         }
+        const uint32_t epoch = ws.epoch;
+        auto counter = [&](NodeId cp) -> int& {
+            if (ws.stamp[cp] != epoch) { ws.stamp[cp] = epoch; ws.count[cp] = 0; }
+            return ws.count[cp];
+        };
+
+        auto& entries = ws.entries;
+        auto& runs    = ws.runs;
+        entries.clear();
+        runs.clear();
+        auto gather = [&](EdgeId e, NodeId cp) {
+            runs.push_back(entries.size());
+            auto amts = graph.edge_amounts(e);
+            auto tss  = graph.edge_timestamps(e);
+            for (size_t k = 0; k < amts.size(); ++k)
+                entries.push_back({tss[k], cp, amts[k]});
+        };
+        if constexpr (GroupBySender) {
+            EdgeId e = graph.first_out_edge(acct);
+            for (NodeId cp : graph.successors(acct)) gather(e++, cp);
+        } else {
+            for (EdgeId e : graph.in_edges(acct)) gather(e, graph.edge_source(e));
+        }
+        merge_runs(entries, runs);
+
+        const int n = (int)entries.size();
+
+        // Sliding window with counterparty frequency counts
+        int unique_in_window = 0;
+        double total_in_window = 0.0;
+
+        int best_unique = 0;
+        TimePoint best_start{};
+        TimePoint best_end{};
+        double best_total = 0.0;
 
-        for (const auto& [acct, indices] : groups) {
-            const int n = (int)indices.size();
-            if (n < threshold) continue;
-
-            // Sliding window with counterparty frequency map
-            // Allows O(1) unique-count maintenance
-            std::unordered_map<std::string, int> cp_count;
-            cp_count.reserve(threshold * 2);
-            int unique_in_window = 0;
-            double total_in_window = 0.0;
-
-            int best_unique = 0;
-            TimePoint best_start{};
-            TimePoint best_end{};
-            double best_total = 0.0;
-
-            int left = 0;
-            for (int right = 0; right < n; ++right) {
-                // Add right element
-                const auto& rt = txns[indices[right]];
-                const auto& rcp = group_by_sender ? rt.receiver : rt.sender;
-                int& cnt = cp_count[rcp];
-                if (cnt == 0) ++unique_in_window;
-                ++cnt;
-                total_in_window += rt.amount;
-
-                // Shrink left so window fits
-                while (left < right &&
-                       (rt.timestamp - txns[indices[left]].timestamp) > window) {
-                    const auto& lt  = txns[indices[left]];
-                    const auto& lcp = group_by_sender ? lt.receiver : lt.sender;
-                    int& lc = cp_count[lcp];
-                    --lc;
-                    if (lc == 0) --unique_in_window;
-                    total_in_window -= lt.amount;
-                    ++left;
-                }
-
-                if (unique_in_window > best_unique) {
-                    best_unique = unique_in_window;
-                    best_start  = txns[indices[left]].timestamp;
-                    best_end    = rt.timestamp;
-                    best_total  = total_in_window;
-                }
+        int left = 0;
+        for (int right = 0; right < n; ++right) {
+            // Add right element
+            const auto& rt = entries[right];
+            int& cnt = counter(rt.counterparty);
+            if (cnt == 0) ++unique_in_window;
+            ++cnt;
+            total_in_window += rt.amount;
+
+            // Shrink left so window fits
+            while (left < right &&
+                   (rt.timestamp - entries[left].timestamp) > window) {
+                const auto& lt = entries[left];
+                int& lc = counter(lt.counterparty);
+                --lc;
+                if (lc == 0) --unique_in_window;
+                total_in_window -= lt.amount;
+                ++left;
+            }
+
+            if (unique_in_window > best_unique) {
+                best_unique = unique_in_window;
+                best_start  = entries[left].timestamp;
+                best_end    = rt.timestamp;
+                best_total  = total_in_window;
             }
+        }
+
+        if (best_unique < threshold) return std::nullopt;
 
-            if (best_unique >= threshold) {
-                using namespace std::chrono;
-                double hours_span = std::max(
-                    duration_cast<duration<double, std::ratio<3600>>>(best_end - best_start).count(),
-                    1.0);
-
-                SmurfingResult sr;
-                sr.account_id            = acct;
-                sr.pattern_type          = group_by_sender ? "fan_out" : "fan_in";
-                sr.unique_counterparties  = best_unique;
-                sr.total_amount          = std::round(best_total * 100.0) / 100.0;
-                sr.velocity_per_hour     = std::round((best_total / hours_span) * 100.0) / 100.0;
-                sr.window_start          = timepoint_to_iso(best_start);
-                sr.window_end            = timepoint_to_iso(best_end);
-                // ring_id generated later in pipeline; use account as placeholder
-                sr.ring_id               = "SMURF_" + acct.substr(0, std::min((int)acct.size(), 8));
-                results.push_back(std::move(sr));
+        using namespace std::chrono;
+        double hours_span = std::max(
+            duration_cast<duration<double, std::ratio<3600>>>(best_end - best_start).count(),
+            1.0);
+
+        DetectedSmurfing ds;
+        ds.account               = acct;
+        ds.pattern               = GroupBySender ? PatternType::FAN_OUT : PatternType::FAN_IN;
+        ds.unique_counterparties = best_unique;
+        ds.total_amount          = std::round(best_total * 100.0) / 100.0;
+        ds.velocity_per_hour     = std::round((best_total / hours_span) * 100.0) / 100.0;
+        ds.window_start          = best_start;
+        ds.window_end            = best_end;
+        return ds;
+    }
+
+    /**
+     * Each edge's slice is already in timestamp order; merge the runs
+     * pairwise (O(n log runs)).  inplace_merge is stable, so ties keep
+     * row order then input order – the same as a stable sort by time.
+     */
+    static void merge_runs(std::vector<Entry>& entries, std::vector<size_t>& runs) {
+        auto by_time = [](const Entry& a, const Entry& b) { return a.timestamp < b.timestamp; };
+        runs.push_back(entries.size());
+        while (runs.size() > 2) {
+            size_t out = 0;
+            for (size_t i = 0; i + 2 < runs.size(); i += 2) {
+                std::inplace_merge(entries.begin() + runs[i], entries.begin() + runs[i + 1],
+                                   entries.begin() + runs[i + 2], by_time);
+                runs[out++] = runs[i];
             }
+            if (runs.size() % 2 == 0) runs[out++] = runs[runs.size() - 2];
+            runs[out++] = runs.back();
+            runs.resize(out);
         }
     }
 
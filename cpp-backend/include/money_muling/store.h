@@ -3,27 +3,122 @@
 // Store – in-memory analysis result storage + optional Redis persistence
 //
 // Thread-safe storage for analysis results.  When ENABLE_REDIS is defined
-// and Redis is reachable, results are also persisted to Redis so they
-// survive process restarts.
+// and Redis is reachable, results are also persisted to Redis (see
+// redis_backend.h) so they survive process restarts and are visible to
+// every replica: a local miss falls back to Redis, and finished results
+// found there are cached locally.
+//
+// Results are immutable once stored: put() wraps them in a
+// shared_ptr<const AnalysisResult> and get() hands out that pointer, so a
+// poll never copies the payload.  The status and progress live beside the
+// payload in atomics, so update_status() / update_progress() never touch
+// (or copy) the result.
+//
+// IDs hash to one of SHARDS shards, each behind its own shared_mutex;
+// reads take the shared lock only.  Finished results (completed / failed)
+// expire `ttl` after they were stored, and when a shard's estimated size
+// exceeds its share of the memory budget the least recently read finished
+// results are evicted.  Pending / processing entries are never evicted.
+//
+// Finished results also get their GET bodies serialised once, at put()
+// time on the analysis thread (see response_body.h), and completed ones a
+// ResultIndex for filtered queries (see result_index.h); both count
+// against the budget too.  Finished results put() here are also folded
+// into the process metrics (see metrics.h).
 // ============================================================================
 
 #include "models.h"
 #include "json_serializer.h"
+#include "metrics.h"
+#include "response_body.h"
+#include "result_index.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 // Optional Redis support via hiredis
 #ifdef ENABLE_REDIS
-#include <hiredis/hiredis.h>
+#include "redis_backend.h"
 #endif
 
 namespace mm {
 
+// A stored result: the current status plus the payload as last put.  The
+// payload's own `status` may lag (e.g. a session re-queued by an append);
+// `status` and `progress` are authoritative.
+struct StoredResult {
+    AnalysisStatus                        status = AnalysisStatus::PENDING;
+    double                                progress = 0.0;
+    std::shared_ptr<const AnalysisResult> result;
+    std::shared_ptr<const ResponseBodies> bodies;   // finished results only
+    std::shared_ptr<const ResultIndex>    index;    // completed results only
+
+    // Cached bodies, if they still describe `status`
+    const ResponseBodies* cached() const {
+        return bodies && result->status == status ? bodies.get() : nullptr;
+    }
+
+    // Query index, if it still describes `status`
+    const ResultIndex* indexed() const {
+        return index && result->status == status ? index.get() : nullptr;
+    }
+
+    explicit operator bool() const { return result != nullptr; }
+};
+
+/**
+ * Rough heap footprint of a result (strings and vectors by capacity),
+ * used only for the store's memory budget.
+ */
+inline size_t approx_bytes(const AnalysisResult& r) {
+    auto str  = [](const std::string& s) { return sizeof(s) + s.capacity(); };
+    auto strs = [&](const std::vector<std::string>& v) {
+        size_t n = (v.capacity() - v.size()) * sizeof(std::string);
+        for (const auto& s : v) n += str(s);
+        return n;
+    };
+    size_t n = sizeof(r) + r.analysis_id.capacity() + r.error.capacity();
+    for (const auto& a : r.suspicious_accounts)
+        n += sizeof(a) + a.account_id.capacity() + a.ring_id.capacity()
+           + a.account_type.capacity() + strs(a.detected_patterns)
+           + strs(a.connected_accounts) + strs(a.ring_ids);
+    for (const auto& f : r.fraud_rings)
+        n += sizeof(f) + f.ring_id.capacity() + f.pattern_type.capacity()
+           + strs(f.member_accounts);
+    for (const auto& c : r.cycles)
+        n += sizeof(c) + c.ring_id.capacity() + c.pattern_type.capacity() + strs(c.nodes);
+    for (const auto& m : r.smurfing)
+        n += sizeof(m) + m.account_id.capacity() + m.pattern_type.capacity()
+           + m.window_start.capacity() + m.window_end.capacity() + m.ring_id.capacity();
+    for (const auto& sh : r.shells)
+        n += sizeof(sh) + sh.ring_id.capacity() + sh.pattern_type.capacity()
+           + strs(sh.chain) + strs(sh.intermediate_accounts);
+    for (const auto& g : r.graph_data.nodes)
+        n += sizeof(g) + g.id.capacity() + g.label.capacity() + g.account_type.capacity()
+           + strs(g.ring_ids) + strs(g.patterns) + strs(g.detected_patterns);
+    for (const auto& e : r.graph_data.edges)
+        n += sizeof(e) + e.source.capacity() + e.target.capacity() + e.pattern_type.capacity();
+    return n;
+}
+
 class Store {
 public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t               SHARDS                = 16;
+    static constexpr size_t               DEFAULT_MEMORY_BUDGET = size_t(1) << 30;  // 1 GiB
+    static constexpr std::chrono::seconds DEFAULT_TTL{24 * 3600};                   // = Redis EX
 
     // Singleton access
     static Store& instance() {
@@ -31,54 +126,120 @@ public:
         return s;
     }
 
+    // Budget in bytes, split evenly over the shards; call before serving
+    void configure(size_t memory_budget, std::chrono::seconds ttl = DEFAULT_TTL) {
+        shard_budget_ = std::max<size_t>(memory_budget / SHARDS, 1);
+        ttl_          = ttl;
+    }
+
     // Store a result (thread-safe)
     void put(const std::string& id, AnalysisResult result) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        results_[id] = std::move(result);
+        put(id, std::make_shared<const AnalysisResult>(std::move(result)));
+    }
+
+    void put(const std::string& id, std::shared_ptr<const AnalysisResult> result) {
+        const bool finished = result->status == AnalysisStatus::COMPLETED ||
+                              result->status == AnalysisStatus::FAILED;
+        const auto t0 = Clock::now();
+        store_local(id, result);
+        if (finished)   // bodies + index were built in store_local
+            Metrics::instance().record(
+                *result, std::chrono::duration<double>(Clock::now() - t0).count());
 
 #ifdef ENABLE_REDIS
-        persist_to_redis(id);
+        redis_.persist(id, std::move(result), ttl_);
 #endif
     }
 
-    // Update status only (for PENDING → PROCESSING transitions)
-    void update_status(const std::string& id, AnalysisStatus status) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        auto it = results_.find(id);
-        if (it != results_.end()) {
-            it->second.status = status;
-        }
+    // Update status only (for PENDING → PROCESSING transitions); returns
+    // the previous status, if the result exists
+    std::optional<AnalysisStatus> update_status(const std::string& id,
+                                                AnalysisStatus status) {
+        Shard& sh = shard(id);
+        std::shared_lock<std::shared_mutex> lock(sh.mtx);
+        auto it = sh.entries.find(id);
+        if (it == sh.entries.end()) return std::nullopt;
+        return it->second.status.exchange(status);
     }
 
-    // Retrieve a result (thread-safe)
-    std::optional<AnalysisResult> get(const std::string& id) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        auto it = results_.find(id);
-        if (it != results_.end()) {
-            return it->second;
+    // Progress (0..1) of a running analysis, as reported by the engine;
+    // false if the result does not exist
+    bool update_progress(const std::string& id, double progress) {
+        Shard& sh = shard(id);
+        std::shared_lock<std::shared_mutex> lock(sh.mtx);
+        auto it = sh.entries.find(id);
+        if (it == sh.entries.end()) return false;
+        it->second.progress.store(progress, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Retrieve a result (thread-safe, no copy of the payload)
+    StoredResult get(const std::string& id) {
+        const auto now = Clock::now();
+        {
+            Shard& sh = shard(id);
+            std::shared_lock<std::shared_mutex> lock(sh.mtx);
+            auto it = sh.entries.find(id);
+            if (it != sh.entries.end() && !expired(it->second, now)) {
+                it->second.last_read.store(now.time_since_epoch().count(),
+                                           std::memory_order_relaxed);
+                return {it->second.status.load(),
+                        it->second.progress.load(std::memory_order_relaxed),
+                        it->second.result, it->second.bodies, it->second.index};
+            }
         }
 
 #ifdef ENABLE_REDIS
-        // Try loading from Redis
-        if (load_from_redis(id)) {
-            auto it2 = results_.find(id);
-            if (it2 != results_.end()) return it2->second;
+        // Another replica (or a previous run) may have stored it.  Only
+        // finished results are cached: a pending one will still change.
+        if (auto r = redis_.load(id)) {
+            if (r->status == AnalysisStatus::COMPLETED || r->status == AnalysisStatus::FAILED)
+                return store_local(id, std::move(r));
+            const double progress = r->progress;
+            return {r->status, progress, std::move(r), nullptr, nullptr};
         }
 #endif
 
-        return std::nullopt;
+        return {};
+    }
+
+    // Drop a result (e.g. a PENDING entry whose job was never admitted, or
+    // a DELETEd analysis), here and in Redis
+    void remove(const std::string& id) {
+#ifdef ENABLE_REDIS
+        redis_.erase(id);
+#endif
+        Shard& sh = shard(id);
+        std::unique_lock<std::shared_mutex> lock(sh.mtx);
+        auto it = sh.entries.find(id);
+        if (it == sh.entries.end()) return;
+        sh.bytes -= it->second.bytes;
+        sh.entries.erase(it);
     }
 
     // Check existence
     bool exists(const std::string& id) {
-        std::lock_guard<std::mutex> lock(mtx_);
-        return results_.count(id) > 0;
+        return (bool)get(id);
     }
 
     // Number of stored analyses
     size_t size() {
-        std::lock_guard<std::mutex> lock(mtx_);
-        return results_.size();
+        size_t n = 0;
+        for (auto& sh : shards_) {
+            std::shared_lock<std::shared_mutex> lock(sh.mtx);
+            n += sh.entries.size();
+        }
+        return n;
+    }
+
+    // Estimated bytes held (see approx_bytes)
+    size_t memory_bytes() {
+        size_t n = 0;
+        for (auto& sh : shards_) {
+            std::shared_lock<std::shared_mutex> lock(sh.mtx);
+            n += sh.bytes;
+        }
+        return n;
     }
 
 #ifdef ENABLE_REDIS
@@ -87,73 +248,114 @@ public:
                          int port = 6379,
                          int db = 0)
     {
-        redis_host_ = host;
-        redis_port_ = port;
-        redis_db_   = db;
+        redis_.configure(host, port, db);
     }
 #endif
 
 private:
+    struct Entry {
+        std::atomic<AnalysisStatus>           status{AnalysisStatus::PENDING};
+        std::atomic<double>                   progress{0.0};
+        std::shared_ptr<const AnalysisResult> result;
+        std::shared_ptr<const ResponseBodies> bodies;
+        std::shared_ptr<const ResultIndex>    index;
+        size_t                                bytes = 0;
+        Clock::time_point                     stored{};
+        std::atomic<Clock::rep>               last_read{0};   // written under the shared lock
+    };
+
+    struct Shard {
+        std::shared_mutex                      mtx;
+        std::unordered_map<std::string, Entry> entries;
+        size_t                                 bytes = 0;
+    };
+
     Store() = default;
     Store(const Store&) = delete;
     Store& operator=(const Store&) = delete;
 
-    std::mutex mtx_;
-    std::unordered_map<std::string, AnalysisResult> results_;
+    std::array<Shard, SHARDS> shards_;
+    size_t                    shard_budget_ = DEFAULT_MEMORY_BUDGET / SHARDS;
+    std::chrono::seconds      ttl_          = DEFAULT_TTL;
 
-#ifdef ENABLE_REDIS
-    std::string redis_host_ = "127.0.0.1";
-    int redis_port_ = 6379;
-    int redis_db_   = 0;
-
-    redisContext* connect_redis() {
-        redisContext* ctx = redisConnect(redis_host_.c_str(), redis_port_);
-        if (ctx == nullptr || ctx->err) {
-            if (ctx) redisFree(ctx);
-            return nullptr;
+    // Insert / replace locally (no Redis write)
+    StoredResult store_local(const std::string& id,
+                             std::shared_ptr<const AnalysisResult> result) {
+        std::shared_ptr<const ResponseBodies> bodies;
+        if (result->status == AnalysisStatus::COMPLETED ||
+            result->status == AnalysisStatus::FAILED)
+            bodies = ResponseBodies::build(*result);
+        std::shared_ptr<const ResultIndex> index;
+        if (result->status == AnalysisStatus::COMPLETED)
+            index = std::make_shared<const ResultIndex>(result);
+        const size_t bytes = approx_bytes(*result) + (bodies ? bodies->bytes() : 0)
+                           + (index ? index->bytes() : 0);
+        const auto   now   = Clock::now();
+        Shard& sh = shard(id);
+        {
+            std::unique_lock<std::shared_mutex> lock(sh.mtx);
+            Entry& e = sh.entries.try_emplace(id).first->second;
+            sh.bytes += bytes;
+            sh.bytes -= e.bytes;
+            e.status.store(result->status);
+            e.progress.store(result->progress, std::memory_order_relaxed);
+            e.result = std::move(result);
+            e.bodies = std::move(bodies);
+            e.index  = std::move(index);
+            e.bytes  = bytes;
+            e.stored = now;
+            e.last_read.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+            evict_locked(sh, id, now);
+            return {e.status.load(), e.progress.load(std::memory_order_relaxed),
+                    e.result, e.bodies, e.index};
         }
-        if (redis_db_ != 0) {
-            redisReply* reply = (redisReply*)redisCommand(ctx, "SELECT %d", redis_db_);
-            if (reply) freeReplyObject(reply);
-        }
-        return ctx;
     }
 
-    void persist_to_redis(const std::string& id) {
-        auto ctx = connect_redis();
-        if (!ctx) return;
-
-        auto it = results_.find(id);
-        if (it == results_.end()) { redisFree(ctx); return; }
-
-        json j       = analysis_result_to_json(it->second);
-        std::string s = j.dump();
-
-        redisReply* reply = (redisReply*)redisCommand(
-            ctx, "SET analysis:%s %b EX 86400",
-            id.c_str(), s.c_str(), s.size());
-        if (reply) freeReplyObject(reply);
+    Shard& shard(const std::string& id) {
+        return shards_[std::hash<std::string>{}(id) % SHARDS];
+    }
 
-        redisFree(ctx);
+    static bool finished(const Entry& e) {
+        const auto st = e.status.load();
+        return st == AnalysisStatus::COMPLETED || st == AnalysisStatus::FAILED;
     }
 
-    bool load_from_redis(const std::string& id) {
-        auto ctx = connect_redis();
-        if (!ctx) return false;
+    bool expired(const Entry& e, Clock::time_point now) const {
+        return finished(e) && now - e.stored > ttl_;
+    }
 
-        redisReply* reply = (redisReply*)redisCommand(
-            ctx, "GET analysis:%s", id.c_str());
-        bool loaded = false;
-        if (reply && reply->type == REDIS_REPLY_STRING) {
-            // For now, just store a stub – full deserialisation can be added
-            // This is primarily for the case where the server restarts
-            // and we want to know that analysis existed
-            loaded = true;
+    /**
+     * Drop expired entries, then least-recently-read finished entries
+     * until the shard fits its budget.  `keep` (the entry just stored) is
+     * never evicted, so one oversized result still gets served.  Linear
+     * in the shard size, and only runs on put().
+     */
+    void evict_locked(Shard& sh, const std::string& keep, Clock::time_point now) {
+        for (auto it = sh.entries.begin(); it != sh.entries.end();) {
+            if (it->first != keep && expired(it->second, now)) {
+                sh.bytes -= it->second.bytes;
+                it = sh.entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        while (sh.bytes > shard_budget_) {
+            auto lru = sh.entries.end();
+            for (auto it = sh.entries.begin(); it != sh.entries.end(); ++it) {
+                if (it->first == keep || !finished(it->second)) continue;
+                if (lru == sh.entries.end() ||
+                    it->second.last_read.load(std::memory_order_relaxed) <
+                    lru->second.last_read.load(std::memory_order_relaxed))
+                    lru = it;
+            }
+            if (lru == sh.entries.end()) break;
+            sh.bytes -= lru->second.bytes;
+            sh.entries.erase(lru);
         }
-        if (reply) freeReplyObject(reply);
-        redisFree(ctx);
-        return loaded;
     }
+
+#ifdef ENABLE_REDIS
+    RedisBackend redis_;
 #endif
 };
 
@@ -0,0 +1,312 @@
+#pragma once
+// ============================================================================
+// Stream Ingest – build a TransactionGraph from CSV that arrives in slices
+//
+// Large uploads are sent as a sequence of raw byte slices (see the
+// /api/v1/analyze/stream routes in main.cpp).  Each slice is parsed as soon
+// as it arrives and fed straight into a GraphBuilder, so the server only
+// ever holds one partial record plus the interned graph columns – never the
+// whole file or per-row strings.
+//
+// CsvStreamParser – incremental, quote-aware record splitter + row parser
+// StreamingUpload – one in-flight upload (parser + builder + bookkeeping)
+// UploadStore     – registry of in-flight uploads, swept when idle
+// ============================================================================
+
+#include "csv_parser.h"
+#include "graph_engine.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mm {
+
+// ─── Incremental CSV parser ───────────────────────────────────────────────
+
+class CsvStreamParser {
+public:
+    // A single record longer than this (quoted field left open, or no
+    // newlines at all) is treated as malformed input
+    static constexpr size_t MAX_RECORD_BYTES = 1u << 20;   // 1 MB
+
+    explicit CsvStreamParser(GraphBuilder& builder) : builder_(builder) {}
+
+    /**
+     * Consume the next slice of the CSV body.  Every complete record is
+     * parsed immediately; a trailing partial record is carried over to the
+     * next call.  Returns false once the input is known to be invalid.
+     */
+    bool feed(std::string_view data) {
+        if (!error_.empty()) return false;
+        bytes_ += data.size();
+        carry_.append(data.data(), data.size());
+
+        // Records end at the last newline outside quotes – same parity
+        // rule the parallel chunk splitter uses
+        size_t cut = std::string::npos;
+        for (size_t i = scan_pos_; i < carry_.size(); ++i) {
+            char c = carry_[i];
+            if (c == '"') in_quotes_ = !in_quotes_;
+            else if (c == '\n' && !in_quotes_) cut = i;
+        }
+        scan_pos_ = carry_.size();
+
+        if (cut != std::string::npos) {
+            if (!process(carry_.data(), carry_.data() + cut + 1)) return false;
+            carry_.erase(0, cut + 1);
+            scan_pos_ = carry_.size();
+        }
+
+        if (carry_.size() > MAX_RECORD_BYTES) {
+            error_ = "CSV record exceeds maximum length of 1MB";
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * End of input: parse the final record (which need not end in a
+     * newline) and check that something usable was read.
+     */
+    bool finish() {
+        if (!error_.empty()) return false;
+        if (bytes_ == 0) {
+            error_ = "Empty CSV content";
+            return false;
+        }
+        if (!carry_.empty()) {
+            if (!process(carry_.data(), carry_.data() + carry_.size())) return false;
+            std::string().swap(carry_);
+            scan_pos_ = 0;
+        }
+        if (builder_.transaction_count() == 0) {
+            error_ = "No valid transactions found in CSV";
+            return false;
+        }
+        return true;
+    }
+
+    const std::string& error() const { return error_; }
+    size_t bytes_received() const { return bytes_; }
+
+private:
+    GraphBuilder&      builder_;
+    std::string        carry_;          // unparsed tail (≤ one partial record)
+    size_t             scan_pos_  = 0;  // carry_[0, scan_pos_) already scanned
+    bool               in_quotes_ = false;
+    bool               have_header_ = false;
+    detail::CsvColumns cols_;
+    TimestampFormat    ts_fmt_ = TimestampFormat::UNKNOWN;
+    std::string        error_;
+    size_t             bytes_ = 0;
+
+    // Parse whole records in [p, end); the first one is the header
+    bool process(const char* p, const char* end) {
+        if (!have_header_) {
+            CsvParseResult header;
+            if (!detail::parse_header(p, end, cols_, header)) {
+                error_ = header.error;
+                return false;
+            }
+            have_header_ = true;
+        }
+        detail::for_each_row(p, end, cols_, ts_fmt_, [&](const detail::CsvRow& row) {
+            builder_.add(row.sender, row.receiver, row.amount, row.timestamp);
+        });
+        return true;
+    }
+};
+
+// ─── One in-flight upload ─────────────────────────────────────────────────
+
+class StreamingUpload {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    StreamingUpload() : parser_(builder_) {}
+
+    StreamingUpload(const StreamingUpload&) = delete;
+    StreamingUpload& operator=(const StreamingUpload&) = delete;
+
+    // Slices for one upload are applied one at a time, in order
+    std::mutex& mutex() { return mtx_; }
+
+    /**
+     * Append a slice.  `offset` is where the client believes the slice
+     * starts; a mismatch (lost or replayed slice) is rejected without
+     * consuming anything.
+     */
+    bool append(std::string_view data, size_t offset) {
+        if (offset != parser_.bytes_received()) return false;
+        last_activity_ = Clock::now();
+        return parser_.feed(data);
+    }
+
+    bool finish() {
+        last_activity_ = Clock::now();
+        return parser_.finish();
+    }
+
+    const std::string& error() const { return parser_.error(); }
+    size_t bytes_received() const { return parser_.bytes_received(); }
+    size_t transaction_count() const { return builder_.transaction_count(); }
+    Clock::time_point started() const { return started_; }
+    Clock::time_point last_activity() const { return last_activity_.load(); }
+
+    // Mark the upload active without its mutex (UploadStore::get)
+    void touch() { last_activity_.store(Clock::now()); }
+
+    // Hand the accumulated columns over to TransactionGraph::build()
+    GraphBuilder take_builder() { return std::move(builder_); }
+
+private:
+    std::mutex        mtx_;
+    GraphBuilder      builder_;
+    CsvStreamParser   parser_;
+    Clock::time_point started_       = Clock::now();
+    std::atomic<Clock::time_point> last_activity_{started_};
+};
+
+// ─── Upload registry ──────────────────────────────────────────────────────
+
+class UploadStore {
+public:
+    using Clock = StreamingUpload::Clock;
+
+    // Called with the ID of each upload dropped for idleness, outside the
+    // store's lock (the server resolves its pending result)
+    using ExpireHook = std::function<void(const std::string& id)>;
+
+    // Uploads with no slice for this long are dropped
+    static constexpr std::chrono::minutes IDLE_TIMEOUT{15};
+    // Each open upload holds a growing graph builder, so their number is capped
+    static constexpr size_t DEFAULT_MAX_UPLOADS = 32;
+    // create() / get() look for idle uploads at most this often
+    static constexpr std::chrono::seconds SWEEP_INTERVAL{60};
+
+    static UploadStore& instance() {
+        static UploadStore s;
+        return s;
+    }
+
+    // Call before first use
+    void configure(size_t max_uploads, ExpireHook on_expire = {}) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        max_uploads_ = max_uploads;
+        on_expire_   = std::move(on_expire);
+    }
+
+    /**
+     * New upload under `id`; nullptr when max_uploads are open and none
+     * of them has been idle past IDLE_TIMEOUT.
+     */
+    std::shared_ptr<StreamingUpload> create(const std::string& id) {
+        std::vector<std::string> dropped;
+        std::shared_ptr<StreamingUpload> up;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            const bool full = uploads_.size() >= max_uploads_;
+            sweep_idle_locked(Clock::now(), dropped, full);
+            if (uploads_.size() < max_uploads_ || uploads_.count(id)) {
+                up = std::make_shared<StreamingUpload>();
+                uploads_[id] = up;
+            }
+        }
+        notify_expired(dropped);
+        return up;
+    }
+
+    // nullptr for unknown and expired uploads
+    std::shared_ptr<StreamingUpload> get(const std::string& id) {
+        std::vector<std::string> dropped;
+        std::shared_ptr<StreamingUpload> up;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            const auto now = Clock::now();
+            sweep_idle_locked(now, dropped);
+            auto it = uploads_.find(id);
+            if (it != uploads_.end()) {
+                if (expired(*it->second, now)) {
+                    uploads_.erase(it);
+                    dropped.push_back(id);
+                } else {
+                    // Under the store lock, so no sweep can drop it before
+                    // the caller takes its mutex
+                    it->second->touch();
+                    up = it->second;
+                }
+            }
+        }
+        notify_expired(dropped);
+        return up;
+    }
+
+    // Remove and return the upload (finish / abort)
+    std::shared_ptr<StreamingUpload> take(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = uploads_.find(id);
+        if (it == uploads_.end()) return nullptr;
+        auto up = std::move(it->second);
+        uploads_.erase(it);
+        return up;
+    }
+
+    // Put back an upload take() returned (finish was refused)
+    void restore(const std::string& id, std::shared_ptr<StreamingUpload> up) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        uploads_.emplace(id, std::move(up));
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return uploads_.size();
+    }
+
+private:
+    UploadStore() = default;
+    UploadStore(const UploadStore&) = delete;
+    UploadStore& operator=(const UploadStore&) = delete;
+
+    std::mutex        mtx_;
+    std::unordered_map<std::string, std::shared_ptr<StreamingUpload>> uploads_;
+    size_t            max_uploads_ = DEFAULT_MAX_UPLOADS;
+    ExpireHook        on_expire_;
+    Clock::time_point last_sweep_{};
+
+    // Idle past IDLE_TIMEOUT and not mid-slice (its mutex is free)
+    static bool expired(StreamingUpload& up, Clock::time_point now) {
+        std::unique_lock<std::mutex> up_lock(up.mutex(), std::try_to_lock);
+        return up_lock.owns_lock() && now - up.last_activity() > IDLE_TIMEOUT;
+    }
+
+    // Every SWEEP_INTERVAL, or now when `force`d; IDs dropped go to `dropped`
+    void sweep_idle_locked(Clock::time_point now, std::vector<std::string>& dropped,
+                           bool force = false) {
+        if (!force && now - last_sweep_ < SWEEP_INTERVAL) return;
+        last_sweep_ = now;
+        for (auto it = uploads_.begin(); it != uploads_.end();) {
+            if (expired(*it->second, now)) {
+                dropped.push_back(it->first);
+                it = uploads_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // on_expire_ is only set by configure(), before any upload exists
+    void notify_expired(const std::vector<std::string>& dropped) const {
+        if (!on_expire_) return;
+        for (const auto& id : dropped) on_expire_(id);
+    }
+};
+
+} // namespace mm
@@ -0,0 +1,175 @@
+#pragma once
+// ============================================================================
+// Thread Pool – fixed set of worker threads shared by the analysis pipeline
+//
+// submit()       – queue a task, get a std::future for its result
+// parallel_for() – run fn(i) (or fn(i, worker)) for i in [0, n) across the
+//                  workers
+//
+// parallel_for() lets the calling thread claim indices too and only waits
+// for indices that have actually been claimed, so it never deadlocks when
+// called from inside a pool task while every worker is busy.
+// ============================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace mm {
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = default_threads()) {
+        threads = std::max<size_t>(threads, 1);
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+            workers_.emplace_back([this] { worker_loop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool: analysis jobs and detector tasks all run here
+    static ThreadPool& shared() {
+        static ThreadPool pool(shared_threads());
+        return pool;
+    }
+
+    // Size of shared(); only takes effect before its first use
+    static void set_shared_threads(size_t threads) { shared_threads() = threads; }
+
+    static size_t default_threads() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    // Queue a task; the future carries its result or exception
+    template <class F>
+    auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        auto fut  = task->get_future();
+        enqueue([task] { (*task)(); });
+        return fut;
+    }
+
+    // Upper bound on the `worker` index parallel_for() passes to fn
+    size_t max_workers() const { return size() + 1; }
+
+    /**
+     * Run fn(i) for every i in [0, n) and return when all have finished.
+     * Indices are handed out dynamically, so uneven work balances itself.
+     * The first exception thrown by fn is rethrown here.
+     *
+     * fn may also take (i, worker): worker < max_workers() is the same for
+     * every index one participating thread runs, so callers can keep
+     * per-thread scratch in a vector indexed by it.
+     */
+    template <class F>
+    void parallel_for(size_t n, F&& fn) {
+        if (n == 0) return;
+        if (n == 1) { invoke(fn, 0, 0); return; }
+
+        // Shared so helpers that start after we return still see valid state
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::atomic<size_t> workers{0};
+            std::exception_ptr  error;
+            std::mutex          mtx;
+            std::condition_variable cv;
+        };
+        auto st = std::make_shared<State>();
+        const size_t n_total = n;
+
+        auto run = [st, n_total, &fn] {
+            const size_t worker = st->workers.fetch_add(1);
+            for (;;) {
+                size_t i = st->next.fetch_add(1);
+                if (i >= n_total) return;
+                try {
+                    invoke(fn, i, worker);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(st->mtx);
+                    if (!st->error) st->error = std::current_exception();
+                }
+                if (st->done.fetch_add(1) + 1 == n_total) {
+                    std::lock_guard<std::mutex> lock(st->mtx);
+                    st->cv.notify_all();
+                }
+            }
+        };
+
+        // fn is only touched for claimed indices, all of which finish
+        // before we return, so capturing it by reference is safe
+        const size_t helpers = std::min(size(), n - 1);
+        for (size_t h = 0; h < helpers; ++h) enqueue(run);
+        run();
+
+        std::unique_lock<std::mutex> lock(st->mtx);
+        st->cv.wait(lock, [&] { return st->done.load() == n_total; });
+        if (st->error) std::rethrow_exception(st->error);
+    }
+
+private:
+    std::vector<std::thread>          workers_;
+    std::deque<std::function<void()>> queue_;
+    std::mutex                        mtx_;
+    std::condition_variable           cv_;
+    bool                              stopping_ = false;
+
+    static size_t& shared_threads() {
+        static size_t n = default_threads();
+        return n;
+    }
+
+    template <class F>
+    static void invoke(F& fn, size_t i, size_t worker) {
+        if constexpr (std::is_invocable_v<F&, size_t, size_t>) fn(i, worker);
+        else fn(i);
+    }
+
+    void enqueue(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            queue_.push_back(std::move(job));
+        }
+        cv_.notify_one();
+    }
+
+    void worker_loop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (stopping_ && queue_.empty()) return;
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+} // namespace mm
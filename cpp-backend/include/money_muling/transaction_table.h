@@ -0,0 +1,115 @@
+#pragma once
+// ============================================================================
+// Transaction Table – parsed transactions as columns
+//
+// The canonical output of parse_csv.  Account IDs are interned as rows are
+// read, so a row is two NodeIds, an amount and a timestamp – no strings
+// per row – and GraphBuilder / TransactionGraph::build adopt the columns
+// without touching account names again.  Transaction IDs are never read
+// by the detectors; they are kept, in one string pool, only on request.
+// ============================================================================
+
+#include "interner.h"
+#include "models.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mm {
+
+class TransactionTable {
+public:
+    TransactionTable() = default;
+    explicit TransactionTable(bool keep_transaction_ids)
+        : keep_ids_(keep_transaction_ids) {
+        if (keep_ids_) txn_id_off_.push_back(0);
+    }
+
+    void reserve(size_t rows) {
+        src_.reserve(rows);
+        dst_.reserve(rows);
+        amount_.reserve(rows);
+        ts_.reserve(rows);
+        if (keep_ids_) txn_id_off_.reserve(rows + 1);
+    }
+
+    void add(std::string_view sender, std::string_view receiver,
+             double amount, TimePoint ts, std::string_view transaction_id = {}) {
+        const NodeId s = ids_.intern(sender);
+        const NodeId r = ids_.intern(receiver);
+        push(s, r, amount, ts, transaction_id);
+    }
+
+    /**
+     * Append `other`'s rows, re-interning its accounts into this table's
+     * numbering (one lookup per distinct account, not per row).  Returns
+     * other's NodeId → this table's NodeId.  Appending per-chunk tables in
+     * input order yields the numbering of one serial parse.
+     */
+    std::vector<NodeId> append(const TransactionTable& other) {
+        std::vector<NodeId> remap(other.ids_.size());
+        for (NodeId id = 0; id < (NodeId)remap.size(); ++id)
+            remap[id] = ids_.intern(other.ids_.name(id));
+
+        reserve(size() + other.size());
+        for (size_t i = 0; i < other.size(); ++i)
+            push(remap[other.src_[i]], remap[other.dst_[i]], other.amount_[i], other.ts_[i],
+                 other.transaction_id(i));
+        return remap;
+    }
+
+    size_t size() const  { return src_.size(); }
+    bool   empty() const { return src_.empty(); }
+
+    // ── Columns ────────────────────────────────────────────────────────
+    NodeId    sender(size_t i) const    { return src_[i]; }
+    NodeId    receiver(size_t i) const  { return dst_[i]; }
+    double    amount(size_t i) const    { return amount_[i]; }
+    TimePoint timestamp(size_t i) const { return ts_[i]; }
+
+    std::span<const NodeId>    senders() const    { return src_; }
+    std::span<const NodeId>    receivers() const  { return dst_; }
+    std::span<const double>    amounts() const    { return amount_; }
+    std::span<const TimePoint> timestamps() const { return ts_; }
+
+    // Empty unless the table was created with keep_transaction_ids
+    bool has_transaction_ids() const { return keep_ids_; }
+    std::string_view transaction_id(size_t i) const {
+        if (!keep_ids_) return {};
+        return std::string_view(txn_ids_).substr(txn_id_off_[i],
+                                                 txn_id_off_[i + 1] - txn_id_off_[i]);
+    }
+
+    // ── Accounts ───────────────────────────────────────────────────────
+    const AccountInterner& accounts() const { return ids_; }
+    size_t account_count() const { return ids_.size(); }
+    NodeId find(std::string_view account) const { return ids_.find(account); }
+    const std::string& name(NodeId id) const { return ids_.name(id); }
+
+private:
+    AccountInterner        ids_;
+    std::vector<NodeId>    src_;
+    std::vector<NodeId>    dst_;
+    std::vector<double>    amount_;
+    std::vector<TimePoint> ts_;
+
+    bool                   keep_ids_ = false;
+    std::vector<uint32_t>  txn_id_off_;   // size() + 1 when kept
+    std::string            txn_ids_;
+
+    void push(NodeId s, NodeId r, double amount, TimePoint ts, std::string_view txn_id) {
+        src_.push_back(s);
+        dst_.push_back(r);
+        amount_.push_back(amount);
+        ts_.push_back(ts);
+        if (keep_ids_) {
+            txn_ids_.append(txn_id);
+            txn_id_off_.push_back((uint32_t)txn_ids_.size());
+        }
+    }
+};
+
+} // namespace mm
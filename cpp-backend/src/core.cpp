@@ -0,0 +1,33 @@
+// ============================================================================
+// core.cpp – money_muling_core: the engine compiled once behind core.h
+// ============================================================================
+
+#include "money_muling/core.h"
+
+#include "money_muling/analysis_engine.h"
+#include "money_muling/decision_tree.h"
+#include "money_muling/json_serializer.h"
+
+#include <utility>
+
+namespace mm {
+
+AnalysisResult analyze_csv(const std::string&     analysis_id,
+                           std::string_view       csv_content,
+                           const DetectionConfig& config,
+                           const CancelToken*     cancel) {
+    return AnalysisEngine::run(analysis_id, csv_content, config, {}, cancel);
+}
+
+std::string download_json(const AnalysisResult& result) {
+    return download_result_json(result);
+}
+
+bool load_scoring_rules(const std::string& path, std::string& error) {
+    auto rules = RuleSet::load_file(path, error);
+    if (!rules) return false;
+    DecisionTree::configure(std::move(*rules));
+    return true;
+}
+
+} // namespace mm
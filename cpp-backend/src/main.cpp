@@ -3,10 +3,22 @@
 //
 // Routes (same API contract as Python/FastAPI):
 //   POST   /api/v1/analyze          – upload CSV, start analysis
+//                                     (?<threshold>=… overrides a detector
+//                                     threshold, see detection_config.h)
+//   POST   /api/v1/analyze/stream   – open a streaming upload (no size cap)
+//   PUT    /api/v1/analyze/stream/{id}        – append a raw CSV slice
+//   POST   /api/v1/analyze/stream/{id}/finish – end upload, start analysis
 //   GET    /api/v1/analysis/{id}    – poll status / get results
+//   DELETE /api/v1/analysis/{id}    – cancel a queued / running analysis
+//                                     and drop it (or drop a finished one)
+//   POST   /api/v1/analysis/{id}/append   – add rows to a session analysis
 //   GET    /api/v1/analysis/{id}/download – download JSON report
 //   GET    /api/v1/analysis/{id}/graph    – get graph visualisation data
+//   POST   /api/v1/analysis/{id}/reanalyze – re-run detectors on the graph
+//                                            snapshot with new thresholds
 //   GET    /health                  – health check
+//   GET    /metrics                 – Prometheus metrics (stage timings,
+//                                     detector counters, queue, store)
 // ============================================================================
 
 #include "crow.h"
@@ -14,18 +26,30 @@
 
 #include "money_muling/models.h"
 #include "money_muling/analysis_engine.h"
+#include "money_muling/analysis_executor.h"
+#include "money_muling/analysis_session.h"
+#include "money_muling/graph_snapshot.h"
 #include "money_muling/json_serializer.h"
+#include "money_muling/metrics.h"
+#include "money_muling/response_body.h"
+#include "money_muling/result_index.h"
 #include "money_muling/store.h"
+#include "money_muling/stream_ingest.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <functional>
-#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <random>
 #include <sstream>
 #include <string>
-#include <thread>
+#include <string_view>
 
 using json = nlohmann::json;
 
@@ -63,15 +87,17 @@ struct CORSMiddleware {
         res.add_header("Access-Control-Allow-Methods",
                        "GET, POST, PUT, DELETE, OPTIONS");
         res.add_header("Access-Control-Allow-Headers",
-                       "Content-Type, Authorization");
+                       "Content-Type, Authorization, If-None-Match");
+        res.add_header("Access-Control-Expose-Headers", "ETag, Retry-After");
         res.add_header("Access-Control-Max-Age", "86400");
     }
 };
 
 // ── Multipart body helper ────────────────────────────────────────────────
 
-static std::string extract_file_content(const std::string& body,
-                                         const std::string& content_type) {
+// Returns a view into `body` (empty if the part cannot be found)
+static std::string_view extract_file_content(const std::string& body,
+                                              const std::string& content_type) {
     // Find boundary from content-type
     auto bpos = content_type.find("boundary=");
     if (bpos == std::string::npos) return "";
@@ -110,12 +136,287 @@ static std::string extract_file_content(const std::string& body,
         --part_end;
     }
 
-    return body.substr(header_end, part_end - header_end);
+    return std::string_view(body).substr(header_end, part_end - header_end);
+}
+
+// CSV from a multipart/form-data upload or a plain text body
+static std::string_view request_csv(const crow::request& req) {
+    std::string ct = req.get_header_value("Content-Type");
+    if (ct.find("multipart/form-data") != std::string::npos)
+        return extract_file_content(req.body, ct);
+    return req.body;
+}
+
+// ── Admission ────────────────────────────────────────────────────────────
+
+// 503 + Retry-After when the analysis queue is full
+static crow::response queue_full(const mm::AnalysisExecutor::Admission& a) {
+    json err = {{"detail", "Analysis queue is full; retry later"},
+                {"retry_after_seconds", a.retry_after}};
+    crow::response res(503);
+    res.set_header("Content-Type", "application/json");
+    res.set_header("Retry-After", std::to_string(a.retry_after));
+    res.body = err.dump();
+    return res;
+}
+
+// 503 for a session / upload that cannot be opened while the store is full
+static crow::response store_full(const std::string& detail) {
+    json err = {{"detail", detail}};
+    crow::response res(503);
+    res.set_header("Content-Type", "application/json");
+    res.body = err.dump();
+    return res;
+}
+
+// ── Cached bodies ────────────────────────────────────────────────────────
+
+// A pre-serialised body: 304 on a matching If-None-Match, gzip when the
+// client accepts it and a compressed variant exists
+static crow::response send_body(const crow::request& req, const mm::EncodedBody& body) {
+    const bool gz = !body.gzip.empty() &&
+                    mm::http::accepts_gzip(req.get_header_value("Accept-Encoding"));
+    const std::string& etag = gz ? body.gzip_etag : body.etag;
+
+    crow::response res(200);
+    res.set_header("Content-Type", "application/json");
+    res.set_header("ETag", etag);
+    res.set_header("Vary", "Accept-Encoding");
+    if (mm::http::etag_matches(req.get_header_value("If-None-Match"), etag)) {
+        res.code = 304;
+        return res;
+    }
+    if (gz) {
+        res.set_header("Content-Encoding", "gzip");
+        res.body = body.gzip;
+    } else {
+        res.body = body.data;
+    }
+    return res;
+}
+
+// ── Detection thresholds ─────────────────────────────────────────────────
+
+// 400 with a detail message
+static crow::response bad_request(const std::string& detail) {
+    json err = {{"detail", detail}};
+    crow::response res(400);
+    res.set_header("Content-Type", "application/json");
+    res.body = err.dump();
+    return res;
+}
+
+// Overrides from the query string (?fan_threshold=8&cycle_max_length=4);
+// false with `error` set on a malformed or out-of-range value
+static bool query_detection_config(const crow::request& req, mm::DetectionConfig& cfg,
+                                   std::string& error) {
+    for (const auto& p : mm::DetectionConfig::params()) {
+        const char* v = req.url_params.get(p.key);
+        if (!v) continue;
+        char* end = nullptr;
+        const double d = std::strtod(v, &end);
+        if (end == v || *end != '\0') {
+            error = std::string(p.key) + " must be a number";
+            return false;
+        }
+        if (!cfg.set(p, d, error)) return false;
+    }
+    return cfg.validate(error);
+}
+
+// ── Result queries ───────────────────────────────────────────────────────
+
+// Integer query parameter in [min, max]; false with `error` set when malformed
+static bool query_count(const crow::request& req, const char* key, size_t min, size_t max,
+                        std::optional<size_t>& out, std::string& error) {
+    const char* v = req.url_params.get(key);
+    if (!v) return true;
+    char* end = nullptr;
+    const unsigned long long n = std::strtoull(v, &end, 10);
+    if (end == v || *end != '\0' || *v == '-' || n < min || n > max) {
+        error = std::string(key) + " must be an integer in " + std::to_string(min) + "-" +
+                std::to_string(max);
+        return false;
+    }
+    out = (size_t)n;
+    return true;
+}
+
+static bool query_score(const crow::request& req, double& out, std::string& error) {
+    const char* v = req.url_params.get("min_score");
+    if (!v) return true;
+    char* end = nullptr;
+    out = std::strtod(v, &end);
+    if (end == v || *end != '\0' || !std::isfinite(out)) {
+        error = "min_score must be a number";
+        return false;
+    }
+    return true;
+}
+
+// ?limit=&cursor=&min_score= on the poll endpoint; nullopt when absent
+static std::optional<mm::AccountQuery> query_accounts(const crow::request& req,
+                                                      std::string& error) {
+    if (!req.url_params.get("limit") && !req.url_params.get("cursor") &&
+        !req.url_params.get("min_score"))
+        return std::nullopt;
+    mm::AccountQuery q;
+    std::optional<size_t> cursor;
+    if (!query_count(req, "limit", 1, mm::ResultIndex::MAX_LIMIT, q.limit, error) ||
+        !query_count(req, "cursor", 0, SIZE_MAX, cursor, error) ||
+        !query_score(req, q.min_score, error))
+        return std::nullopt;
+    q.cursor = cursor.value_or(0);
+    if (cursor && !q.limit) q.limit = mm::ResultIndex::DEFAULT_PAGE;
+    return q;
+}
+
+// ?account=|ring=&hops=&suspicious_only=&min_score=&limit= on /graph
+static std::optional<mm::GraphQuery> query_graph(const crow::request& req,
+                                                 std::string& error) {
+    const char* account = req.url_params.get("account");
+    const char* ring    = req.url_params.get("ring");
+    const char* susp    = req.url_params.get("suspicious_only");
+    const char* hops    = req.url_params.get("hops");
+    if (!account && !ring && !susp && !hops && !req.url_params.get("limit") &&
+        !req.url_params.get("min_score"))
+        return std::nullopt;
+    mm::GraphQuery q;
+    if (account) q.account = account;
+    if (ring)    q.ring    = ring;
+    q.suspicious_only = susp && (std::string(susp) == "true" || std::string(susp) == "1");
+    std::optional<size_t> h;
+    if (!query_count(req, "hops", 0, mm::ResultIndex::MAX_HOPS, h, error) ||
+        !query_count(req, "limit", 1, mm::ResultIndex::MAX_LIMIT, q.limit, error) ||
+        !query_score(req, q.min_score, error))
+        return std::nullopt;
+    if (h && !q.neighbourhood()) {
+        error = "hops needs account or ring";
+        return std::nullopt;
+    }
+    q.hops = (int)h.value_or(1);
+    return q;
+}
+
+// Overrides from a JSON object body (empty keeps the defaults)
+static bool json_detection_config(const std::string& body, mm::DetectionConfig& cfg,
+                                  std::string& error) {
+    if (body.empty()) return true;
+    json j = json::parse(body, nullptr, false);
+    if (j.is_discarded() || !j.is_object()) {
+        error = "Body must be a JSON object";
+        return false;
+    }
+    for (const auto& p : mm::DetectionConfig::params()) {
+        auto it = j.find(p.key);
+        if (it == j.end()) continue;
+        if (!it->is_number()) {
+            error = std::string(p.key) + " must be a number";
+            return false;
+        }
+        if (!cfg.set(p, it->get<double>(), error)) return false;
+    }
+    return cfg.validate(error);
+}
+
+// ── Job results ──────────────────────────────────────────────────────────
+
+// Reports the engine's progress on the stored entry
+static mm::AnalysisEngine::ProgressHook progress_hook(const std::string& analysis_id) {
+    return [analysis_id](double fraction) {
+        mm::Store::instance().update_progress(analysis_id, fraction);
+    };
+}
+
+// Stores a job's result unless DELETE cancelled the job.  The check is
+// repeated after the put, so a DELETE racing it still removes the entry.
+// False when nothing was kept.
+static bool store_result(const std::string& analysis_id, const mm::CancelToken& cancel,
+                         mm::AnalysisResult result) {
+    if (cancel.cancelled()) return false;
+    mm::Store::instance().put(analysis_id, std::move(result));
+    if (!cancel.cancelled()) return true;
+    mm::Store::instance().remove(analysis_id);
+    return false;
+}
+
+// ── Graph snapshots ──────────────────────────────────────────────────────
+
+// Saves the built graph for later re-analysis; none when snapshots are off.
+// Like store_result, a job DELETE cancelled leaves no snapshot behind.
+static mm::AnalysisEngine::GraphHook snapshot_hook(const std::string& analysis_id,
+                                                   const mm::CancelToken& cancel) {
+    if (!mm::SnapshotStore::instance().enabled()) return {};
+    return [analysis_id, &cancel](const mm::TransactionGraph& graph) {
+        auto& snapshots = mm::SnapshotStore::instance();
+        if (cancel.cancelled()) return;
+        snapshots.save(analysis_id, graph);
+        if (cancel.cancelled()) snapshots.remove(analysis_id);
+    };
+}
+
+static size_t env_size(const char* name, size_t fallback) {
+    const char* v = std::getenv(name);
+    return v && *v ? std::strtoull(v, nullptr, 10) : fallback;
 }
 
 // ── Main ─────────────────────────────────────────────────────────────────
 
 int main() {
+    // Crow gets a few IO threads; the rest of the cores go to the shared
+    // analysis pool, so request handling never competes with detectors
+    const size_t cores        = mm::ThreadPool::default_threads();
+    const size_t io_threads   = std::max<size_t>(env_size("MM_IO_THREADS", 2), 1);
+    const size_t pool_threads = env_size("MM_ANALYSIS_THREADS",
+                                         cores > io_threads ? cores - io_threads : 1);
+    mm::ThreadPool::set_shared_threads(pool_threads);
+    const std::chrono::seconds store_ttl(env_size("MM_STORE_TTL_SECS",
+                                                  (size_t)mm::Store::DEFAULT_TTL.count()));
+    mm::Store::instance().configure(
+        env_size("MM_STORE_BUDGET_MB", mm::Store::DEFAULT_MEMORY_BUDGET >> 20) << 20,
+        store_ttl);
+    // Graph snapshots for re-analysis live as long as results do
+    if (const char* dir = std::getenv("MM_SNAPSHOT_DIR"))
+        mm::SnapshotStore::instance().configure(dir, store_ttl);
+#ifdef ENABLE_REDIS
+    // Replicas sharing one Redis serve each other's results
+    const char* redis_host = std::getenv("REDIS_HOST");
+    mm::Store::instance().configure_redis(redis_host ? redis_host : "127.0.0.1",
+                                          (int)env_size("REDIS_PORT", 6379),
+                                          (int)env_size("REDIS_DB", 0));
+#endif
+    mm::AnalysisExecutor::instance().configure(
+        env_size("MM_MAX_CONCURRENT_ANALYSES", 0),
+        env_size("MM_MAX_QUEUED_ANALYSES", mm::AnalysisExecutor::DEFAULT_MAX_QUEUED));
+    // Open append sessions and streaming uploads hold their rows in memory
+    mm::SessionStore::instance().configure(
+        env_size("MM_MAX_SESSIONS", mm::SessionStore::DEFAULT_MAX_SESSIONS));
+    // An upload dropped for idleness fails its pending analysis
+    mm::UploadStore::instance().configure(
+        env_size("MM_MAX_UPLOADS", mm::UploadStore::DEFAULT_MAX_UPLOADS),
+        [](const std::string& analysis_id) {
+            mm::AnalysisResult expired;
+            expired.analysis_id = analysis_id;
+            expired.status      = mm::AnalysisStatus::FAILED;
+            expired.error       = "Upload expired";
+            mm::Store::instance().put(analysis_id, std::move(expired));
+        });
+    // Running analyses past this many seconds return truncated results
+    mm::AnalysisExecutor::instance().set_deadline(std::chrono::seconds(
+        env_size("MM_ANALYSIS_DEADLINE_SECS",
+                 (size_t)mm::AnalysisExecutor::DEFAULT_DEADLINE.count())));
+    // Scoring rules from a JSON file replace the built-in ones; a file
+    // that does not compile stops startup rather than scoring differently
+    if (const char* rules_path = std::getenv("MM_SCORING_RULES")) {
+        std::string error;
+        auto rules = mm::RuleSet::load_file(rules_path, error);
+        if (!rules) {
+            std::cerr << "MM_SCORING_RULES: " << error << "\n";
+            return 1;
+        }
+        mm::DecisionTree::configure(std::move(*rules));
+    }
+
     crow::App<CORSMiddleware> app;
 
     constexpr size_t MAX_FILE_SIZE = 10 * 1024 * 1024; // 10 MB
@@ -129,7 +430,7 @@ int main() {
             res.add_header("Access-Control-Allow-Methods",
                            "GET, POST, PUT, DELETE, OPTIONS");
             res.add_header("Access-Control-Allow-Headers",
-                           "Content-Type, Authorization");
+                           "Content-Type, Authorization, If-None-Match");
             res.add_header("Access-Control-Max-Age", "86400");
             return res;
         }
@@ -147,19 +448,29 @@ int main() {
         return res;
     });
 
+    // ── GET /metrics ─────────────────────────────────────────────────
+    CROW_ROUTE(app, "/metrics")
+    ([]() {
+        auto& executor = mm::AnalysisExecutor::instance();
+        auto& store    = mm::Store::instance();
+        const mm::Metrics::Gauge gauges[] = {
+            {"mm_queue_depth", "Analyses waiting for a worker.", (double)executor.queued()},
+            {"mm_running_analyses", "Analyses running now.", (double)executor.running()},
+            {"mm_store_entries", "Analyses held in the result store.", (double)store.size()},
+            {"mm_store_bytes", "Estimated bytes held by the result store.",
+             (double)store.memory_bytes()},
+        };
+        crow::response res(200);
+        res.set_header("Content-Type", "text/plain; version=0.0.4");
+        res.body = mm::Metrics::instance().render(gauges);
+        return res;
+    });
+
     // ── POST /api/v1/analyze ─────────────────────────────────────────
     CROW_ROUTE(app, "/api/v1/analyze").methods(crow::HTTPMethod::POST)
     ([&](const crow::request& req) {
         // Extract file content from multipart body
-        std::string ct = req.get_header_value("Content-Type");
-        std::string csv_content;
-
-        if (ct.find("multipart/form-data") != std::string::npos) {
-            csv_content = extract_file_content(req.body, ct);
-        } else {
-            // Plain text body
-            csv_content = req.body;
-        }
+        std::string_view csv_content = request_csv(req);
 
         if (csv_content.empty()) {
             json err = {{"detail", "No file content received"}};
@@ -170,13 +481,18 @@ int main() {
         }
 
         if (csv_content.size() > MAX_FILE_SIZE) {
-            json err = {{"detail", "File too large. Maximum size is 10MB."}};
+            json err = {{"detail", "File too large. Maximum size is 10MB; "
+                                   "use /api/v1/analyze/stream for larger files."}};
             crow::response res(413);
             res.set_header("Content-Type", "application/json");
             res.body = err.dump();
             return res;
         }
 
+        mm::DetectionConfig config;
+        std::string error;
+        if (!query_detection_config(req, config, error)) return bad_request(error);
+
         // Generate analysis ID
         std::string analysis_id = generate_uuid();
 
@@ -186,17 +502,188 @@ int main() {
         pending.status      = mm::AnalysisStatus::PENDING;
         mm::Store::instance().put(analysis_id, std::move(pending));
 
-        // Fire-and-forget async analysis
-        std::thread([analysis_id, csv_content]() {
-            mm::Store::instance().update_status(analysis_id,
-                                                mm::AnalysisStatus::PROCESSING);
-            auto result = mm::AnalysisEngine::run(analysis_id, csv_content);
-            mm::Store::instance().put(analysis_id, std::move(result));
-        }).detach();
+        // ?session=true keeps graph + detector state so rows can later be
+        // added with POST /api/v1/analysis/<id>/append
+        const char* session_param = req.url_params.get("session");
+        const bool  use_session   = session_param &&
+            (std::string(session_param) == "true" || std::string(session_param) == "1");
+
+        // Queue the analysis on the executor (the job owns the only copy)
+        mm::AnalysisExecutor::Admission admission;
+        if (use_session) {
+            auto session = mm::SessionStore::instance().create(analysis_id, config);
+            if (!session) {
+                mm::Store::instance().remove(analysis_id);
+                return store_full("Too many open analysis sessions; retry later");
+            }
+            admission = mm::AnalysisExecutor::instance().submit(analysis_id,
+                [analysis_id, session, csv = std::string(csv_content)](const mm::CancelToken& cancel) {
+                    std::lock_guard<std::mutex> lock(session->mutex());
+                    mm::Store::instance().update_status(analysis_id,
+                                                        mm::AnalysisStatus::PROCESSING);
+                    auto result = session->ingest(analysis_id, csv, &cancel,
+                                                  progress_hook(analysis_id));
+                    store_result(analysis_id, cancel, std::move(result));
+                });
+            if (!admission.accepted) mm::SessionStore::instance().remove(analysis_id);
+        } else {
+            admission = mm::AnalysisExecutor::instance().submit(analysis_id,
+                [analysis_id, config, csv = std::string(csv_content)](const mm::CancelToken& cancel) {
+                    mm::Store::instance().update_status(analysis_id,
+                                                        mm::AnalysisStatus::PROCESSING);
+                    auto result = mm::AnalysisEngine::run(analysis_id, csv, config,
+                                                          snapshot_hook(analysis_id, cancel), &cancel,
+                                                          progress_hook(analysis_id));
+                    store_result(analysis_id, cancel, std::move(result));
+                });
+        }
+        if (!admission.accepted) {
+            mm::Store::instance().remove(analysis_id);
+            return queue_full(admission);
+        }
 
         // Return analysis_id immediately
+        json resp = {{"analysis_id",    analysis_id},
+                     {"status",         "pending"},
+                     {"session",        use_session},
+                     {"queue_position", admission.queue_position}};
+        crow::response res(202);
+        res.set_header("Content-Type", "application/json");
+        res.body = resp.dump();
+        return res;
+    });
+
+    // ── POST /api/v1/analyze/stream ──────────────────────────────────
+    // Streaming uploads have no MAX_FILE_SIZE: the body is sent as raw
+    // CSV slices and each slice is parsed into the graph as it arrives.
+    CROW_ROUTE(app, "/api/v1/analyze/stream").methods(crow::HTTPMethod::POST)
+    ([]() {
+        std::string analysis_id = generate_uuid();
+        if (!mm::UploadStore::instance().create(analysis_id))
+            return store_full("Too many open streaming uploads; retry later");
+
+        mm::AnalysisResult pending;
+        pending.analysis_id = analysis_id;
+        pending.status      = mm::AnalysisStatus::PENDING;
+        mm::Store::instance().put(analysis_id, std::move(pending));
+
         json resp = {{"analysis_id", analysis_id},
-                     {"status",      "pending"}};
+                     {"status",      "uploading"},
+                     {"max_record_bytes", mm::CsvStreamParser::MAX_RECORD_BYTES}};
+        crow::response res(201);
+        res.set_header("Content-Type", "application/json");
+        res.body = resp.dump();
+        return res;
+    });
+
+    // ── PUT /api/v1/analyze/stream/<id>?offset=N ─────────────────────
+    CROW_ROUTE(app, "/api/v1/analyze/stream/<string>").methods(crow::HTTPMethod::PUT)
+    ([](const crow::request& req, const std::string& analysis_id) {
+        auto upload = mm::UploadStore::instance().get(analysis_id);
+        if (!upload) {
+            json err = {{"detail", "Upload not found"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        std::string error;
+        std::optional<size_t> requested;
+        if (!query_count(req, "offset", 0, SIZE_MAX, requested, error))
+            return bad_request(error);
+
+        std::lock_guard<std::mutex> lock(upload->mutex());
+
+        // Without ?offset= the slice is appended at the current end
+        const size_t offset = requested.value_or(upload->bytes_received());
+
+        if (offset != upload->bytes_received()) {
+            json err = {{"detail", "Slice offset does not match bytes received"},
+                        {"bytes_received", upload->bytes_received()}};
+            crow::response res(409);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        if (!upload->append(req.body, offset)) {
+            json err = {{"detail", upload->error()}};
+            crow::response res(400);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        json resp = {{"analysis_id",    analysis_id},
+                     {"bytes_received", upload->bytes_received()},
+                     {"transactions",   upload->transaction_count()}};
+        crow::response res(200);
+        res.set_header("Content-Type", "application/json");
+        res.body = resp.dump();
+        return res;
+    });
+
+    // ── POST /api/v1/analyze/stream/<id>/finish ──────────────────────
+    CROW_ROUTE(app, "/api/v1/analyze/stream/<string>/finish").methods(crow::HTTPMethod::POST)
+    ([](const crow::request& req, const std::string& analysis_id) {
+        mm::DetectionConfig config;
+        std::string error;
+        if (!query_detection_config(req, config, error)) return bad_request(error);
+
+        auto upload = mm::UploadStore::instance().take(analysis_id);
+        if (!upload) {
+            json err = {{"detail", "Upload not found"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        // Build + analyse on the executor; wait for any slice still
+        // being applied before touching the builder
+        auto admission = mm::AnalysisExecutor::instance().submit(analysis_id,
+            [analysis_id, upload, config](const mm::CancelToken& cancel) {
+            std::lock_guard<std::mutex> lock(upload->mutex());
+            auto t0 = mm::AnalysisEngine::Clock::now();
+            mm::Store::instance().update_status(analysis_id,
+                                                mm::AnalysisStatus::PROCESSING);
+            if (!upload->finish()) {
+                mm::AnalysisResult failed;
+                failed.analysis_id = analysis_id;
+                failed.status      = mm::AnalysisStatus::FAILED;
+                failed.error       = upload->error();
+                store_result(analysis_id, cancel, std::move(failed));
+                return;
+            }
+
+            mm::TransactionGraph graph;
+            mm::Timings          timings;
+            try {
+                mm::ScopedStage stage(timings, mm::Stage::GRAPH_BUILD);
+                graph.build(upload->take_builder());
+            } catch (const std::exception& e) {
+                mm::AnalysisResult failed;
+                failed.analysis_id = analysis_id;
+                failed.status      = mm::AnalysisStatus::FAILED;
+                failed.error       = std::string("Analysis failed: ") + e.what();
+                store_result(analysis_id, cancel, std::move(failed));
+                return;
+            }
+            if (auto save = snapshot_hook(analysis_id, cancel)) save(graph);
+            auto result = mm::AnalysisEngine::run(analysis_id, graph, config, t0, timings,
+                                                  &cancel, progress_hook(analysis_id));
+            store_result(analysis_id, cancel, std::move(result));
+        });
+        if (!admission.accepted) {
+            // Keep the upload so the client can retry finish
+            mm::UploadStore::instance().restore(analysis_id, std::move(upload));
+            return queue_full(admission);
+        }
+
+        json resp = {{"analysis_id",    analysis_id},
+                     {"status",         "pending"},
+                     {"queue_position", admission.queue_position}};
         crow::response res(202);
         res.set_header("Content-Type", "application/json");
         res.body = resp.dump();
@@ -205,9 +692,50 @@ int main() {
 
     // ── GET /api/v1/analysis/<id> ────────────────────────────────────
     CROW_ROUTE(app, "/api/v1/analysis/<string>")
+    ([](const crow::request& req, const std::string& analysis_id) {
+        auto stored = mm::Store::instance().get(analysis_id);
+        if (!stored) {
+            json err = {{"detail", "Analysis not found"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        // Top-K / paginated suspicious accounts (completed results only)
+        std::string error;
+        const auto page = query_accounts(req, error);
+        if (!error.empty()) return bad_request(error);
+        if (page && stored.status == mm::AnalysisStatus::COMPLETED) {
+            std::shared_ptr<const mm::ResultIndex> built;
+            const mm::ResultIndex* index = stored.indexed();
+            if (!index) index = (built = std::make_shared<const mm::ResultIndex>(stored.result)).get();
+            return send_body(req, mm::EncodedBody::make(index->accounts_json(*page)));
+        }
+
+        if (const auto* bodies = stored.cached()) return send_body(req, bodies->status);
+
+        std::optional<size_t> queue_position;
+        if (stored.status == mm::AnalysisStatus::PENDING) {
+            queue_position = mm::AnalysisExecutor::instance().queue_position(analysis_id);
+        }
+        crow::response res(200);
+        res.set_header("Content-Type", "application/json");
+        res.body = mm::analysis_result_json(*stored.result, stored.status, queue_position,
+                                            stored.progress);
+        return res;
+    });
+
+    // ── DELETE /api/v1/analysis/<id> ─────────────────────────────────
+    // Drops queued jobs and cancels running ones (they stop at their next
+    // check and store nothing), then forgets the analysis: its result,
+    // session, graph snapshot and any upload still open.
+    CROW_ROUTE(app, "/api/v1/analysis/<string>").methods(crow::HTTPMethod::DELETE)
     ([](const std::string& analysis_id) {
-        auto result = mm::Store::instance().get(analysis_id);
-        if (!result.has_value()) {
+        const bool in_flight = mm::AnalysisExecutor::instance().cancel(analysis_id);
+        const bool stored    = mm::Store::instance().exists(analysis_id);
+        const bool uploading = (bool)mm::UploadStore::instance().take(analysis_id);
+        if (!in_flight && !stored && !uploading) {
             json err = {{"detail", "Analysis not found"}};
             crow::response res(404);
             res.set_header("Content-Type", "application/json");
@@ -215,18 +743,83 @@ int main() {
             return res;
         }
 
-        json j = mm::analysis_result_to_json(result.value());
+        mm::SessionStore::instance().remove(analysis_id);
+        mm::SnapshotStore::instance().remove(analysis_id);
+        mm::Store::instance().remove(analysis_id);
+        if (in_flight) mm::Metrics::instance().record_cancelled();
+
+        json resp = {{"analysis_id", analysis_id},
+                     {"status",      in_flight ? "cancelled" : "deleted"}};
         crow::response res(200);
         res.set_header("Content-Type", "application/json");
-        res.body = j.dump();
+        res.body = resp.dump();
+        return res;
+    });
+
+    // ── POST /api/v1/analysis/<id>/append ───────────────────────────
+    // Adds rows (CSV with header) to a session analysis; only detector
+    // state near the new rows is recomputed.  Poll GET as usual.
+    CROW_ROUTE(app, "/api/v1/analysis/<string>/append").methods(crow::HTTPMethod::POST)
+    ([&](const crow::request& req, const std::string& analysis_id) {
+        auto session = mm::SessionStore::instance().get(analysis_id);
+        if (!session) {
+            json err = {{"detail", "Analysis session not found "
+                                   "(start it with POST /api/v1/analyze?session=true)"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        std::string_view csv_content = request_csv(req);
+        if (csv_content.empty()) {
+            json err = {{"detail", "No file content received"}};
+            crow::response res(400);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        if (csv_content.size() > MAX_FILE_SIZE) {
+            json err = {{"detail", "File too large. Maximum size is 10MB."}};
+            crow::response res(413);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        const auto previous = mm::Store::instance().update_status(
+            analysis_id, mm::AnalysisStatus::PENDING);
+
+        // Appends to one session are serialised by its mutex
+        auto admission = mm::AnalysisExecutor::instance().submit(analysis_id,
+            [analysis_id, session, csv = std::string(csv_content)](const mm::CancelToken& cancel) {
+                std::lock_guard<std::mutex> lock(session->mutex());
+                mm::Store::instance().update_status(analysis_id,
+                                                    mm::AnalysisStatus::PROCESSING);
+                auto result = session->ingest(analysis_id, csv, &cancel,
+                                              progress_hook(analysis_id));
+                store_result(analysis_id, cancel, std::move(result));
+            });
+        if (!admission.accepted) {
+            if (previous) mm::Store::instance().update_status(analysis_id, *previous);
+            return queue_full(admission);
+        }
+
+        json resp = {{"analysis_id",    analysis_id},
+                     {"status",         "pending"},
+                     {"queue_position", admission.queue_position}};
+        crow::response res(202);
+        res.set_header("Content-Type", "application/json");
+        res.body = resp.dump();
         return res;
     });
 
     // ── GET /api/v1/analysis/<id>/download ───────────────────────────
     CROW_ROUTE(app, "/api/v1/analysis/<string>/download")
-    ([](const std::string& analysis_id) {
-        auto result = mm::Store::instance().get(analysis_id);
-        if (!result.has_value()) {
+    ([](const crow::request& req, const std::string& analysis_id) {
+        auto stored = mm::Store::instance().get(analysis_id);
+        if (!stored) {
             json err = {{"detail", "Analysis not found"}};
             crow::response res(404);
             res.set_header("Content-Type", "application/json");
@@ -234,7 +827,7 @@ int main() {
             return res;
         }
 
-        if (result->status != mm::AnalysisStatus::COMPLETED) {
+        if (stored.status != mm::AnalysisStatus::COMPLETED) {
             json err = {{"detail", "Analysis not yet completed"}};
             crow::response res(400);
             res.set_header("Content-Type", "application/json");
@@ -242,20 +835,23 @@ int main() {
             return res;
         }
 
-        json j = mm::download_result_to_json(result.value());
         crow::response res(200);
-        res.set_header("Content-Type", "application/json");
+        if (const auto* bodies = stored.cached()) {
+            res = send_body(req, bodies->download);
+        } else {
+            res.set_header("Content-Type", "application/json");
+            res.body = mm::download_result_json(*stored.result); // pretty-printed
+        }
         res.set_header("Content-Disposition",
                        "attachment; filename=\"analysis_" + analysis_id + ".json\"");
-        res.body = j.dump(2); // pretty-printed
         return res;
     });
 
     // ── GET /api/v1/analysis/<id>/graph ──────────────────────────────
     CROW_ROUTE(app, "/api/v1/analysis/<string>/graph")
-    ([](const std::string& analysis_id) {
-        auto result = mm::Store::instance().get(analysis_id);
-        if (!result.has_value()) {
+    ([](const crow::request& req, const std::string& analysis_id) {
+        auto stored = mm::Store::instance().get(analysis_id);
+        if (!stored) {
             json err = {{"detail", "Analysis not found"}};
             crow::response res(404);
             res.set_header("Content-Type", "application/json");
@@ -263,7 +859,7 @@ int main() {
             return res;
         }
 
-        if (result->status != mm::AnalysisStatus::COMPLETED) {
+        if (stored.status != mm::AnalysisStatus::COMPLETED) {
             json err = {{"detail", "Analysis not yet completed"}};
             crow::response res(400);
             res.set_header("Content-Type", "application/json");
@@ -271,10 +867,144 @@ int main() {
             return res;
         }
 
-        json j = mm::graph_data_to_json(result->graph_data);
+        // Subgraph: k-hop neighbourhood, suspicious edges, top-K nodes
+        std::string error;
+        const auto query = query_graph(req, error);
+        if (!error.empty()) return bad_request(error);
+        if (query) {
+            std::shared_ptr<const mm::ResultIndex> built;
+            const mm::ResultIndex* index = stored.indexed();
+            if (!index) index = (built = std::make_shared<const mm::ResultIndex>(stored.result)).get();
+            const bool no_account = !query->account.empty() && !index->has_account(query->account);
+            const bool no_ring    = !query->ring.empty() && !index->has_ring(query->ring);
+            if (no_account || no_ring) {
+                json err = {{"detail", no_account ? "Account not found" : "Ring not found"}};
+                crow::response res(404);
+                res.set_header("Content-Type", "application/json");
+                res.body = err.dump();
+                return res;
+            }
+            return send_body(req, mm::EncodedBody::make(index->graph_json(*query)));
+        }
+
+        if (const auto* bodies = stored.cached()) return send_body(req, bodies->graph);
+
         crow::response res(200);
         res.set_header("Content-Type", "application/json");
-        res.body = j.dump();
+        res.body = mm::graph_data_json(stored.result->graph_data);
+        return res;
+    });
+
+    // ── GET /api/v1/analysis/<id>/accounts/<account>/neighbours ─────
+    // Full connected_accounts of one account (the poll response caps it),
+    // paged with ?limit=&cursor=
+    CROW_ROUTE(app, "/api/v1/analysis/<string>/accounts/<string>/neighbours")
+    ([](const crow::request& req, const std::string& analysis_id, const std::string& account) {
+        auto stored = mm::Store::instance().get(analysis_id);
+        if (!stored) {
+            json err = {{"detail", "Analysis not found"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        if (stored.status != mm::AnalysisStatus::COMPLETED) {
+            json err = {{"detail", "Analysis not yet completed"}};
+            crow::response res(400);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        std::string error;
+        std::optional<size_t> limit, cursor;
+        if (!query_count(req, "limit", 1, mm::ResultIndex::MAX_LIMIT, limit, error) ||
+            !query_count(req, "cursor", 0, SIZE_MAX, cursor, error))
+            return bad_request(error);
+
+        std::shared_ptr<const mm::ResultIndex> built;
+        const mm::ResultIndex* index = stored.indexed();
+        if (!index) index = (built = std::make_shared<const mm::ResultIndex>(stored.result)).get();
+        if (!index->has_account(account)) {
+            json err = {{"detail", "Account not found"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+        if (cursor && !limit) limit = mm::ResultIndex::DEFAULT_PAGE;
+        return send_body(req, mm::EncodedBody::make(
+            index->neighbours_json(account, cursor.value_or(0), limit)));
+    });
+
+    // ── POST /api/v1/analysis/<id>/reanalyze ────────────────────────
+    // Re-runs detection on the mapped graph snapshot of <id> with the
+    // thresholds in the JSON body, as a new analysis (poll its ID as
+    // usual).  Needs MM_SNAPSHOT_DIR; session analyses have no snapshot.
+    CROW_ROUTE(app, "/api/v1/analysis/<string>/reanalyze").methods(crow::HTTPMethod::POST)
+    ([](const crow::request& req, const std::string& source_id) {
+        if (!mm::SnapshotStore::instance().exists(source_id)) {
+            json err = {{"detail", "No graph snapshot for this analysis"}};
+            crow::response res(404);
+            res.set_header("Content-Type", "application/json");
+            res.body = err.dump();
+            return res;
+        }
+
+        mm::DetectionConfig config;
+        std::string error;
+        if (!json_detection_config(req.body, config, error)) return bad_request(error);
+
+        std::string analysis_id = generate_uuid();
+
+        mm::AnalysisResult pending;
+        pending.analysis_id = analysis_id;
+        pending.status      = mm::AnalysisStatus::PENDING;
+        mm::Store::instance().put(analysis_id, std::move(pending));
+
+        auto admission = mm::AnalysisExecutor::instance().submit(analysis_id,
+            [analysis_id, source_id, config](const mm::CancelToken& cancel) {
+                auto t0 = mm::AnalysisEngine::Clock::now();
+                mm::Store::instance().update_status(analysis_id,
+                                                    mm::AnalysisStatus::PROCESSING);
+                std::string open_error;
+                mm::Timings timings;
+                std::optional<mm::TransactionGraph> graph;
+                {
+                    mm::ScopedStage stage(timings, mm::Stage::GRAPH_BUILD);   // mapping
+                    graph = mm::SnapshotStore::instance().open(source_id, &open_error);
+                }
+                if (!graph) {
+                    mm::AnalysisResult failed;
+                    failed.analysis_id = analysis_id;
+                    failed.status      = mm::AnalysisStatus::FAILED;
+                    failed.error       = "Re-analysis failed: " + open_error;
+                    store_result(analysis_id, cancel, std::move(failed));
+                    return;
+                }
+                auto result = mm::AnalysisEngine::run(analysis_id, *graph, config, t0, timings,
+                                                      &cancel, progress_hook(analysis_id));
+                if (!store_result(analysis_id, cancel, std::move(result))) return;
+
+                // The stored analysis can be re-analysed in turn; a DELETE
+                // racing the link still removes it
+                auto& snapshots = mm::SnapshotStore::instance();
+                snapshots.link(analysis_id, source_id);
+                if (cancel.cancelled()) snapshots.remove(analysis_id);
+            });
+        if (!admission.accepted) {
+            mm::Store::instance().remove(analysis_id);
+            return queue_full(admission);
+        }
+
+        json resp = {{"analysis_id",        analysis_id},
+                     {"source_analysis_id", source_id},
+                     {"status",             "pending"},
+                     {"queue_position",     admission.queue_position}};
+        crow::response res(202);
+        res.set_header("Content-Type", "application/json");
+        res.body = resp.dump();
         return res;
     });
 
@@ -289,7 +1019,7 @@ int main() {
 
     app.port(port)
        .bindaddr("0.0.0.0")
-       .multithreaded()
+       .concurrency(static_cast<std::uint16_t>(io_threads))
        .run();
 
     return 0;
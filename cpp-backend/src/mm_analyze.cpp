@@ -0,0 +1,258 @@
+// ============================================================================
+// mm_analyze – offline batch analysis, no HTTP
+//
+//   mm_analyze [options] PATH...
+//
+// Each PATH is a CSV file or a directory (every *.csv below it).  Every
+// input is analysed with the same thresholds and its download report is
+// written to --out: a file given directly becomes <out>/<name>.json, a
+// file found under a directory keeps its relative path below <out>.
+// `--out -` writes the single input's report to stdout.
+//
+// All files share one worker pool (--threads): --jobs files are analysed
+// at once and each one's detectors run on the same pool, so a batch of
+// many small extracts keeps every core busy and one large file still
+// gets all of them.  A line per file goes to stderr; the exit status is
+// 1 if any input failed, 2 on a usage error.
+// ============================================================================
+
+#include "money_muling/core.h"
+#include "money_muling/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Job {
+    fs::path input;
+    fs::path output;   // empty: stdout
+};
+
+void usage() {
+    std::fprintf(stderr,
+        "usage: mm_analyze [options] PATH...\n"
+        "  PATH                 CSV file, or directory scanned for *.csv\n"
+        "  -o, --out DIR        where reports go (default .; '-' = stdout, one input)\n"
+        "  --threads N          shared pool workers (default: cores)\n"
+        "  --jobs N             files analysed at once (default: pool size)\n"
+        "  --set KEY=VALUE      detector threshold, as on POST /api/v1/analyze\n"
+        "                       (repeatable; e.g. --set fan_threshold=15)\n"
+        "  --rules PATH         scoring rules JSON (default: MM_SCORING_RULES)\n"
+        "  -q, --quiet          no per-file lines\n");
+}
+
+bool is_csv(const fs::path& p) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".csv";
+}
+
+// Inputs named on the command line → jobs; false (with `error`) when a
+// path is missing or two inputs would write the same report
+bool collect_jobs(const std::vector<std::string>& paths, const std::string& out,
+                  std::vector<Job>& jobs, std::string& error) {
+    const bool to_stdout = out == "-";
+    for (const auto& arg : paths) {
+        const fs::path root(arg);
+        std::error_code ec;
+        if (fs::is_directory(root, ec)) {
+            std::vector<fs::path> found;
+            for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec))
+                if (it->is_regular_file(ec) && is_csv(it->path())) found.push_back(it->path());
+            if (ec) {
+                error = arg + ": " + ec.message();
+                return false;
+            }
+            std::sort(found.begin(), found.end());
+            for (auto& f : found) {
+                fs::path rel = fs::relative(f, root, ec);
+                if (ec) rel = f.filename();
+                jobs.push_back({f, to_stdout ? fs::path() : fs::path(out) / rel.replace_extension(".json")});
+            }
+        } else if (fs::is_regular_file(root, ec)) {
+            fs::path name = root.filename();
+            jobs.push_back({root, to_stdout ? fs::path() : fs::path(out) / name.replace_extension(".json")});
+        } else {
+            error = arg + ": no such file or directory";
+            return false;
+        }
+    }
+    if (jobs.empty()) {
+        error = "no CSV inputs";
+        return false;
+    }
+    if (to_stdout && jobs.size() > 1) {
+        error = "--out - takes a single input";
+        return false;
+    }
+    std::set<fs::path> outputs;
+    for (const auto& j : jobs) {
+        if (!j.output.empty() && !outputs.insert(j.output.lexically_normal()).second) {
+            error = "two inputs would write " + j.output.string();
+            return false;
+        }
+    }
+    return true;
+}
+
+// KEY=VALUE into `cfg`, checked like the upload query string
+bool set_threshold(const std::string& kv, mm::DetectionConfig& cfg, std::string& error) {
+    const size_t eq = kv.find('=');
+    const std::string key = kv.substr(0, eq);
+    for (const auto& p : mm::DetectionConfig::params()) {
+        if (key != p.key) continue;
+        if (eq == std::string::npos) {
+            error = key + " needs a value";
+            return false;
+        }
+        const std::string v = kv.substr(eq + 1);
+        char* end = nullptr;
+        const double d = std::strtod(v.c_str(), &end);
+        if (v.empty() || *end != '\0') {
+            error = key + " must be a number";
+            return false;
+        }
+        return cfg.set(p, d, error);
+    }
+    error = "unknown threshold " + key;
+    return false;
+}
+
+bool read_file(const fs::path& path, std::string& out) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    out = ss.str();
+    return !f.bad();
+}
+
+bool write_file(const fs::path& path, const std::string& data) {
+    std::error_code ec;
+    if (path.has_parent_path()) fs::create_directories(path.parent_path(), ec);
+    std::ofstream f(path, std::ios::binary);
+    return f && (f << data) && f.flush();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    std::string out = ".";
+    std::string rules_path;
+    if (const char* env = std::getenv("MM_SCORING_RULES")) rules_path = env;
+    size_t jobs_at_once = 0;
+    bool quiet = false;
+    mm::DetectionConfig config;
+    std::string error;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto next = [&]() -> const char* {
+            if (i + 1 >= argc) { usage(); std::exit(2); }
+            return argv[++i];
+        };
+        if (arg == "-h" || arg == "--help")       { usage(); return 0; }
+        else if (arg == "-q" || arg == "--quiet")  quiet = true;
+        else if (arg == "-o" || arg == "--out")    out = next();
+        else if (arg == "--threads")
+            mm::ThreadPool::set_shared_threads(std::max<size_t>(std::strtoull(next(), nullptr, 10), 1));
+        else if (arg == "--jobs")                  jobs_at_once = std::strtoull(next(), nullptr, 10);
+        else if (arg == "--rules")                 rules_path = next();
+        else if (arg == "--set") {
+            if (!set_threshold(next(), config, error)) {
+                std::cerr << "mm_analyze: " << error << "\n";
+                return 2;
+            }
+        }
+        else if (arg.size() > 1 && arg[0] == '-') { usage(); return 2; }
+        else paths.push_back(arg);
+    }
+    if (paths.empty()) { usage(); return 2; }
+    if (!config.validate(error)) {
+        std::cerr << "mm_analyze: " << error << "\n";
+        return 2;
+    }
+    if (!rules_path.empty() && !mm::load_scoring_rules(rules_path, error)) {
+        std::cerr << "mm_analyze: " << rules_path << ": " << error << "\n";
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    if (!collect_jobs(paths, out, jobs, error)) {
+        std::cerr << "mm_analyze: " << error << "\n";
+        return 2;
+    }
+
+    // `jobs_at_once` claimers pull files off one counter; parallel_for
+    // lets this thread be one of them
+    auto& pool = mm::ThreadPool::shared();
+    if (jobs_at_once == 0) jobs_at_once = pool.max_workers();
+    jobs_at_once = std::min(jobs_at_once, jobs.size());
+
+    std::atomic<size_t> next_job{0};
+    std::atomic<size_t> failed{0};
+    std::mutex log_mtx;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    pool.parallel_for(jobs_at_once, [&](size_t) {
+        std::string csv;
+        for (size_t j; (j = next_job.fetch_add(1)) < jobs.size();) {
+            const Job& job = jobs[j];
+            std::string problem;
+            mm::AnalysisResult result;
+            if (!read_file(job.input, csv)) {
+                problem = "cannot read file";
+            } else {
+                result = mm::analyze_csv(job.input.stem().string(), csv, config);
+                csv = std::string();
+                if (result.status != mm::AnalysisStatus::COMPLETED) {
+                    problem = result.error;
+                } else {
+                    const std::string report = mm::download_json(result);
+                    if (job.output.empty()) {
+                        std::lock_guard<std::mutex> lock(log_mtx);
+                        std::cout << report << "\n";
+                    } else if (!write_file(job.output, report)) {
+                        problem = "cannot write " + job.output.string();
+                    }
+                }
+            }
+
+            if (!problem.empty()) failed.fetch_add(1);
+            if (quiet && problem.empty()) continue;
+            std::lock_guard<std::mutex> lock(log_mtx);
+            if (problem.empty()) {
+                const auto& s = result.summary;
+                std::fprintf(stderr, "ok    %s: %d transactions, %d flagged, %d rings, %.3fs\n",
+                             job.input.string().c_str(), s.total_transactions,
+                             s.suspicious_accounts_flagged, s.fraud_rings_detected,
+                             s.processing_time_seconds);
+            } else {
+                std::fprintf(stderr, "FAIL  %s: %s\n", job.input.string().c_str(), problem.c_str());
+            }
+        }
+    });
+
+    if (!quiet) {
+        const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::fprintf(stderr, "%zu files, %zu failed, %.3fs\n", jobs.size(), failed.load(), secs);
+    }
+    return failed.load() ? 1 : 0;
+}